@@ -0,0 +1,191 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/udp.h>
+
+#include "BatchIo.h"
+
+int batch_alloc(packet_batch *batch, int capacity, size_t slot_size) {
+    memset(batch, 0, sizeof(*batch));
+    batch->capacity = capacity;
+    batch->slot_size = slot_size;
+    batch->data = malloc((size_t)capacity * slot_size);
+    batch->msgs = calloc(capacity, sizeof(*batch->msgs));
+    batch->iov = calloc(2 * capacity, sizeof(*batch->iov));
+    batch->addrs = calloc(capacity, sizeof(*batch->addrs));
+    if (!batch->data || !batch->msgs || !batch->iov || !batch->addrs) {
+        batch_free(batch);
+        return -1;
+    }
+    return 0;
+}
+
+void batch_free(packet_batch *batch) {
+    free(batch->data);
+    free(batch->msgs);
+    free(batch->iov);
+    free(batch->addrs);
+    memset(batch, 0, sizeof(*batch));
+}
+
+char *batch_slot(packet_batch *batch, int i) {
+    return batch->data + (size_t)i * batch->slot_size;
+}
+
+char *batch_next(packet_batch *batch) {
+    if (batch->count == batch->capacity)
+        return NULL;
+    return batch_slot(batch, batch->count);
+}
+
+void batch_commit_payload(packet_batch *batch, size_t hdr_len, const void *payload,
+                          size_t payload_len, const struct sockaddr_in *to) {
+    int i = batch->count++;
+    struct iovec *iov = &batch->iov[2 * i];
+    iov[0].iov_base = batch_slot(batch, i);
+    iov[0].iov_len = hdr_len;
+    iov[1].iov_base = (void *)payload;
+    iov[1].iov_len = payload_len;
+    struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->msg_iov = iov;
+    // Les deux iovec sont toujours renseignés : ceux de paquets consécutifs se
+    // suivent dans le tableau et forment le super-paquet d'un envoi segmenté
+    hdr->msg_iovlen = 2;
+    if (to) {
+        batch->addrs[i] = *to;
+        hdr->msg_name = &batch->addrs[i];
+        hdr->msg_namelen = sizeof(batch->addrs[i]);
+    }
+}
+
+void batch_commit(packet_batch *batch, size_t len, const struct sockaddr_in *to) {
+    batch_commit_payload(batch, len, NULL, 0, to);
+}
+
+// Envoie les paquets first à end - 1 par sendmmsg ; renvoie le nombre envoyé
+static int send_range(packet_batch *batch, int fd, int first, int end) {
+    int sent = first;
+    while (sent < end) {
+        int n = sendmmsg(fd, batch->msgs + sent, end - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            // Tampon d'émission plein ou erreur : les paquets restants sont perdus,
+            // comme un datagramme perdu sur le réseau, et seront retransmis
+            break;
+        }
+        sent += n;
+    }
+    return sent - first;
+}
+
+int batch_send(packet_batch *batch, int fd) {
+    int sent = send_range(batch, fd, 0, batch->count);
+    batch->count = 0;
+    return sent;
+}
+
+// Le noyau a refusé UDP_SEGMENT. Partagé par les workers de ServerThreads :
+// lu et écrit sans ordre, seule la valeur compte.
+static atomic_int gso_disabled;
+
+static int gso_refused(void) {
+    return atomic_load_explicit(&gso_disabled, memory_order_relaxed);
+}
+
+int batch_gso_available(void) {
+    return !gso_refused();
+}
+
+static size_t packet_len(const packet_batch *batch, int i) {
+    return batch->iov[2 * i].iov_len + batch->iov[2 * i + 1].iov_len;
+}
+
+static int same_destination(const packet_batch *batch, int a, int b) {
+    const struct msghdr *ha = &batch->msgs[a].msg_hdr, *hb = &batch->msgs[b].msg_hdr;
+    if (!ha->msg_name || !hb->msg_name)
+        return ha->msg_name == hb->msg_name;
+    return batch->addrs[a].sin_addr.s_addr == batch->addrs[b].sin_addr.s_addr &&
+           batch->addrs[a].sin_port == batch->addrs[b].sin_port;
+}
+
+// Envoie les paquets first à last (inclus) en un seul datagramme segmenté
+static int send_segmented(packet_batch *batch, int fd, int first, int last, size_t segment_size) {
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    memset(control, 0, sizeof(control));
+    struct msghdr hdr = batch->msgs[first].msg_hdr;
+    hdr.msg_iov = &batch->iov[2 * first];
+    hdr.msg_iovlen = 2 * (last - first + 1);
+    hdr.msg_control = control;
+    hdr.msg_controllen = sizeof(control);
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&hdr);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t gso_size = segment_size;
+    memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+    ssize_t n;
+    do {
+        n = sendmsg(fd, &hdr, 0);
+    } while (n < 0 && errno == EINTR);
+    return n < 0 ? -1 : 0;
+}
+
+int batch_send_gso(packet_batch *batch, int fd, size_t segment_size) {
+    int sent = 0;
+    while (!gso_refused() && sent < batch->count) {
+        // Groupe : paquets pleins de même destination, le dernier pouvant être plus court
+        int last = sent;
+        size_t bytes = packet_len(batch, sent);
+        while (packet_len(batch, last) == segment_size && last + 1 < batch->count &&
+               last + 1 - sent < GSO_MAX_SEGMENTS &&
+               bytes + packet_len(batch, last + 1) <= GSO_MAX_BYTES &&
+               packet_len(batch, last + 1) <= segment_size &&
+               same_destination(batch, sent, last + 1)) {
+            last++;
+            bytes += packet_len(batch, last);
+        }
+        if (send_segmented(batch, fd, sent, last, segment_size) < 0) {
+            if (errno != EINVAL && errno != EIO && errno != EOPNOTSUPP && errno != ENOPROTOOPT)
+                break;  // Comme pour sendmmsg : perdus, ils seront retransmis
+            // Segmentation refusée (noyau trop ancien, interface sans support) :
+            // le reste du lot et les lots suivants partent par sendmmsg
+            perror("[WARN] Segmentation UDP indisponible, envoi paquet par paquet");
+            atomic_store_explicit(&gso_disabled, 1, memory_order_relaxed);
+            break;
+        }
+        sent = last + 1;
+    }
+    if (gso_refused() && sent < batch->count)
+        sent += send_range(batch, fd, sent, batch->count);
+    batch->count = 0;
+    return sent;
+}
+
+int batch_recv(packet_batch *batch, int fd, int flags) {
+    for (int i = 0; i < batch->capacity; i++) {
+        batch->iov[2 * i].iov_base = batch_slot(batch, i);
+        batch->iov[2 * i].iov_len = batch->slot_size;
+        struct msghdr *hdr = &batch->msgs[i].msg_hdr;
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->msg_iov = &batch->iov[2 * i];
+        hdr->msg_iovlen = 1;
+        hdr->msg_name = &batch->addrs[i];
+        hdr->msg_namelen = sizeof(batch->addrs[i]);
+    }
+    int n;
+    do {
+        n = recvmmsg(fd, batch->msgs, batch->capacity, flags, NULL);
+    } while (n < 0 && errno == EINTR);
+    batch->count = n > 0 ? n : 0;
+    return n;
+}
+
+int batch_len(const packet_batch *batch, int i) {
+    return batch->msgs[i].msg_len;
+}
@@ -0,0 +1,68 @@
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#include <stddef.h>
+#include <netinet/in.h>
+
+// Entrées/sorties de datagrammes par lots : plusieurs paquets par appel
+// système avec recvmmsg et sendmmsg.
+
+#define BATCH_MAX 64  // Paquets au plus par lot
+
+// Segmentation UDP (GSO) : un seul appel sendmsg confie au noyau plusieurs
+// datagrammes de même taille, découpés selon UDP_SEGMENT
+#define GSO_MAX_SEGMENTS 64      // Limite du noyau (UDP_MAX_SEGMENTS)
+#define GSO_MAX_BYTES 65000      // Le super-paquet doit tenir dans un datagramme IP
+
+typedef struct {
+    int capacity;               // Nombre d'emplacements de paquet
+    size_t slot_size;           // Taille de chaque emplacement
+    int count;                  // Paquets préparés (envoi) ou reçus (réception)
+    char *data;                 // capacity emplacements de slot_size octets
+    struct mmsghdr *msgs;
+    struct iovec *iov;          // Deux par paquet : en-tête dans l'emplacement, puis charge utile
+    struct sockaddr_in *addrs;  // Destination ou source de chaque paquet
+} packet_batch;
+
+// Alloue un lot de capacity paquets d'au plus slot_size octets. Renvoie -1 en cas d'échec.
+int batch_alloc(packet_batch *batch, int capacity, size_t slot_size);
+void batch_free(packet_batch *batch);
+
+// Emplacement du i-ème paquet du lot
+char *batch_slot(packet_batch *batch, int i);
+
+// Emplacement où construire le prochain paquet à envoyer, NULL si le lot est plein
+char *batch_next(packet_batch *batch);
+
+// Valide le paquet construit dans batch_next. to vaut NULL sur une socket connectée.
+void batch_commit(packet_batch *batch, size_t len, const struct sockaddr_in *to);
+
+// Valide un paquet fait des hdr_len premiers octets de l'emplacement suivis de
+// payload_len octets lus directement dans payload (par exemple un fichier projeté
+// en mémoire), sans copie en espace utilisateur. payload doit rester valide
+// jusqu'à batch_send.
+void batch_commit_payload(packet_batch *batch, size_t hdr_len, const void *payload,
+                          size_t payload_len, const struct sockaddr_in *to);
+
+// Envoie les paquets préparés avec sendmmsg puis vide le lot.
+// Renvoie le nombre de paquets envoyés, -1 en cas d'erreur.
+int batch_send(packet_batch *batch, int fd);
+
+// Comme batch_send, mais les paquets consécutifs de même destination et de
+// segment_size octets (le dernier d'un groupe peut être plus court) partent en
+// un seul sendmsg segmenté par le noyau. Si le noyau refuse UDP_SEGMENT, la
+// segmentation est désactivée pour tout le processus et le lot part par sendmmsg.
+int batch_send_gso(packet_batch *batch, int fd, size_t segment_size);
+
+// Vrai tant que le noyau accepte la segmentation UDP
+int batch_gso_available(void);
+
+// Reçoit jusqu'à capacity paquets avec recvmmsg. La longueur du i-ème paquet
+// est batch->msgs[i].msg_len et son origine batch->addrs[i].
+// Renvoie le nombre de paquets reçus, -1 si aucun (errno positionné).
+int batch_recv(packet_batch *batch, int fd, int flags);
+
+// Longueur du i-ème paquet reçu
+int batch_len(const packet_batch *batch, int i);
+
+#endif
@@ -1,277 +1,1243 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <sys/time.h>
-#include <errno.h>
-
-#define DATA_SIZE 512               // Taille maximale des données dans un paquet TFTP
-#define PACKET_SIZE (DATA_SIZE + 4)   // 4 octets pour l'en-tête TFTP
-#define MAX_RETRIES 5               // Nombre maximal de retransmissions
-
-// Codes d'opération TFTP
-#define RRQ 1   // Read Request (demande de lecture)
-#define WRQ 2   // Write Request (demande d'écriture)
-#define DATA 3  // Paquet DATA
-#define ACK 4   // Accusé de réception
-#define ERROR 5 // Message d'erreur
-
-// ---------------------- Gestion des verrous sur fichier ----------------------
-
-// Vérifie l'existence d'un fichier de verrou (filename.lock)
-int check_lock(const char *filename) {
-    char lock_filename[300];
-    snprintf(lock_filename, sizeof(lock_filename), "%s.lock", filename);
-    return (access(lock_filename, F_OK) == 0);
-}
-
-// Crée un fichier de verrou indiquant qu'un transfert est en cours
-void add_lock(const char *filename) {
-    char lock_filename[300];
-    snprintf(lock_filename, sizeof(lock_filename), "%s.lock", filename);
-    FILE *fp = fopen(lock_filename, "w");
-    if (fp) { fclose(fp); }
-}
-
-// Supprime le fichier de verrou à la fin du transfert
-void remove_lock(const char *filename) {
-    char lock_filename[300];
-    snprintf(lock_filename, sizeof(lock_filename), "%s.lock", filename);
-    unlink(lock_filename);
-}
-
-// ---------------------- Fonctions d'envoi de paquets ----------------------
-
-// Envoi d'un ACK pour un bloc donné
-void send_ack(int sockfd, struct sockaddr_in server_addr, int block_num) {
-    char ack[4];
-    ack[0] = 0;
-    ack[1] = ACK;
-    ack[2] = (block_num >> 8) & 0xFF;
-    ack[3] = block_num & 0xFF;
-    sendto(sockfd, ack, sizeof(ack), 0, (struct sockaddr*)&server_addr, sizeof(server_addr));
-}
-
-// ---------------------- Transfert en PUT (envoi vers le serveur) ----------------------
-
-void do_tftp_put(int sockfd, struct sockaddr_in server_addr, char* filename) {
-    // Vérification du verrou pour éviter un transfert simultané sur le même fichier
-    if (check_lock(filename)) {
-        printf("tftp> Erreur: Un transfert pour '%s' est déjà en cours.\n", filename);
-        return;
-    }
-    add_lock(filename);
-
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) {
-        perror("tftp> Impossible d'ouvrir le fichier en lecture.");
-        remove_lock(filename);
-        return;
-    }
-    
-    // Construction et envoi de la requête WRQ
-    char request[PACKET_SIZE];
-    int req_len = sprintf(request, "%c%c%s%c%s%c", 0, WRQ, filename, 0, "octet", 0);
-    sendto(sockfd, request, req_len, 0, (struct sockaddr*)&server_addr, sizeof(server_addr));
-
-    // Configuration d'un timeout de 3 secondes pour la réception
-    struct timeval tv;
-    tv.tv_sec = 3;
-    tv.tv_usec = 0;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-    // Attente de l'ACK pour le bloc 0 (confirmation du serveur)
-    char response[PACKET_SIZE];
-    socklen_t addr_size = sizeof(server_addr);
-    int n = recvfrom(sockfd, response, PACKET_SIZE, 0,
-                     (struct sockaddr*)&server_addr, &addr_size);
-    if (n < 4) {
-        printf("tftp> Le serveur n'a pas confirmé l'écriture (ACK(0) non reçu).\n");
-        fclose(fp);
-        remove_lock(filename);
-        return;
-    }
-    int resp_opcode = (response[0] << 8) | response[1];
-    int resp_block  = (response[2] << 8) | response[3];
-    if (resp_opcode != ACK || resp_block != 0) {
-        printf("tftp> Le serveur n'a pas confirmé l'écriture (ACK(0) attendu).\n");
-        fclose(fp);
-        remove_lock(filename);
-        return;
-    }
-    
-    // Envoi des données en blocs de 512 octets
-    int block_num = 1;
-    char buffer[PACKET_SIZE];
-    while (1) {
-        memset(buffer, 0, PACKET_SIZE);
-        buffer[0] = 0;
-        buffer[1] = DATA;
-        buffer[2] = (block_num >> 8) & 0xFF;
-        buffer[3] = block_num & 0xFF;
-        int bytes_read = fread(buffer + 4, 1, DATA_SIZE, fp);
-        int packet_len = bytes_read + 4;
-        int retries = 0;
-        
-        // Boucle de retransmission en cas de non-réception de l'ACK
-        while (retries < MAX_RETRIES) {
-            sendto(sockfd, buffer, packet_len, 0, (struct sockaddr*)&server_addr, sizeof(server_addr));
-            sleep(1);
-            int recv_len = recvfrom(sockfd, buffer, PACKET_SIZE, 0,
-                                    (struct sockaddr*)&server_addr, &addr_size);
-            if (recv_len < 0) {
-                retries++;
-                continue;
-            }
-            int ack_opcode = (buffer[0] << 8) | buffer[1];
-            int ack_block  = (buffer[2] << 8) | buffer[3];
-            if (ack_opcode == ACK && ack_block == block_num)
-                break;
-            else
-                retries++;
-        }
-        if (retries == MAX_RETRIES) {
-            fprintf(stderr, "tftp> Erreur: retransmissions max atteintes pour le bloc %d\n", block_num);
-            fclose(fp);
-            remove_lock(filename);
-            return;
-        }
-        block_num++;
-        if (bytes_read < DATA_SIZE)
-            break;  // Fin du fichier
-    }
-    fclose(fp);
-    remove_lock(filename);
-}
-
-// ---------------------- Transfert en GET (réception depuis le serveur) ----------------------
-
-void do_tftp_get(int sockfd, struct sockaddr_in server_addr, char* filename) {
-    // Vérification du verrou pour éviter un transfert simultané sur le même fichier
-    if (check_lock(filename)) {
-        printf("tftp> Erreur: Un transfert pour '%s' est déjà en cours.\n", filename);
-        return;
-    }
-    add_lock(filename);
-    
-    // Construction et envoi de la requête RRQ
-    char request[PACKET_SIZE];
-    int req_len = sprintf(request, "%c%c%s%c%s%c", 0, RRQ, filename, 0, "octet", 0);
-    sendto(sockfd, request, req_len, 0, (struct sockaddr*)&server_addr, sizeof(server_addr));
-    
-    // Configuration d'un timeout de 3 secondes pour la réception
-    struct timeval tv;
-    tv.tv_sec = 3;
-    tv.tv_usec = 0;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    
-    // Ouverture du fichier local pour écriture
-    FILE *fp = fopen(filename, "wb");
-    if (!fp) {
-        perror("tftp> Impossible de créer le fichier local.");
-        remove_lock(filename);
-        return;
-    }
-    
-    int expected_block = 1;
-    char buffer[PACKET_SIZE];
-    socklen_t addr_size = sizeof(server_addr);
-    while (1) {
-        int n = recvfrom(sockfd, buffer, PACKET_SIZE, 0,
-                         (struct sockaddr*)&server_addr, &addr_size);
-        if (n < 0) {
-            fprintf(stderr, "tftp> Timeout ou erreur lors de la réception du bloc %d\n", expected_block);
-            fclose(fp);
-            remove(filename);  // Supprime le fichier incomplet
-            remove_lock(filename);
-            return;
-        }
-        if (n < 4) {
-            fprintf(stderr, "tftp> Paquet DATA trop court.\n");
-            fclose(fp);
-            remove(filename);
-            remove_lock(filename);
-            return;
-        }
-        int opcode = (buffer[0] << 8) | buffer[1];
-        int block_num = (buffer[2] << 8) | buffer[3];
-        if (opcode == ERROR) {
-            printf("tftp> Erreur du serveur : %s\n", buffer + 4);
-            fclose(fp);
-            remove(filename);
-            remove_lock(filename);
-            return;
-        }
-        if (opcode == DATA) {
-            if (block_num == expected_block) {
-                int data_len = n - 4;
-                fwrite(buffer + 4, 1, data_len, fp);
-                send_ack(sockfd, server_addr, block_num);
-                expected_block++;
-                if (data_len < DATA_SIZE)
-                    break;  // Fin du transfert
-            } else if (block_num < expected_block) {
-                // Bloc déjà reçu, renvoyer l'ACK
-                send_ack(sockfd, server_addr, block_num);
-            } else {
-                continue;  // Bloc inattendu, on l'ignore
-            }
-        }
-    }
-    fclose(fp);
-    remove_lock(filename);
-}
-
-// ---------------------- Fonction principale ----------------------
-
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: %s <server_ip>\n", argv[0]);
-        exit(EXIT_FAILURE);
-    }
-    
-    char *ip = argv[1];
-    const int port = 6969;
-    int sockfd;
-    struct sockaddr_in server_addr;
-    char command[256], filename[256];
-
-    // Création de la socket UDP (unique pour toute la session)
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
-        perror("tftp> Échec de la création du socket.");
-        exit(EXIT_FAILURE);
-    }
-    
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    server_addr.sin_addr.s_addr = inet_addr(ip);
-    
-    // Boucle interactive de commandes
-    while (1) {
-        printf("tftp> ");
-        if (!fgets(command, sizeof(command), stdin))
-            break;
-        command[strcspn(command, "\n")] = 0;
-        
-        if (strncmp(command, "put ", 4) == 0) {
-            strcpy(filename, command + 4);
-            do_tftp_put(sockfd, server_addr, filename);
-        }
-        else if (strncmp(command, "get ", 4) == 0) {
-            strcpy(filename, command + 4);
-            do_tftp_get(sockfd, server_addr, filename);
-        }
-        else if (strcmp(command, "quit") == 0) {
-            break;
-        }
-        else {
-            printf("tftp> Commande invalide.\n");
-        }
-    }
-    
-    close(sockfd);
-    return 0;
-}
\ No newline at end of file
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "TftpOptions.h"
+#include "TftpPacket.h"
+#include "Rtt.h"
+#include "LockTable.h"
+
+#define DATA_SIZE 512               // Taille maximale des données dans un paquet TFTP
+#define PACKET_SIZE (DATA_SIZE + 4)   // 4 octets pour l'en-tête TFTP
+
+// Taille de bloc demandée au serveur : -1 pour la déduire du MTU du chemin,
+// 0 pour ne demander aucune option (TFTP de base, blocs de 512 octets)
+static int requested_blksize = -1;
+
+// Fenêtre demandée au serveur (RFC 7440) : 0 pour ne pas demander l'option
+static int requested_windowsize = 0;
+
+// Délai maximal de retransmission demandé (RFC 2349), en secondes : 0 pour aucun
+static int requested_timeout = 0;
+
+// Numéro qui suit le bloc 65535, demandé par l'option rollover : -1 pour ne pas
+// la demander (le serveur repasse alors à 0)
+static int requested_rollover = -1;
+
+// Demande de l'option tsize (RFC 2349) : taille annoncée au serveur (PUT) ou
+// demandée au serveur (GET), pour afficher la progression
+static int requested_tsize = 1;
+
+// Nombre maximal de transferts simultanés pour mget, mput et les manifestes
+static int max_parallel = 8;
+
+// Sessions parallèles pour lire un même fichier (GET), chacune sur une plage
+// d'octets (options offset et length) : 1 pour une seule session
+static int requested_stripes = 1;
+
+// GET en multicast (RFC 2090) : les clients d'un même fichier partagent un seul
+// flux de DATA, envoyé par le serveur à un groupe multicast
+static int requested_multicast = 0;
+
+#define PROGRESS_INTERVAL_US 500000  // Rafraîchissement de la progression
+#define MAX_PARALLEL 1024            // Chaque transfert a son propre socket
+#define MAX_STRIPES 64
+#define STRIPE_MIN_SIZE (1024 * 1024) // Plus petite plage confiée à une session
+
+// ---------------------- Progression d'un transfert ----------------------
+
+typedef struct {
+    long long total;        // Taille du fichier (0 si inconnue)
+    long long done;         // Octets transférés
+    long long start_us;
+    long long next_us;      // Prochain affichage
+    int live;               // Affichage en direct (sortie sur un terminal)
+} progress;
+
+static int live_line;       // Une ligne de progression est à l'écran
+
+void progress_start(progress *p, long long total, int live) {
+    p->total = total;
+    p->done = 0;
+    p->start_us = rtt_now_us();
+    p->next_us = p->start_us + PROGRESS_INTERVAL_US;
+    p->live = live && isatty(STDOUT_FILENO);
+}
+
+// Débit en Mo/s depuis le début du transfert
+static double progress_rate(const progress *p, long long now) {
+    long long elapsed = now - p->start_us;
+    return elapsed > 0 ? (double)p->done / elapsed : 0;  // octets/µs = Mo/s
+}
+
+// Efface la ligne de progression avant d'écrire un message
+static void clear_live_line(void) {
+    if (live_line) {
+        printf("\r\33[K");
+        live_line = 0;
+    }
+}
+
+// Compte len octets de plus ; la ligne de progression est réécrite au plus
+// toutes les PROGRESS_INTERVAL_US
+void progress_update(progress *p, long long len) {
+    p->done += len;
+    if (!p->live)
+        return;
+    long long now = rtt_now_us();
+    if (now < p->next_us)
+        return;
+    p->next_us = now + PROGRESS_INTERVAL_US;
+    double rate = progress_rate(p, now);
+    if (p->total > 0 && rate > 0) {
+        long long left = (long long)((p->total - p->done) / rate / 1000000);
+        printf("\rtftp> %.1f / %.1f Mo (%d%%), %.2f Mo/s, reste %lld:%02lld   ",
+               p->done / 1e6, p->total / 1e6, (int)(p->done * 100 / p->total), rate,
+               left / 60, left % 60);
+    } else {
+        printf("\rtftp> %.1f Mo, %.2f Mo/s   ", p->done / 1e6, rate);
+    }
+    fflush(stdout);
+    live_line = 1;
+}
+
+// Bilan du transfert terminé, précédé du nom du fichier dans un lot
+void progress_end(const progress *p, const char *name) {
+    long long now = rtt_now_us();
+    clear_live_line();
+    if (name)
+        printf("tftp> %s : ", name);
+    else
+        printf("tftp> ");
+    printf("%lld octets transférés en %.2f s (%.2f Mo/s)\n",
+           p->done, (now - p->start_us) / 1e6, progress_rate(p, now));
+}
+
+// ---------------------- Fonctions d'envoi de paquets ----------------------
+
+// Envoi d'un ACK pour un bloc donné
+void send_ack(int sockfd, struct sockaddr_in server_addr, long long block_num, int rollover) {
+    unsigned int wire = block_to_wire(block_num, rollover);
+    char ack[TFTP_HEADER_SIZE];
+    int len = encode_ack(ack, wire);
+    sendto(sockfd, ack, len, 0, (struct sockaddr*)&server_addr, sizeof(server_addr));
+}
+
+// Envoi d'un message d'erreur au serveur (par ex. refus d'options)
+void send_error(int sockfd, struct sockaddr_in server_addr, int error_code, const char *msg) {
+    char buffer[PACKET_SIZE];
+    int len = encode_error(buffer, sizeof(buffer), error_code, msg);
+    sendto(sockfd, buffer, len, 0, (struct sockaddr*)&server_addr, sizeof(server_addr));
+}
+
+// Vrai si le paquet vient du port de session retenu pour le transfert (TID, RFC 1350)
+int same_peer(const struct sockaddr_in *a, const struct sockaddr_in *b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+// ---------------------- Négociation d'options ----------------------
+
+// Options à joindre à une requête RRQ/WRQ
+void request_options(struct sockaddr_in server_addr, tftp_options *opts) {
+    memset(opts, 0, sizeof(*opts));
+    if (requested_blksize != 0) {
+        opts->present |= OPT_BLKSIZE;
+        opts->blksize = requested_blksize > 0 ? requested_blksize : path_mtu_blksize(&server_addr);
+    }
+    if (requested_windowsize > 0) {
+        opts->present |= OPT_WINDOWSIZE;
+        opts->windowsize = requested_windowsize;
+    }
+    if (requested_timeout > 0) {
+        opts->present |= OPT_TIMEOUT;
+        opts->timeout = requested_timeout;
+    }
+    if (requested_rollover >= 0) {
+        opts->present |= OPT_ROLLOVER;
+        opts->rollover = requested_rollover;
+    }
+    if (requested_tsize) {
+        opts->present |= OPT_TSIZE;
+        opts->tsize = 0;  // PUT : remplacé par la taille du fichier envoyé
+    }
+}
+
+// Valide l'OACK du serveur ; session reçoit les valeurs retenues. Renvoie -1 si refusé.
+int accept_oack(const char *packet, int len, const tftp_options *requested, tftp_options *session) {
+    tftp_options accepted;
+    if (parse_oack(packet, len, &accepted) < 0)
+        return -1;
+    session->present = accepted.present;
+    // Le serveur ne peut que réduire les valeurs proposées (RFC 2348, RFC 7440)
+    if (accepted.present & OPT_BLKSIZE) {
+        if (!(requested->present & OPT_BLKSIZE) || accepted.blksize > requested->blksize)
+            return -1;
+        session->blksize = accepted.blksize;
+    }
+    if (accepted.present & OPT_WINDOWSIZE) {
+        if (!(requested->present & OPT_WINDOWSIZE) || accepted.windowsize > requested->windowsize)
+            return -1;
+        session->windowsize = accepted.windowsize;
+    }
+    // Le serveur renvoie la valeur de timeout demandée ou ignore l'option (RFC 2349)
+    if (accepted.present & OPT_TIMEOUT) {
+        if (!(requested->present & OPT_TIMEOUT) || accepted.timeout != requested->timeout)
+            return -1;
+        session->timeout = accepted.timeout;
+    }
+    // rollover : le serveur applique la valeur demandée ou ignore l'option
+    if (accepted.present & OPT_ROLLOVER) {
+        if (!(requested->present & OPT_ROLLOVER) || accepted.rollover != requested->rollover)
+            return -1;
+        session->rollover = accepted.rollover;
+    }
+    // tsize : taille du fichier à recevoir (GET), ou taille annoncée renvoyée (PUT)
+    if (accepted.present & OPT_TSIZE) {
+        if (!(requested->present & OPT_TSIZE) || (requested->tsize > 0 && accepted.tsize != requested->tsize))
+            return -1;
+        session->tsize = accepted.tsize;
+    }
+    // Plage d'octets : le début demandé, une longueur au plus égale à celle demandée
+    if (accepted.present & OPT_OFFSET) {
+        if (!(requested->present & OPT_OFFSET) || accepted.offset != requested->offset)
+            return -1;
+        session->offset = accepted.offset;
+    }
+    if (accepted.present & OPT_LENGTH) {
+        if (!(requested->present & OPT_OFFSET) ||
+            ((requested->present & OPT_LENGTH) && requested->length > 0 && accepted.length > requested->length))
+            return -1;
+        session->length = accepted.length;
+    }
+    // multicast : groupe à rejoindre et rôle du client (maître ou à l'écoute)
+    if (accepted.present & OPT_MULTICAST) {
+        if (!(requested->present & OPT_MULTICAST) || accepted.mcast_port == 0)
+            return -1;
+        session->mcast_addr = accepted.mcast_addr;
+        session->mcast_port = accepted.mcast_port;
+        session->mcast_master = accepted.mcast_master;
+    }
+    return 0;
+}
+
+// ---------------------- Transferts ----------------------
+
+// Un transfert demandé : les options sont fixées au moment de la demande,
+// un réglage ultérieur ne change pas les transferts déjà en file
+typedef struct {
+    int opcode;                 // RRQ (get) ou WRQ (put)
+    char filename[256];
+    tftp_options opts;
+    int stripes;                // GET : sessions parallèles souhaitées
+} transfer_request;
+
+typedef enum {
+    XFER_RUNNING,
+    XFER_STRIPED,               // GET découpé : les plages sont reçues par d'autres sessions
+    XFER_DALLY,                 // GET terminé : le dernier ACK peut encore être renvoyé
+    XFER_DONE
+} transfer_state;
+
+// Transfert en cours, avec son propre socket (donc son propre TID)
+typedef struct transfer {
+    const transfer_request *req;
+    struct transfer *parent;    // Plage : transfert du fichier entier (NULL sinon)
+    struct transfer *stripes;   // Fichier découpé : une session par plage
+    transfer_request *stripe_reqs;
+    int stripe_count;
+    const char *name;           // Nom affiché devant les messages (lot), NULL sinon
+    transfer_state state;
+    int ok;                     // Transfert terminé avec succès
+    int sockfd;
+    FILE *fp;
+    lock_entry *lock;
+    char *buffer;               // Paquet DATA à envoyer (PUT)
+    struct sockaddr_in server_addr;     // Port de session du serveur après sa réponse
+    struct sockaddr_in request_addr;    // Port 6969, pour renvoyer la requête
+    char request[PACKET_SIZE];
+    int req_len;
+    tftp_options opts;          // Options demandées (tsize : taille du fichier envoyé)
+    tftp_options session;       // Options retenues par le serveur
+    rtt_estimator rtt;
+    long long sent_us;          // Envoi de la requête, de la fenêtre ou du dernier ACK
+    long long timer_us;         // Départ du délai de retransmission
+    int retransmitted;
+    int answered;               // Le serveur a répondu (OACK, ACK(0) ou DATA)
+    progress prog;
+    // PUT
+    long long file_size;
+    long long last_block;       // Le seul bloc à contenir moins de blksize octets (éventuellement 0)
+    long long acked;
+    long long sent;             // Dernier bloc de la fenêtre envoyée
+    long long highest_sent;
+    // GET
+    long long range_start;      // Plage : position de son premier octet dans le fichier
+    long long range_len;
+    long long expected_block;   // Multicast : premier bloc manquant
+    int window_count;           // Blocs reçus depuis le dernier ACK envoyé
+    long long ooo_block;        // Dernier bloc hors séquence reçu
+    // GET multicast : les blocs arrivent dans le désordre, certains manqués
+    int mcast_fd;               // Socket abonné au groupe (-1 hors multicast)
+    unsigned char *have;        // Blocs déjà reçus, indexés par numéro
+    long long received;
+} transfer;
+
+static char recv_buffer[MAX_PACKET_SIZE];   // Plus grand bloc que le serveur peut envoyer
+
+// Message propre à un transfert, préfixé par le nom du fichier dans un lot
+static void transfer_message(const transfer *t, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void transfer_message(const transfer *t, const char *fmt, ...) {
+    clear_live_line();
+    if (t->name)
+        printf("tftp> %s : ", t->name);
+    else
+        printf("tftp> ");
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+}
+
+static void close_sockets(transfer *t) {
+    if (t->sockfd >= 0)
+        close(t->sockfd);
+    if (t->mcast_fd >= 0)
+        close(t->mcast_fd);
+    t->sockfd = t->mcast_fd = -1;
+}
+
+// Libère les ressources du transfert ; un fichier reçu incomplet est supprimé
+static void end_transfer(transfer *t, int ok) {
+    if (t->fp) {
+        fclose(t->fp);
+        t->fp = NULL;
+        if (!ok && t->req->opcode == RRQ)
+            remove(t->req->filename);
+    }
+    if (t->lock) {
+        lock_table_release(t->lock);
+        t->lock = NULL;
+    }
+    free(t->buffer);
+    t->buffer = NULL;
+    free(t->have);
+    t->have = NULL;
+    t->ok = ok;
+    if (ok && t->req->opcode == RRQ && t->sockfd >= 0) {
+        // Dernier ACK envoyé : on reste à l'écoute pour le renvoyer si le serveur,
+        // ne l'ayant pas reçu, retransmet sa dernière fenêtre
+        t->state = XFER_DALLY;
+        t->timer_us = rtt_now_us();
+        return;
+    }
+    close_sockets(t);
+    t->state = XFER_DONE;
+}
+
+// Verrouille et ouvre le fichier local. Renvoie -1 (transfert terminé) en cas d'échec.
+static int open_local_file(transfer *t) {
+    const char *filename = t->req->filename;
+    tftp_options *opts = &t->opts;
+    // Verrou en mémoire pour éviter un transfert simultané incompatible sur le même fichier
+    t->lock = lock_table_acquire(filename, t->req->opcode == WRQ ? LOCK_SHARED : LOCK_EXCLUSIVE, 0);
+    if (!t->lock) {
+        transfer_message(t, "Erreur: Un transfert pour '%s' est déjà en cours.\n", filename);
+        end_transfer(t, 0);
+        return -1;
+    }
+    if (t->req->opcode == RRQ) {
+        // Ouverture du fichier local pour écriture
+        t->fp = fopen(filename, "wb");
+        if (!t->fp) {
+            transfer_message(t, "Impossible de créer le fichier local : %s\n", strerror(errno));
+            end_transfer(t, 0);
+            return -1;
+        }
+        return 0;
+    }
+    t->fp = fopen(filename, "rb");
+    if (!t->fp) {
+        transfer_message(t, "Impossible d'ouvrir le fichier en lecture : %s\n", strerror(errno));
+        end_transfer(t, 0);
+        return -1;
+    }
+    // La taille annoncée par tsize permet au serveur de refuser d'emblée un fichier trop gros
+    fseek(t->fp, 0, SEEK_END);
+    t->file_size = ftell(t->fp);
+    rewind(t->fp);
+    if (opts->present & OPT_TSIZE)
+        opts->tsize = t->file_size;
+    // Le serveur ne peut que réduire la taille de bloc proposée
+    int buffer_size = (opts->present & OPT_BLKSIZE) ? opts->blksize + 4 : PACKET_SIZE;
+    if (buffer_size < PACKET_SIZE)
+        buffer_size = PACKET_SIZE;
+    t->buffer = malloc(buffer_size);
+    if (!t->buffer) {
+        transfer_message(t, "Allocation du tampon d'envoi impossible.\n");
+        end_transfer(t, 0);
+        return -1;
+    }
+    return 0;
+}
+
+// Ouvre le fichier local et envoie la requête. Renvoie -1 si le transfert n'a pas pu commencer.
+// Une plage (parent non NULL) écrit dans le fichier déjà ouvert et verrouillé par son parent.
+static int start_transfer(transfer *t, const transfer_request *req, struct sockaddr_in server_addr,
+                          const char *name, transfer *parent) {
+    memset(t, 0, sizeof(*t));
+    t->req = req;
+    t->parent = parent;
+    t->name = name;
+    t->sockfd = t->mcast_fd = -1;
+    t->state = XFER_RUNNING;
+    tftp_options *opts = &t->opts;
+    *opts = req->opts;
+    if (parent) {
+        t->range_start = opts->offset;
+        t->range_len = opts->length;
+    } else if (open_local_file(t) < 0) {
+        return -1;
+    }
+
+    // Construction et envoi de la requête avec les options souhaitées
+    t->req_len = build_request(t->request, sizeof(t->request), req->opcode, req->filename, opts);
+    if (t->req_len < 0) {
+        transfer_message(t, "Nom de fichier trop long.\n");
+        end_transfer(t, 0);
+        return -1;
+    }
+    t->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (t->sockfd < 0) {
+        transfer_message(t, "Échec de la création du socket : %s\n", strerror(errno));
+        end_transfer(t, 0);
+        return -1;
+    }
+    t->server_addr = t->request_addr = server_addr;
+    sendto(t->sockfd, t->request, t->req_len, 0, (struct sockaddr*)&t->request_addr, sizeof(t->request_addr));
+
+    // Délai de retransmission adaptatif, plafonné par l'option timeout
+    rtt_init(&t->rtt, (opts->present & OPT_TIMEOUT) ? opts->timeout : 0);
+    t->sent_us = t->timer_us = rtt_now_us();
+    t->session = (tftp_options){ .blksize = DATA_SIZE, .windowsize = DEFAULT_WINDOWSIZE };
+    t->expected_block = 1;
+    t->ooo_block = -1;
+    // GET : taille connue à l'OACK si le serveur accepte tsize
+    progress_start(&t->prog, req->opcode == WRQ ? t->file_size : 0, name == NULL);
+    return 0;
+}
+
+// Envoi de la fenêtre qui suit le dernier bloc acquitté
+static void send_window(transfer *t) {
+    int blksize = t->session.blksize;
+    t->sent = t->acked + t->session.windowsize;
+    if (t->sent > t->last_block)
+        t->sent = t->last_block;
+    for (long long block_num = t->acked + 1; block_num <= t->sent; block_num++) {
+        unsigned int wire = block_to_wire(block_num, t->session.rollover);
+        long offset = (block_num - 1) * blksize;
+        if (ftell(t->fp) != offset)
+            fseek(t->fp, offset, SEEK_SET);  // Retransmission depuis le dernier bloc acquitté
+        encode_data_header(t->buffer, wire);
+        int bytes_read = fread(t->buffer + 4, 1, blksize, t->fp);
+        sendto(t->sockfd, t->buffer, bytes_read + 4, 0, (struct sockaddr*)&t->server_addr, sizeof(t->server_addr));
+    }
+    // Règle de Karn : pas de mesure de RTT sur une fenêtre qui renvoie un bloc
+    t->retransmitted = t->acked + 1 <= t->highest_sent;
+    if (t->sent > t->highest_sent)
+        t->highest_sent = t->sent;
+    t->sent_us = t->timer_us = rtt_now_us();
+}
+
+// PUT : ACK(0) ou OACK confirmant l'écriture, puis ACK des fenêtres
+static void put_packet(transfer *t, int opcode, const char *packet, int n) {
+    if (!t->answered) {
+        t->answered = 1;
+        rtt_progress(&t->rtt, t->sent_us, t->retransmitted);
+        int block = packet_block(packet);
+        if (opcode == OACK) {
+            if (accept_oack(packet, n, &t->opts, &t->session) < 0) {
+                transfer_message(t, "Options du serveur refusées.\n");
+                send_error(t->sockfd, t->server_addr, 8, "Options refusées");
+                end_transfer(t, 0);
+                return;
+            }
+        } else if (opcode != ACK || block != 0) {
+            transfer_message(t, "Le serveur n'a pas confirmé l'écriture (ACK(0) attendu).\n");
+            end_transfer(t, 0);
+            return;
+        }
+        if (!(t->session.present & OPT_TIMEOUT))
+            t->rtt.max_rto_us = RTT_DEFAULT_MAX_US;  // Option timeout ignorée par le serveur
+        t->last_block = t->file_size / t->session.blksize + 1;
+        send_window(t);
+        return;
+    }
+    // Seul un ACK pour un bloc de la fenêtre compte, les autres paquets sont ignorés
+    unsigned int wire = packet_block(packet);
+    long long block = block_from_wire(wire, t->acked, t->session.rollover);
+    if (opcode != ACK || block <= t->acked || block > t->sent)
+        return;
+    rtt_progress(&t->rtt, t->sent_us, t->retransmitted);
+    // Octets acquittés par ce ACK, le dernier bloc n'étant pas plein
+    long long acked_bytes = block == t->last_block ? t->file_size : block * t->session.blksize;
+    progress_update(&t->prog, acked_bytes - t->prog.done);
+    t->acked = block;
+    if (t->acked == t->last_block) {
+        progress_end(&t->prog, t->name);
+        end_transfer(t, 1);
+        return;
+    }
+    send_window(t);
+}
+
+// Réserve d'un coup le fichier reçu, dont les blocs sont écrits à leur position :
+// un disque trop petit est détecté avant le premier bloc. Renvoie -1 (transfert
+// terminé) en cas d'échec.
+static int reserve_local_file(transfer *t, long long size) {
+    int fd = fileno(t->fp);
+    if (fallocate(fd, 0, 0, size) < 0 && (errno == ENOSPC || ftruncate(fd, size) < 0)) {
+        transfer_message(t, "Réservation du fichier local impossible : %s\n", strerror(errno));
+        send_error(t->sockfd, t->server_addr, 3, "Disque plein ou dépassement de capacité");
+        end_transfer(t, 0);
+        return -1;
+    }
+    return 0;
+}
+
+// La sonde (offset 0) a fait connaître la taille du fichier : elle est annulée et
+// chaque plage est demandée sur sa propre session. Renvoie 1 si le fichier est
+// découpé, 0 pour continuer sur la seule sonde, -1 si le transfert a échoué.
+static int start_stripes(transfer *t) {
+    long long size = t->session.tsize;
+    int count = t->req->stripes;
+    if (count > size / STRIPE_MIN_SIZE)
+        count = size / STRIPE_MIN_SIZE;
+    if (count < 2)
+        return 0;
+    t->stripes = calloc(count, sizeof(*t->stripes));
+    t->stripe_reqs = calloc(count, sizeof(*t->stripe_reqs));
+    if (!t->stripes || !t->stripe_reqs) {
+        free(t->stripes);
+        free(t->stripe_reqs);
+        t->stripes = NULL;
+        t->stripe_reqs = NULL;
+        return 0;
+    }
+    // Les plages écrivent chacune à sa position
+    if (reserve_local_file(t, size) < 0)
+        return -1;
+    send_error(t->sockfd, t->server_addr, 8, "Transfert découpé en plages");
+    close(t->sockfd);
+    t->sockfd = -1;
+    t->state = XFER_STRIPED;
+    t->stripe_count = count;
+    for (int k = 0; k < count; k++) {
+        transfer_request *r = &t->stripe_reqs[k];
+        *r = *t->req;
+        r->stripes = 1;
+        r->opts.present = (r->opts.present & ~OPT_TSIZE) | OPT_OFFSET | OPT_LENGTH;
+        r->opts.offset = size * k / count;
+        r->opts.length = size * (k + 1) / count - r->opts.offset;
+        start_transfer(&t->stripes[k], r, t->request_addr, t->name, t);
+    }
+    return 1;
+}
+
+// Fichier découpé : termine le parent quand toutes les plages sont reçues, ou
+// annule les autres plages dès que l'une échoue
+static void check_stripes(transfer *t) {
+    int running = 0, failed = 0;
+    for (int k = 0; k < t->stripe_count; k++) {
+        running += t->stripes[k].state == XFER_RUNNING;
+        failed += t->stripes[k].state == XFER_DONE && !t->stripes[k].ok;
+    }
+    if (failed) {
+        for (int k = 0; k < t->stripe_count; k++) {
+            transfer *s = &t->stripes[k];
+            if (s->state != XFER_RUNNING)
+                continue;
+            if (s->answered)
+                send_error(s->sockfd, s->server_addr, 0, "Transfert annulé");
+            end_transfer(s, 0);
+        }
+        end_transfer(t, 0);
+    } else if (running == 0) {
+        progress_end(&t->prog, t->name);
+        end_transfer(t, 1);
+    }
+}
+
+// Multicast, client maître : acquitte les blocs reçus sans trou, le serveur
+// reprend au premier manquant
+static void multicast_ack(transfer *t) {
+    send_ack(t->sockfd, t->server_addr, t->expected_block - 1, t->session.rollover);
+    t->window_count = 0;
+    t->sent_us = t->timer_us = rtt_now_us();
+    t->retransmitted = 0;
+}
+
+// OACK multicast : abonnement au groupe annoncé, fichier réservé pour recevoir les
+// blocs dans le désordre. Le maître acquitte aussitôt l'OACK, les autres écoutent.
+static void start_multicast(transfer *t) {
+    if (!(t->session.present & OPT_TSIZE)) {
+        transfer_message(t, "Taille du fichier inconnue, multicast impossible.\n");
+        send_error(t->sockfd, t->server_addr, 8, "Option tsize requise");
+        end_transfer(t, 0);
+        return;
+    }
+    t->last_block = t->session.tsize / t->session.blksize + 1;
+    if (reserve_local_file(t, t->session.tsize) < 0)
+        return;
+    t->have = calloc(t->last_block + 1, 1);
+    struct sockaddr_in group = { .sin_family = AF_INET, .sin_addr = t->session.mcast_addr,
+                                 .sin_port = htons(t->session.mcast_port) };
+    struct ip_mreq mreq = { .imr_multiaddr = t->session.mcast_addr, .imr_interface.s_addr = INADDR_ANY };
+    int reuse = 1;  // Plusieurs clients d'une même machine écoutent le même groupe
+    t->mcast_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (!t->have || t->mcast_fd < 0 ||
+        setsockopt(t->mcast_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+        bind(t->mcast_fd, (struct sockaddr*)&group, sizeof(group)) < 0 ||
+        setsockopt(t->mcast_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        transfer_message(t, "Abonnement au groupe %s impossible : %s\n",
+                         inet_ntoa(t->session.mcast_addr), strerror(errno));
+        send_error(t->sockfd, t->server_addr, 0, "Groupe multicast inaccessible");
+        end_transfer(t, 0);
+        return;
+    }
+    if (t->session.mcast_master)
+        multicast_ack(t);
+    else
+        t->timer_us = rtt_now_us();
+}
+
+// Multicast : blocs reçus dans n'importe quel ordre, rangés à leur position.
+// Seul le maître acquitte ; un OACK fait d'un client à l'écoute le nouveau maître.
+static void multicast_packet(transfer *t, int opcode, const char *packet, int n) {
+    if (opcode == OACK) {
+        tftp_options role;
+        if (parse_oack(packet, n, &role) == 0 && (role.present & OPT_MULTICAST) && role.mcast_master)
+            t->session.mcast_master = 1;
+        if (t->session.mcast_master)
+            multicast_ack(t);
+        return;
+    }
+    if (opcode != DATA)
+        return;
+    int blksize = t->session.blksize;
+    unsigned int wire = packet_block(packet);
+    long long block_num = block_from_wire(wire, t->expected_block, t->session.rollover);
+    long long expected = t->expected_block;
+    int data_len = n - 4;
+    if (block_num >= 1 && block_num <= t->last_block && !t->have[block_num]) {
+        long long position = (block_num - 1) * blksize;
+        long long left = t->session.tsize - position;
+        if (data_len != (left < blksize ? left : blksize))
+            return;  // Ne correspond pas au fichier annoncé
+        if (pwrite(fileno(t->fp), packet + 4, data_len, position) != data_len) {
+            transfer_message(t, "Écriture du fichier local impossible : %s\n", strerror(errno));
+            send_error(t->sockfd, t->server_addr, 3, "Disque plein ou dépassement de capacité");
+            end_transfer(t, 0);
+            return;
+        }
+        t->have[block_num] = 1;
+        t->received++;
+        progress_update(&t->prog, data_len);
+        while (t->expected_block <= t->last_block && t->have[t->expected_block])
+            t->expected_block++;
+    }
+    int master = t->session.mcast_master;
+    // Un client à l'écoute ne mesure pas le RTT, mais le flux le garde en vie
+    rtt_progress(&t->rtt, t->sent_us, !master || t->retransmitted || t->window_count > 0);
+    t->timer_us = rtt_now_us();
+    if (t->received == t->last_block) {
+        // Fichier complet : le dernier ACK fait quitter le groupe, maître ou non
+        send_ack(t->sockfd, t->server_addr, t->last_block, t->session.rollover);
+        progress_end(&t->prog, t->name);
+        end_transfer(t, 1);
+        return;
+    }
+    if (!master)
+        return;
+    if (block_num > expected) {
+        // Trou dans la fenêtre : un seul ACK par passage de la fenêtre retransmise
+        if (t->ooo_block < 0 || block_num <= t->ooo_block)
+            multicast_ack(t);
+        t->ooo_block = block_num;
+        return;
+    }
+    if (block_num == expected)
+        t->ooo_block = -1;
+    if (++t->window_count >= t->session.windowsize)
+        multicast_ack(t);
+}
+
+// GET : OACK éventuel, puis blocs DATA
+static void get_packet(transfer *t, int opcode, const char *packet, int n) {
+    if (t->mcast_fd >= 0) {
+        multicast_packet(t, opcode, packet, n);
+        return;
+    }
+    if (opcode == OACK) {
+        if (t->expected_block != 1)
+            return;  // OACK retransmis après le début du transfert
+        if (!t->answered) {
+            if (accept_oack(packet, n, &t->opts, &t->session) < 0) {
+                transfer_message(t, "Options du serveur refusées.\n");
+                send_error(t->sockfd, t->server_addr, 8, "Options refusées");
+                end_transfer(t, 0);
+                return;
+            }
+            t->answered = 1;
+            rtt_progress(&t->rtt, t->sent_us, t->retransmitted);
+            if (t->parent && !(t->session.present & OPT_OFFSET)) {
+                transfer_message(t, "Le serveur ne gère pas les plages d'octets.\n");
+                send_error(t->sockfd, t->server_addr, 8, "Option offset requise");
+                end_transfer(t, 0);
+                return;
+            }
+            if (t->session.present & OPT_TSIZE)
+                t->prog.total = t->session.tsize;
+            if (!(t->session.present & OPT_TIMEOUT))
+                t->rtt.max_rto_us = RTT_DEFAULT_MAX_US;  // Option timeout ignorée
+            if (t->session.present & OPT_MULTICAST) {
+                start_multicast(t);
+                return;
+            }
+            // Taille connue et plages acceptées : la sonde laisse place aux sessions parallèles
+            if (!t->parent && t->req->stripes > 1 &&
+                (t->session.present & (OPT_OFFSET | OPT_TSIZE)) == (OPT_OFFSET | OPT_TSIZE) &&
+                start_stripes(t) != 0)
+                return;
+        }
+        send_ack(t->sockfd, t->server_addr, 0, t->session.rollover);  // L'ACK(0) confirme les options
+        t->sent_us = t->timer_us = rtt_now_us();
+        t->retransmitted = 0;
+        return;
+    }
+    if (opcode != DATA)
+        return;
+    if (!t->answered) {
+        if (t->parent) {
+            // Options ignorées : le serveur envoie le fichier entier, pas la plage
+            transfer_message(t, "Le serveur ne gère pas les plages d'octets.\n");
+            send_error(t->sockfd, t->server_addr, 8, "Option offset requise");
+            end_transfer(t, 0);
+            return;
+        }
+        t->answered = 1;  // Le serveur a ignoré les options : blocs de 512 octets
+        t->rtt.max_rto_us = RTT_DEFAULT_MAX_US;
+    }
+    unsigned int wire = packet_block(packet);
+    long long block_num = block_from_wire(wire, t->expected_block - 1, t->session.rollover);
+    if (block_num != t->expected_block) {
+        // Bloc en double ou perte dans la fenêtre : on acquitte le dernier bloc
+        // reçu dans l'ordre, une fois par passage de la fenêtre retransmise
+        if (t->ooo_block < 0 || block_num <= t->ooo_block) {
+            send_ack(t->sockfd, t->server_addr, t->expected_block - 1, t->session.rollover);
+            t->window_count = 0;
+            t->sent_us = t->timer_us = rtt_now_us();
+            t->retransmitted = 1;
+        }
+        t->ooo_block = block_num;
+        return;
+    }
+    int data_len = n - 4;
+    long long position = (block_num - 1) * t->session.blksize;  // Dans la plage reçue
+    int written;
+    if (t->parent) {
+        // Chaque plage écrit à sa place dans le fichier réservé par le parent
+        if (position + data_len > t->range_len) {
+            transfer_message(t, "Le serveur a envoyé plus que la plage demandée.\n");
+            send_error(t->sockfd, t->server_addr, 0, "Plage dépassée");
+            end_transfer(t, 0);
+            return;
+        }
+        written = pwrite(fileno(t->parent->fp), packet + 4, data_len, t->range_start + position) == data_len;
+    } else {
+        written = fwrite(packet + 4, 1, data_len, t->fp) == (size_t)data_len;
+    }
+    if (!written) {
+        transfer_message(t, "Écriture du fichier local impossible : %s\n", strerror(errno));
+        send_error(t->sockfd, t->server_addr, 3, "Disque plein ou dépassement de capacité");
+        end_transfer(t, 0);
+        return;
+    }
+    progress_update(t->parent ? &t->parent->prog : &t->prog, data_len);
+    // Seul le premier bloc qui suit un ACK (ou la requête) mesure le RTT
+    rtt_progress(&t->rtt, t->sent_us, t->retransmitted || t->window_count > 0);
+    t->timer_us = rtt_now_us();
+    t->ooo_block = -1;
+    int complete = data_len < t->session.blksize;
+    // Un seul ACK par fenêtre, ou pour le dernier bloc
+    if (complete || ++t->window_count >= t->session.windowsize) {
+        send_ack(t->sockfd, t->server_addr, block_num, t->session.rollover);
+        t->window_count = 0;
+        t->sent_us = t->timer_us;
+        t->retransmitted = 0;
+    }
+    t->expected_block++;
+    if (complete && t->parent) {
+        // Plage terminée ; le bilan est celui du fichier entier
+        if (position + data_len != t->range_len) {
+            transfer_message(t, "Plage incomplète : %lld octets reçus sur %lld.\n",
+                             position + data_len, t->range_len);
+            end_transfer(t, 0);
+            return;
+        }
+        end_transfer(t, 1);
+    } else if (complete) {
+        progress_end(&t->prog, t->name);
+        end_transfer(t, 1);  // Fin du transfert
+    }
+}
+
+// from_group : reçu sur le socket du groupe multicast, dont les DATA partent de
+// l'adresse de l'interface du groupe, pas forcément celle qui répond en unicast ;
+// seul le port du serveur (son TID) est alors vérifié
+static void handle_packet(transfer *t, const char *packet, int n, const struct sockaddr_in *from,
+                          int from_group) {
+    if (n < 4)
+        return;  // Paquet trop court, ignoré
+    int opcode = packet_opcode(packet, n);
+    if (from_group) {
+        if (from->sin_port != t->server_addr.sin_port)
+            return;
+        from = &t->server_addr;
+    }
+    if (t->state == XFER_DALLY) {
+        // Dernière fenêtre retransmise : le dernier ACK s'est perdu. En multicast,
+        // le flux continue pour les autres clients : seul le maître le réacquitte,
+        // et un client à l'écoute répond à l'OACK qui le fait maître.
+        int resend = t->mcast_fd < 0 || t->session.mcast_master ? opcode == DATA : opcode == OACK;
+        if (resend && same_peer(from, &t->server_addr))
+            send_ack(t->sockfd, t->server_addr, t->expected_block - 1, t->session.rollover);
+        return;
+    }
+    // La première réponse fixe le port de session du serveur
+    if (!t->answered) {
+        t->server_addr = *from;
+    } else if (!same_peer(from, &t->server_addr)) {
+        send_error(t->sockfd, *from, 5, "TID inconnu");
+        return;
+    }
+    int code, msg_len;
+    const char *msg;
+    if (parse_error(packet, n, &code, &msg, &msg_len) == 0) {
+        transfer_message(t, "Erreur du serveur : %.*s\n", msg_len, msg);
+        end_transfer(t, 0);
+        return;
+    }
+    if (t->req->opcode == WRQ)
+        put_packet(t, opcode, packet, n);
+    else
+        get_packet(t, opcode, packet, n);
+}
+
+// Échéance du transfert : retransmission, fin de l'attente du dernier ACK
+static long long transfer_deadline(const transfer *t) {
+    if (t->state == XFER_DALLY)
+        return t->timer_us + RTT_DALLY_FACTOR * t->rtt.rto_us;
+    return t->timer_us + t->rtt.rto_us;
+}
+
+static void handle_timeout(transfer *t) {
+    if (t->state == XFER_DALLY) {
+        close_sockets(t);
+        t->state = XFER_DONE;
+        return;
+    }
+    rtt_timeout(&t->rtt);
+    if (rtt_gave_up(&t->rtt, rtt_now_us())) {
+        if (t->req->opcode == RRQ)
+            transfer_message(t, "Timeout lors de la réception du bloc %lld\n", t->expected_block);
+        else if (!t->answered)
+            transfer_message(t, "Le serveur n'a pas confirmé l'écriture (ACK(0) non reçu).\n");
+        else
+            transfer_message(t, "Erreur: plus de réponse du serveur pour le bloc %lld\n", t->acked + 1);
+        end_transfer(t, 0);
+        return;
+    }
+    if (t->req->opcode == WRQ && t->answered) {
+        send_window(t);  // La fenêtre repart du dernier bloc acquitté
+        return;
+    }
+    if (t->mcast_fd >= 0 && !t->session.mcast_master) {
+        t->timer_us = rtt_now_us();  // À l'écoute : rien à renvoyer, le flux est mené par le maître
+        return;
+    }
+    // Sans réponse dans le délai, on renvoie la requête ou le dernier ACK
+    if (t->answered)
+        send_ack(t->sockfd, t->server_addr, t->expected_block - 1, t->session.rollover);
+    else
+        sendto(t->sockfd, t->request, t->req_len, 0, (struct sockaddr*)&t->request_addr, sizeof(t->request_addr));
+    t->window_count = 0;
+    t->sent_us = t->timer_us = rtt_now_us();
+    t->retransmitted = 1;
+}
+
+// Mène tous les transferts demandés depuis une seule boucle, au plus
+// max_parallel à la fois. Renvoie le nombre de transferts échoués.
+int run_transfers(struct sockaddr_in server_addr, const transfer_request *reqs, int count) {
+    transfer *transfers = calloc(count, sizeof(*transfers));
+    if (!transfers) {
+        perror("tftp> Allocation des transferts");
+        return count;
+    }
+    // Sessions à surveiller : les transferts et, pour un fichier découpé, ses plages
+    struct pollfd *pfds = NULL;
+    transfer **owners = NULL;
+    int capacity = 0;
+    int batch = count > 1;
+    progress total;
+    progress_start(&total, 0, batch);
+    int next = 0, running = 0;
+    long long finished_us = 0;  // Fin du dernier transfert, sans l'attente du dernier ACK
+    while (1) {
+        // Nouveaux transferts dans la limite du parallélisme ; un transfert en
+        // attente du dernier ACK ne compte plus
+        while (running < max_parallel && next < count) {
+            if (start_transfer(&transfers[next], &reqs[next], server_addr,
+                               batch ? reqs[next].filename : NULL, NULL) == 0)
+                running++;
+            next++;
+        }
+        int sessions = 2 * next;  // Multicast : le socket du groupe en plus
+        for (int k = 0; k < next; k++)
+            sessions += transfers[k].stripe_count;
+        if (sessions > capacity) {
+            struct pollfd *grown_pfds = realloc(pfds, sessions * sizeof(*pfds));
+            if (grown_pfds)
+                pfds = grown_pfds;
+            transfer **grown_owners = realloc(owners, sessions * sizeof(*owners));
+            if (grown_owners)
+                owners = grown_owners;
+            if (!grown_pfds || !grown_owners) {
+                perror("tftp> Allocation des sessions");
+                break;
+            }
+            capacity = sessions;
+        }
+        int nfds = 0;
+        long long deadline = 0;
+        for (int k = 0; k < next; k++) {
+            for (int j = -1; j < transfers[k].stripe_count; j++) {
+                transfer *t = j < 0 ? &transfers[k] : &transfers[k].stripes[j];
+                if (t->sockfd < 0)
+                    continue;  // Terminé, ou découpé en plages
+                long long d = transfer_deadline(t);
+                if (nfds == 0 || d < deadline)
+                    deadline = d;
+                pfds[nfds] = (struct pollfd){ .fd = t->sockfd, .events = POLLIN };
+                owners[nfds++] = t;
+                if (t->mcast_fd >= 0) {
+                    pfds[nfds] = (struct pollfd){ .fd = t->mcast_fd, .events = POLLIN };
+                    owners[nfds++] = t;
+                }
+            }
+        }
+        if (nfds == 0)
+            break;
+        long long wait_us = deadline - rtt_now_us();
+        // Arrondi au-dessus : se réveiller avant l'échéance ne ferait que tourner à vide
+        int wait_ms = wait_us <= 0 ? 0 : (int)((wait_us + 999) / 1000);
+        if (poll(pfds, nfds, wait_ms) < 0 && errno != EINTR) {
+            perror("tftp> poll");
+            break;
+        }
+        for (int p = 0; p < nfds; p++) {
+            if (!pfds[p].revents)
+                continue;
+            transfer *t = owners[p];
+            while (t->sockfd >= 0) {
+                struct sockaddr_in from;
+                socklen_t addr_size = sizeof(from);
+                int n = recvfrom(pfds[p].fd, recv_buffer, sizeof(recv_buffer), MSG_DONTWAIT,
+                                 (struct sockaddr*)&from, &addr_size);
+                if (n < 0)
+                    break;
+                handle_packet(t, recv_buffer, n, &from, pfds[p].fd == t->mcast_fd);
+            }
+        }
+        long long now = rtt_now_us();
+        long long done = 0;
+        for (int p = 0; p < nfds; p++) {
+            transfer *t = owners[p];
+            if (pfds[p].fd == t->sockfd && now >= transfer_deadline(t))
+                handle_timeout(t);
+        }
+        running = 0;
+        for (int k = 0; k < next; k++) {
+            transfer *t = &transfers[k];
+            if (t->state == XFER_STRIPED)
+                check_stripes(t);
+            running += t->state == XFER_RUNNING || t->state == XFER_STRIPED;
+            done += t->prog.done;
+        }
+        progress_update(&total, done - total.done);
+        if (running == 0 && next == count && finished_us == 0)
+            finished_us = now;
+    }
+    int succeeded = 0;
+    long long bytes = 0;
+    for (int k = 0; k < count; k++) {
+        if (transfers[k].ok) {
+            succeeded++;
+            bytes += transfers[k].prog.done;
+        }
+    }
+    if (batch) {
+        long long elapsed = (finished_us ? finished_us : rtt_now_us()) - total.start_us;
+        clear_live_line();
+        printf("tftp> %d fichier(s) sur %d transférés : %lld octets en %.2f s (%.2f Mo/s)\n",
+               succeeded, count, bytes, elapsed / 1e6, elapsed > 0 ? (double)bytes / elapsed : 0);
+    }
+    for (int k = 0; k < count; k++) {
+        free(transfers[k].stripes);
+        free(transfers[k].stripe_reqs);
+    }
+    free(transfers);
+    free(pfds);
+    free(owners);
+    return count - succeeded;
+}
+
+// ---------------------- Commandes ----------------------
+
+// Réglages des options et du parallélisme. Renvoie 0 si la commande n'en est pas un.
+int handle_setting(const char *command) {
+    if (strncmp(command, "blksize ", 8) == 0) {
+        int value = atoi(command + 8);
+        if (value != 0 && (value < MIN_BLKSIZE || value > MAX_BLKSIZE)) {
+            printf("tftp> blksize doit être 0 (aucune option) ou entre %d et %d.\n",
+                   MIN_BLKSIZE, MAX_BLKSIZE);
+        } else {
+            requested_blksize = value;
+        }
+    }
+    else if (strncmp(command, "windowsize ", 11) == 0) {
+        int value = atoi(command + 11);
+        if (value < 0 || value > MAX_WINDOWSIZE) {
+            printf("tftp> windowsize doit être 0 (aucune option) ou entre 1 et %d.\n",
+                   MAX_WINDOWSIZE);
+        } else {
+            requested_windowsize = value;
+        }
+    }
+    else if (strncmp(command, "timeout ", 8) == 0) {
+        int value = atoi(command + 8);
+        if (value < 0 || value > MAX_TIMEOUT) {
+            printf("tftp> timeout doit être 0 (aucune option) ou entre 1 et %d secondes.\n",
+                   MAX_TIMEOUT);
+        } else {
+            requested_timeout = value;
+        }
+    }
+    else if (strncmp(command, "rollover ", 9) == 0) {
+        int value = atoi(command + 9);
+        if (value < -1 || value > 1) {
+            printf("tftp> rollover doit être -1 (aucune option), 0 ou 1.\n");
+        } else {
+            requested_rollover = value;
+        }
+    }
+    else if (strncmp(command, "tsize ", 6) == 0) {
+        int value = atoi(command + 6);
+        if (value != 0 && value != 1) {
+            printf("tftp> tsize doit être 0 (aucune option) ou 1.\n");
+        } else {
+            requested_tsize = value;
+        }
+    }
+    else if (strncmp(command, "parallel ", 9) == 0) {
+        int value = atoi(command + 9);
+        if (value < 1 || value > MAX_PARALLEL) {
+            printf("tftp> parallel doit être entre 1 et %d.\n", MAX_PARALLEL);
+        } else {
+            max_parallel = value;
+        }
+    }
+    else if (strncmp(command, "stripes ", 8) == 0) {
+        int value = atoi(command + 8);
+        if (value < 1 || value > MAX_STRIPES) {
+            printf("tftp> stripes doit être entre 1 (une seule session) et %d.\n", MAX_STRIPES);
+        } else {
+            requested_stripes = value;
+        }
+    }
+    else if (strncmp(command, "multicast ", 10) == 0) {
+        int value = atoi(command + 10);
+        if (value != 0 && value != 1) {
+            printf("tftp> multicast doit être 0 (unicast) ou 1.\n");
+        } else {
+            requested_multicast = value;
+        }
+    }
+    else {
+        return 0;
+    }
+    return 1;
+}
+
+// Prépare un transfert avec les réglages en vigueur. Un GET découpé commence par
+// une sonde : offset 0 et tsize lui font connaître la taille du fichier et la prise
+// en charge des plages, sans retarder le transfert si le serveur les ignore.
+void make_request(transfer_request *req, int opcode, const char *filename, struct sockaddr_in server_addr) {
+    req->opcode = opcode;
+    strcpy(req->filename, filename);
+    request_options(server_addr, &req->opts);
+    req->stripes = opcode == RRQ && !requested_multicast ? requested_stripes : 1;
+    // Multicast : tsize dimensionne le fichier, dont les blocs arrivent dans le désordre
+    if (opcode == RRQ && requested_multicast)
+        req->opts.present |= OPT_MULTICAST | OPT_TSIZE;
+    if (req->stripes > 1) {
+        req->opts.present |= OPT_TSIZE | OPT_OFFSET;
+        req->opts.offset = 0;
+    }
+}
+
+// Ajoute un transfert à la liste ; les options en vigueur sont fixées maintenant
+int add_request(transfer_request **reqs, int *count, int *capacity, int opcode,
+                const char *filename, struct sockaddr_in server_addr) {
+    if (strlen(filename) >= sizeof((*reqs)->filename)) {
+        printf("tftp> Nom de fichier trop long : %s\n", filename);
+        return -1;
+    }
+    if (*count == *capacity) {
+        int grown_capacity = *capacity ? 2 * *capacity : 16;
+        transfer_request *grown = realloc(*reqs, grown_capacity * sizeof(**reqs));
+        if (!grown) {
+            perror("tftp> Allocation de la liste des transferts");
+            return -1;
+        }
+        *reqs = grown;
+        *capacity = grown_capacity;
+    }
+    make_request(&(*reqs)[(*count)++], opcode, filename, server_addr);
+    return 0;
+}
+
+// Mode non interactif : chaque ligne du manifeste est « get fichier », « put fichier »
+// ou un réglage (blksize, windowsize, parallel...) qui vaut pour les lignes suivantes.
+// Les lignes vides et celles qui commencent par # sont ignorées. Tous les transferts
+// sont ensuite menés ensemble. Renvoie le nombre de transferts échoués.
+int run_manifest(const char *path, struct sockaddr_in server_addr) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!fp) {
+        perror("tftp> Impossible d'ouvrir le manifeste");
+        return 1;
+    }
+    transfer_request *reqs = NULL;
+    int count = 0, capacity = 0, invalid = 0, line_no = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        line_no++;
+        line[strcspn(line, "\r\n")] = 0;
+        const char *command = line + strspn(line, " \t");
+        if (*command == 0 || *command == '#')
+            continue;
+        if (strncmp(command, "get ", 4) == 0 || strncmp(command, "put ", 4) == 0) {
+            if (add_request(&reqs, &count, &capacity, command[0] == 'g' ? RRQ : WRQ,
+                            command + 4, server_addr) < 0)
+                invalid++;
+        } else if (!handle_setting(command)) {
+            printf("tftp> Ligne %d du manifeste invalide : %s\n", line_no, command);
+            invalid++;
+        }
+    }
+    if (fp != stdin)
+        fclose(fp);
+    int failed = count > 0 ? run_transfers(server_addr, reqs, count) : 0;
+    free(reqs);
+    return failed + invalid;
+}
+
+// mget/mput : les noms séparés par des espaces sont transférés ensemble
+void run_many(char *names, int opcode, struct sockaddr_in server_addr) {
+    transfer_request *reqs = NULL;
+    int count = 0, capacity = 0;
+    for (char *name = strtok(names, " \t"); name; name = strtok(NULL, " \t"))
+        add_request(&reqs, &count, &capacity, opcode, name, server_addr);
+    if (count > 0)
+        run_transfers(server_addr, reqs, count);
+    else
+        printf("tftp> Aucun fichier indiqué.\n");
+    free(reqs);
+}
+
+// ---------------------- Fonction principale ----------------------
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <server_ip> [-f manifeste] [-j transferts_simultanés]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    const char *manifest = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:j:")) != -1) {
+        switch (opt) {
+            case 'f': manifest = optarg; break;
+            case 'j':
+                max_parallel = atoi(optarg);
+                if (max_parallel < 1 || max_parallel > MAX_PARALLEL)
+                    usage(argv[0]);
+                break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+        usage(argv[0]);
+
+    char *ip = argv[optind];
+    const int port = 6969;
+    struct sockaddr_in server_addr;
+    char command[256];
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    server_addr.sin_addr.s_addr = inet_addr(ip);
+
+    if (manifest)
+        return run_manifest(manifest, server_addr) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+    // Boucle interactive de commandes ; chaque transfert a son propre socket
+    while (1) {
+        printf("tftp> ");
+        if (!fgets(command, sizeof(command), stdin))
+            break;
+        command[strcspn(command, "\n")] = 0;
+
+        if (strncmp(command, "put ", 4) == 0 || strncmp(command, "get ", 4) == 0) {
+            transfer_request req;
+            make_request(&req, command[0] == 'p' ? WRQ : RRQ, command + 4, server_addr);
+            run_transfers(server_addr, &req, 1);
+        }
+        else if (strncmp(command, "mput ", 5) == 0) {
+            run_many(command + 5, WRQ, server_addr);
+        }
+        else if (strncmp(command, "mget ", 5) == 0) {
+            run_many(command + 5, RRQ, server_addr);
+        }
+        else if (handle_setting(command)) {
+            continue;
+        }
+        else if (strcmp(command, "quit") == 0) {
+            break;
+        }
+        else {
+            printf("tftp> Commande invalide.\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+
+#include "TftpOptions.h"
+#include "TftpPacket.h"
+#include "Rtt.h"
+
+// Microbenchmark du codec de paquets (TftpPacket) : paquets décodés ou codés
+// par seconde pour chaque type de paquet, puis passe de robustesse sur des
+// paquets valides altérés au hasard. Chaque paquet altéré est placé juste
+// avant une page protégée : une lecture au-delà de sa fin arrête le programme
+// (SIGSEGV), et les champs décodés sont vérifiés. Une même graine (-x) rejoue
+// les mêmes paquets.
+
+#define BATCH 4096          // Itérations entre deux lectures de l'horloge
+#define MAX_MUTATED 1024    // Taille maximale d'un paquet altéré
+
+typedef struct {
+    char buf[MAX_PACKET_SIZE];
+    int len;
+} sample;
+
+// Paquets de référence, construits par le codec lui-même
+static sample rrq, wrq, oack, data, ack, error;
+
+static volatile long sink;  // Empêche le compilateur d'éliminer les décodages
+
+static long bench_rrq(long iterations) {
+    long sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        int opcode;
+        const char *filename;
+        tftp_mode mode;
+        tftp_options opts;
+        if (parse_request(rrq.buf, rrq.len, &opcode, &filename, &mode, &opts) == 0)
+            sum += opts.blksize + opts.windowsize + (filename - rrq.buf);
+    }
+    return sum;
+}
+
+static long bench_oack(long iterations) {
+    long sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        tftp_options opts;
+        if (parse_oack(oack.buf, oack.len, &opts) == 0)
+            sum += opts.blksize + opts.tsize;
+    }
+    return sum;
+}
+
+static long bench_data(long iterations) {
+    long sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        if (packet_opcode(data.buf, data.len) == DATA)
+            sum += packet_block(data.buf) + data.len - TFTP_HEADER_SIZE;
+    }
+    return sum;
+}
+
+static long bench_error(long iterations) {
+    long sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        int code, msg_len;
+        const char *msg;
+        if (parse_error(error.buf, error.len, &code, &msg, &msg_len) == 0)
+            sum += code + msg_len;
+    }
+    return sum;
+}
+
+static long bench_encode_ack(long iterations) {
+    char buf[TFTP_HEADER_SIZE];
+    long sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        sum += encode_ack(buf, i & 0xFFFF);
+        sum += buf[3];
+    }
+    return sum;
+}
+
+static long bench_encode_error(long iterations) {
+    char buf[MAX_PACKET_SIZE];
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+        sum += encode_error(buf, sizeof(buf), 1, "Fichier introuvable");
+    return sum;
+}
+
+static long bench_build_oack(long iterations) {
+    tftp_options opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.present = OPT_BLKSIZE | OPT_WINDOWSIZE | OPT_TSIZE;
+    opts.blksize = 1468;
+    opts.windowsize = 16;
+    char buf[MAX_PACKET_SIZE];
+    long sum = 0;
+    for (long i = 0; i < iterations; i++) {
+        opts.tsize = i;
+        sum += build_oack(buf, sizeof(buf), &opts);
+    }
+    return sum;
+}
+
+// Répète fn par lots jusqu'à seconds secondes et affiche le débit obtenu
+static void run_bench(const char *name, long (*fn)(long), double seconds) {
+    long long t0 = rtt_now_us(), elapsed;
+    long done = 0;
+    do {
+        sink += fn(BATCH);
+        done += BATCH;
+        elapsed = rtt_now_us() - t0;
+    } while (elapsed < seconds * 1e6);
+    printf("%9.2f M paquets/s (%6.1f ns/paquet)  %s\n",
+           done / (double)elapsed, elapsed * 1000.0 / done, name);
+}
+
+static void build_samples(void) {
+    tftp_options opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.present = OPT_BLKSIZE | OPT_WINDOWSIZE | OPT_TIMEOUT | OPT_TSIZE;
+    opts.blksize = 1468;
+    opts.windowsize = 16;
+    opts.timeout = 5;
+    rrq.len = build_request(rrq.buf, sizeof(rrq.buf), RRQ, "images/noyau-6.8.img", &opts);
+    opts.tsize = 1048576;
+    wrq.len = build_request(wrq.buf, sizeof(wrq.buf), WRQ, "bench-put.bin", &opts);
+
+    opts.present = OPT_BLKSIZE | OPT_TSIZE | OPT_MULTICAST;
+    opts.tsize = 20000123;
+    opts.mcast_addr.s_addr = htonl(0xEFFF4501);  // 239.255.69.1
+    opts.mcast_port = 1758;
+    opts.mcast_master = 1;
+    oack.len = build_oack(oack.buf, sizeof(oack.buf), &opts);
+
+    encode_data_header(data.buf, 4242);
+    memset(data.buf + TFTP_HEADER_SIZE, 'x', 1468);
+    data.len = TFTP_HEADER_SIZE + 1468;
+    ack.len = encode_ack(ack.buf, 4242);
+    error.len = encode_error(error.buf, sizeof(error.buf), 1, "Fichier introuvable");
+}
+
+// xorshift64*
+static unsigned long long next_random(unsigned long long *state) {
+    unsigned long long x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Altère un paquet : octets changés (souvent en '\0' ou en chiffre, qui
+// déplacent les séparateurs et les valeurs d'options), troncature, ajout
+static int mutate(char *buf, int len, unsigned long long *rng) {
+    static const char interesting[] = { '\0', '\0', '0', '9', ',', '.', (char)0xFF, 'a' };
+    int changes = 1 + next_random(rng) % 4;
+    for (int c = 0; c < changes; c++) {
+        unsigned long long r = next_random(rng);
+        switch (r % 4) {
+            case 0:
+                if (len > 0)
+                    buf[(r >> 8) % len] = interesting[(r >> 40) % sizeof(interesting)];
+                break;
+            case 1:
+                if (len > 0)
+                    buf[(r >> 8) % len] = (char)(r >> 40);
+                break;
+            case 2:
+                len = (r >> 8) % (len + 1);
+                break;
+            default: {
+                int extra = (r >> 8) % 16;
+                for (int k = 0; k < extra && len < MAX_MUTATED; k++)
+                    buf[len++] = (char)next_random(rng);
+                break;
+            }
+        }
+    }
+    return len;
+}
+
+static void fail(const char *what, const char *buf, int len) {
+    fprintf(stderr, "Décodage incohérent (%s) pour un paquet de %d octets :", what, len);
+    for (int i = 0; i < len; i++)
+        fprintf(stderr, " %02x", (unsigned char)buf[i]);
+    fprintf(stderr, "\n");
+    exit(EXIT_FAILURE);
+}
+
+static void check_options(const tftp_options *opts, const char *buf, int len) {
+    if (((opts->present & OPT_BLKSIZE) && (opts->blksize < MIN_BLKSIZE || opts->blksize > MAX_BLKSIZE)) ||
+        ((opts->present & OPT_WINDOWSIZE) && (opts->windowsize < 1 || opts->windowsize > MAX_WINDOWSIZE)) ||
+        ((opts->present & OPT_TIMEOUT) && (opts->timeout < 1 || opts->timeout > MAX_TIMEOUT)) ||
+        ((opts->present & OPT_ROLLOVER) && opts->rollover != 0 && opts->rollover != 1) ||
+        ((opts->present & OPT_TSIZE) && opts->tsize < 0) ||
+        ((opts->present & OPT_MULTICAST) && (opts->mcast_port < 0 || opts->mcast_port > 65535)))
+        fail("options", buf, len);
+}
+
+// Décode count paquets altérés ; chacun se termine à la fin de la page lisible
+static void run_mutations(long count, unsigned long long seed) {
+    long page = sysconf(_SC_PAGESIZE);
+    char *area = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED || mprotect(area + page, page, PROT_NONE) < 0) {
+        perror("Page de garde");
+        exit(EXIT_FAILURE);
+    }
+    const sample *corpus[] = { &rrq, &wrq, &oack, &data, &ack, &error };
+    int ncorpus = sizeof(corpus) / sizeof(corpus[0]);
+    unsigned long long rng = seed ? seed : 1;
+    long requests = 0, oacks = 0, errors = 0;
+    char scratch[MAX_MUTATED];
+    long long t0 = rtt_now_us();
+    for (long i = 0; i < count; i++) {
+        const sample *base = corpus[next_random(&rng) % ncorpus];
+        int len = base->len < MAX_MUTATED ? base->len : MAX_MUTATED;
+        memcpy(scratch, base->buf, len);
+        len = mutate(scratch, len, &rng);
+        char *buf = area + page - len;
+        memcpy(buf, scratch, len);
+
+        int opcode, code, msg_len;
+        const char *filename, *msg;
+        tftp_mode mode;
+        tftp_options opts;
+        if (parse_request(buf, len, &opcode, &filename, &mode, &opts) == 0) {
+            if ((opcode != RRQ && opcode != WRQ) || filename != buf + 2 || *filename == '\0' ||
+                memchr(filename, '\0', len - 2) == NULL)
+                fail("requête", buf, len);
+            check_options(&opts, buf, len);
+            requests++;
+        }
+        if (parse_oack(buf, len, &opts) == 0) {
+            check_options(&opts, buf, len);
+            oacks++;
+        }
+        if (parse_error(buf, len, &code, &msg, &msg_len) == 0) {
+            if (msg != buf + TFTP_HEADER_SIZE || msg_len < 0 || msg_len > len - TFTP_HEADER_SIZE)
+                fail("ERROR", buf, len);
+            errors++;
+        }
+        if (packet_opcode(buf, len) >= 0 && len >= TFTP_HEADER_SIZE)
+            sink += packet_block(buf);
+    }
+    double elapsed = (rtt_now_us() - t0) / 1e6;
+    printf("Paquets altérés : %ld (graine %llu) en %.2f s, acceptés : %ld requêtes, %ld OACK, %ld ERROR\n",
+           count, seed, elapsed, requests, oacks, errors);
+    munmap(area, 2 * page);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s secondes_par_mesure] [-n paquets_altérés] [-x graine]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = 1;
+    long mutations = 1000000;
+    unsigned long long seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:x:")) != -1) {
+        switch (opt) {
+            case 's': seconds = atof(optarg); break;
+            case 'n': mutations = atol(optarg); break;
+            case 'x': seed = strtoull(optarg, NULL, 10); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (seconds <= 0 || mutations < 0)
+        usage(argv[0]);
+
+    build_samples();
+    run_bench("Décodage RRQ (4 options)", bench_rrq, seconds);
+    run_bench("Décodage OACK (3 options)", bench_oack, seconds);
+    run_bench("Décodage en-tête DATA", bench_data, seconds);
+    run_bench("Décodage ERROR", bench_error, seconds);
+    run_bench("Codage ACK", bench_encode_ack, seconds);
+    run_bench("Codage ERROR", bench_encode_error, seconds);
+    run_bench("Codage OACK (3 options)", bench_build_oack, seconds);
+    run_mutations(mutations, seed);
+    return EXIT_SUCCESS;
+}
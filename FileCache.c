@@ -0,0 +1,316 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "FileCache.h"
+
+#define CACHE_BUCKETS 256
+
+struct cache_entry {
+    char *name;                 // Nom relatif au répertoire servi
+    file_map map;               // Contenu en mémoire (taille réservée pendant le chargement)
+    int refs;                   // Sessions qui servent cette entrée, et le thread qui la charge
+    int linked;                 // Présente dans la table (0 une fois invalidée ou évincée)
+    int loading;                // Confiée au thread de chargement, pas encore servie
+    cache_entry *hash_next;
+    cache_entry *lru_prev, *lru_next;  // Tête : la plus récemment utilisée
+    cache_entry *load_next;     // Suivante dans la file de chargement
+};
+
+static struct {
+    pthread_mutex_t lock;
+    char dir[PATH_MAX];
+    size_t budget;
+    int inotify_fd;
+    cache_entry *buckets[CACHE_BUCKETS];
+    cache_entry *lru_head, *lru_tail;
+    cache_entry *load_head, *load_tail;  // Entrées en attente du thread de chargement
+    pthread_cond_t load_ready;
+    file_cache_stats stats;
+} cache = { .lock = PTHREAD_MUTEX_INITIALIZER, .inotify_fd = -1, .load_ready = PTHREAD_COND_INITIALIZER };
+
+static unsigned int name_hash(const char *name) {
+    unsigned int h = 2166136261u;  // FNV-1a
+    for (; *name; name++)
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    return h % CACHE_BUCKETS;
+}
+
+static void *loader_main(void *arg);
+
+int file_cache_init(const char *dir, size_t budget) {
+    snprintf(cache.dir, sizeof(cache.dir), "%s", dir);
+    cache.budget = budget;
+    cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cache.inotify_fd < 0)
+        return -1;
+    // Toute écriture, remplacement ou suppression d'un fichier du répertoire
+    uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM |
+                    IN_MOVED_TO | IN_DELETE | IN_DELETE_SELF | IN_MOVE_SELF;
+    pthread_t loader;
+    if (inotify_add_watch(cache.inotify_fd, dir, mask) < 0 ||
+        pthread_create(&loader, NULL, loader_main, NULL) != 0) {
+        close(cache.inotify_fd);
+        cache.inotify_fd = -1;
+        return -1;
+    }
+    pthread_detach(loader);
+    return 0;
+}
+
+int file_cache_fd(void) {
+    return cache.inotify_fd;
+}
+
+// Verrou tenu : la mémoire de l'entrée sort du budget
+static void entry_free(cache_entry *entry) {
+    cache.stats.bytes -= entry->map.size;
+    free((void *)entry->map.data);
+    free(entry->name);
+    free(entry);
+}
+
+// Retire l'entrée de la table et de la liste LRU ; elle est libérée quand
+// plus aucune session ne la sert, et sa mémoire compte dans le budget
+// jusque-là. Verrou tenu.
+static void entry_unlink(cache_entry *entry) {
+    cache_entry **link = &cache.buckets[name_hash(entry->name)];
+    while (*link != entry)
+        link = &(*link)->hash_next;
+    *link = entry->hash_next;
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        cache.lru_head = entry->lru_next;
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        cache.lru_tail = entry->lru_prev;
+    entry->linked = 0;
+    cache.stats.entries--;
+    if (entry->refs == 0)
+        entry_free(entry);
+}
+
+static void lru_push_front(cache_entry *entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache.lru_head;
+    if (cache.lru_head)
+        cache.lru_head->lru_prev = entry;
+    cache.lru_head = entry;
+    if (!cache.lru_tail)
+        cache.lru_tail = entry;
+}
+
+static cache_entry *lookup(const char *name) {
+    for (cache_entry *e = cache.buckets[name_hash(name)]; e; e = e->hash_next) {
+        if (strcmp(e->name, name) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static void invalidate_all(void) {
+    while (cache.lru_head) {
+        entry_unlink(cache.lru_head);
+        cache.stats.invalidations++;
+    }
+}
+
+void file_cache_process_events(int blocking) {
+    if (cache.inotify_fd < 0)
+        return;
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    if (blocking) {
+        // Attente d'au moins un événement sans tenir le verrou
+        struct pollfd pfd = { .fd = cache.inotify_fd, .events = POLLIN };
+        while (poll(&pfd, 1, -1) < 0 && errno == EINTR)
+            ;
+    }
+    while (1) {
+        ssize_t len = read(cache.inotify_fd, buf, sizeof(buf));
+        if (len <= 0)
+            break;
+        pthread_mutex_lock(&cache.lock);
+        for (char *p = buf; p < buf + len; ) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            if (ev->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                // Événements perdus ou répertoire déplacé : plus rien n'est sûr
+                invalidate_all();
+            } else if (ev->len > 0) {
+                cache_entry *entry = lookup(ev->name);
+                if (entry) {
+                    entry_unlink(entry);
+                    cache.stats.invalidations++;
+                }
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+        pthread_mutex_unlock(&cache.lock);
+    }
+}
+
+// Lit size octets de fd dans un tampon alloué. Renvoie NULL en cas d'erreur
+// ou si le fichier a raccourci.
+static char *read_file(int fd, size_t size) {
+    char *data = malloc(size > 0 ? size : 1);
+    size_t done = 0;
+    while (data && done < size) {
+        ssize_t n = read(fd, data + done, size - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    if (data && done != size) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+// Évince les entrées les moins récemment utilisées et non servies jusqu'à ce
+// que size octets de plus tiennent dans le budget. Renvoie -1 si la place
+// manque malgré tout. Verrou tenu.
+static int make_room(size_t size) {
+    cache_entry *victim = cache.lru_tail;
+    while (cache.stats.bytes + size > cache.budget && victim) {
+        cache_entry *prev = victim->lru_prev;
+        if (victim->refs == 0) {
+            entry_unlink(victim);
+            cache.stats.evictions++;
+        }
+        victim = prev;
+    }
+    return cache.stats.bytes + size <= cache.budget ? 0 : -1;
+}
+
+// Charge une entrée hors verrou. Sa place est réservée dans le budget avant la
+// lecture : des chargements simultanés ne le dépassent pas. Une entrée
+// invalidée pendant le chargement (fichier modifié) n'est jamais servie.
+static void load_entry(cache_entry *entry) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s%s", cache.dir, entry->name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    int ok = fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (size_t)st.st_size <= cache.budget;
+
+    pthread_mutex_lock(&cache.lock);
+    ok = ok && entry->linked && make_room(st.st_size) == 0;
+    if (ok) {
+        entry->map.size = st.st_size;
+        cache.stats.bytes += st.st_size;
+    }
+    pthread_mutex_unlock(&cache.lock);
+
+    char *data = ok ? read_file(fd, st.st_size) : NULL;
+    if (fd >= 0)
+        close(fd);
+
+    pthread_mutex_lock(&cache.lock);
+    entry->map.data = data;
+    entry->loading = 0;
+    // Échec : l'entrée est retirée, une requête suivante relancera le chargement
+    if (!data && entry->linked)
+        entry_unlink(entry);
+    if (--entry->refs == 0 && !entry->linked)
+        entry_free(entry);
+    pthread_mutex_unlock(&cache.lock);
+}
+
+// Thread de chargement : lit les fichiers demandés, dans l'ordre des requêtes
+static void *loader_main(void *arg) {
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&cache.lock);
+        while (!cache.load_head)
+            pthread_cond_wait(&cache.load_ready, &cache.lock);
+        cache_entry *entry = cache.load_head;
+        cache.load_head = entry->load_next;
+        if (!cache.load_head)
+            cache.load_tail = NULL;
+        pthread_mutex_unlock(&cache.lock);
+        load_entry(entry);
+    }
+    return NULL;
+}
+
+cache_entry *file_cache_acquire(const char *filename) {
+    // Seuls les fichiers du répertoire surveillé (pas ses sous-répertoires) sont mis en cache
+    if (cache.inotify_fd < 0 || strchr(filename, '/'))
+        return NULL;
+    // Les invalidations en attente passent avant toute recherche
+    file_cache_process_events(0);
+
+    pthread_mutex_lock(&cache.lock);
+    cache_entry *entry = lookup(filename);
+    if (entry && !entry->loading) {
+        cache.stats.hits++;
+        entry->refs++;
+        if (cache.lru_head != entry) {
+            // Remontée en tête de la liste LRU
+            entry->lru_prev->lru_next = entry->lru_next;
+            if (entry->lru_next)
+                entry->lru_next->lru_prev = entry->lru_prev;
+            else
+                cache.lru_tail = entry->lru_prev;
+            lru_push_front(entry);
+        }
+        pthread_mutex_unlock(&cache.lock);
+        return entry;
+    }
+    cache.stats.misses++;
+    // Premier défaut : une entrée en cours de chargement est confiée au thread
+    // de chargement. Elle évite les chargements en double ; d'ici sa fin, les
+    // requêtes du même fichier le lisent elles-mêmes, sans attendre.
+    if (!entry) {
+        entry = calloc(1, sizeof(*entry));
+        if (!entry || !(entry->name = strdup(filename))) {
+            free(entry);
+            pthread_mutex_unlock(&cache.lock);
+            return NULL;
+        }
+        entry->loading = 1;
+        entry->refs = 1;
+        entry->linked = 1;
+        unsigned int h = name_hash(filename);
+        entry->hash_next = cache.buckets[h];
+        cache.buckets[h] = entry;
+        lru_push_front(entry);
+        cache.stats.entries++;
+        if (cache.load_tail)
+            cache.load_tail->load_next = entry;
+        else
+            cache.load_head = entry;
+        cache.load_tail = entry;
+        pthread_cond_signal(&cache.load_ready);
+    }
+    pthread_mutex_unlock(&cache.lock);
+    return NULL;
+}
+
+const file_map *file_cache_map(const cache_entry *entry) {
+    return &entry->map;
+}
+
+void file_cache_release(cache_entry *entry) {
+    pthread_mutex_lock(&cache.lock);
+    if (--entry->refs == 0 && !entry->linked)
+        entry_free(entry);
+    pthread_mutex_unlock(&cache.lock);
+}
+
+void file_cache_get_stats(file_cache_stats *stats) {
+    pthread_mutex_lock(&cache.lock);
+    *stats = cache.stats;
+    pthread_mutex_unlock(&cache.lock);
+}
@@ -0,0 +1,53 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <stddef.h>
+
+#include "FileMap.h"
+
+// Cache LRU du contenu des fichiers servis, partagé par toutes les sessions.
+// Le premier RRQ d'un fichier le fait charger en mémoire par un thread dédié,
+// sans bloquer l'appelant ; les RRQ suivants sont servis sans accès disque.
+// inotify sur le répertoire invalide une entrée dès que son fichier est
+// modifié, remplacé ou supprimé. Le budget compte aussi les entrées retirées
+// tant que des sessions les servent encore.
+
+#define DEFAULT_CACHE_MB 256  // Budget mémoire par défaut du cache
+
+typedef struct cache_entry cache_entry;
+
+typedef struct {
+    unsigned long hits;           // RRQ servis depuis le cache
+    unsigned long misses;         // RRQ ayant chargé le fichier
+    unsigned long evictions;      // Entrées retirées pour respecter le budget
+    unsigned long invalidations;  // Entrées retirées sur événement inotify
+    size_t bytes;                 // Mémoire des entrées, retirées mais encore servies comprises
+    int entries;
+} file_cache_stats;
+
+// Initialise le cache sur dir (chemin terminé par '/') avec un budget en octets.
+// Renvoie -1 si inotify n'est pas disponible : le cache reste alors désactivé.
+int file_cache_init(const char *dir, size_t budget);
+
+// Descripteur inotify à surveiller en lecture (-1 si le cache est désactivé)
+int file_cache_fd(void);
+
+// Traite les événements inotify en attente. Si blocking, attend au moins un événement.
+void file_cache_process_events(int blocking);
+
+// Contenu de filename (relatif à dir). L'entrée est réservée jusqu'à
+// file_cache_release. Renvoie NULL si le fichier n'est pas encore en mémoire
+// (son chargement est alors lancé, une seule fois pour tous les appelants) ou
+// ne peut pas être mis en cache (cache désactivé, sous-répertoire, fichier plus
+// grand que le budget, erreur de lecture) : l'appelant lit alors le fichier
+// lui-même.
+cache_entry *file_cache_acquire(const char *filename);
+
+// Vue du contenu d'une entrée réservée
+const file_map *file_cache_map(const cache_entry *entry);
+
+void file_cache_release(cache_entry *entry);
+
+void file_cache_get_stats(file_cache_stats *stats);
+
+#endif
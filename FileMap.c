@@ -0,0 +1,50 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "FileMap.h"
+
+int file_map_open(file_map *map, int fd) {
+    struct stat st;
+    map->data = NULL;
+    map->size = 0;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size > MMAP_MAX_SIZE)
+        return -1;
+    map->size = st.st_size;
+    if (map->size == 0)
+        return 0;  // Rien à projeter : un seul bloc DATA vide
+    void *data = mmap(NULL, map->size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        map->size = 0;
+        return -1;
+    }
+    // Les blocs sont lus dans l'ordre : lecture anticipée agressive
+    madvise(data, map->size, MADV_SEQUENTIAL);
+    map->data = data;
+    return 0;
+}
+
+void file_map_close(file_map *map) {
+    if (map->data)
+        munmap((void *)map->data, map->size);
+    map->data = NULL;
+    map->size = 0;
+}
+
+file_map file_map_slice(const file_map *map, size_t offset, size_t length) {
+    file_map view = { NULL, 0 };
+    if (offset >= map->size)
+        return view;
+    view.data = map->data + offset;
+    view.size = map->size - offset < length ? map->size - offset : length;
+    return view;
+}
+
+const char *file_map_block(const file_map *map, long block_num, int blksize, size_t *len) {
+    size_t offset = (size_t)(block_num - 1) * blksize;
+    if (offset >= map->size) {
+        *len = 0;
+        return NULL;
+    }
+    *len = map->size - offset < (size_t)blksize ? map->size - offset : (size_t)blksize;
+    return map->data + offset;
+}
@@ -0,0 +1,30 @@
+#ifndef FILE_MAP_H
+#define FILE_MAP_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Projection en mémoire d'un fichier servi en lecture : les blocs DATA sont
+// envoyés directement depuis la projection, sans copie en espace utilisateur.
+
+#define MMAP_MAX_SIZE ((off_t)1 << 32)  // Au-delà, le fichier est lu par stdio
+
+typedef struct {
+    const char *data;   // Contenu du fichier (NULL s'il est vide)
+    size_t size;        // Taille du fichier
+} file_map;
+
+// Projette le fichier ouvert sur fd. Renvoie -1 si le fichier est trop grand
+// ou ne peut pas être projeté : l'appelant revient alors à la lecture par stdio.
+int file_map_open(file_map *map, int fd);
+
+void file_map_close(file_map *map);
+
+// Vue sur les octets [offset, offset + length) d'une projection, bornée à sa taille ;
+// elle se lit comme une projection mais ne se ferme pas
+file_map file_map_slice(const file_map *map, size_t offset, size_t length);
+
+// Adresse et longueur du bloc block_num (numéroté à partir de 1) de blksize octets
+const char *file_map_block(const file_map *map, long block_num, int blksize, size_t *len);
+
+#endif
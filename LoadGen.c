@@ -0,0 +1,630 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include "TftpOptions.h"
+#include "TftpPacket.h"
+#include "Rtt.h"
+
+// Générateur de charge : simule N clients TFTP simultanés (GET ou PUT) contre
+// un serveur, sans interaction, et mesure débit, latence des transferts,
+// retransmissions et temps CPU par octet. Tous les transferts sont menés par
+// une seule boucle epoll ; les données reçues sont comptées puis jetées.
+//
+// Avec -o mcast, les GET demandent l'option multicast (RFC 2090) : les clients
+// simultanés d'un même fichier partagent le flux d'un groupe. -k simule la
+// panne du premier maître, qui se tait une fois passé le bloc donné : les
+// clients restants doivent tout de même recevoir le fichier.
+
+#define DEFAULT_PORT 6969
+#define DEFAULT_PUT_SIZE (1024 * 1024)
+#define TICK_US 5000                     // Période de vérification des échéances
+#define MAX_EVENTS 256
+#define RCVBUF_MAX (4 * 1024 * 1024)
+
+typedef enum {
+    XFER_FREE = 0,
+    XFER_GET,
+    XFER_PUT,
+    XFER_MCAST
+} xfer_kind;
+
+typedef struct {
+    xfer_kind kind;
+    int fd;
+    struct sockaddr_in peer;        // Port de session du serveur, fixé par sa première réponse
+    int answered;                   // Le serveur a répondu à la requête
+    char request[512];
+    int req_len;
+    int blksize;
+    int windowsize;
+    rtt_estimator rtt;
+    long long start_us;             // Envoi de la requête
+    long long sent_us;              // Dernier envoi attendant une réponse
+    long long deadline_us;
+    int retransmitted;
+    long long next_block;           // GET : prochain bloc attendu
+    long long ooo_block;            // GET : dernier bloc hors séquence (-1 si aucun)
+    int window_count;               // GET : blocs reçus depuis le dernier ACK
+    long long acked;                // PUT : dernier bloc acquitté
+    long long sent;                 // PUT : dernier bloc de la fenêtre envoyée
+    long long last_block;           // PUT et MCAST : dernier bloc du fichier
+    long long bytes;
+    int mcast_fd;                   // MCAST : socket abonné au groupe (-1 sinon)
+    int master;                     // MCAST : ce client acquitte pour le groupe
+    unsigned char *have;            // MCAST : blocs reçus, dans n'importe quel ordre
+    long long received;             // MCAST : nombre de blocs reçus
+} xfer;
+
+// Paramètres de la charge
+static struct sockaddr_in server;
+static xfer_kind mode = XFER_GET;
+static int mix;                      // Option -o mix : GET et PUT en alternance
+static const char *remote_name = "bench.bin";
+static long long put_size = DEFAULT_PUT_SIZE;
+static int req_blksize = 1468;
+static int req_windowsize = 16;
+static long long kill_block;         // Option -k : bloc après lequel le premier maître se tait
+
+// Résultats
+static long long *latencies;
+static int completed, failed, killed;
+static long long total_bytes;
+static unsigned long retransmits;
+
+static xfer *xfers;
+static int epfd;
+static char rx_buf[MAX_PACKET_SIZE];
+static char tx_buf[MAX_PACKET_SIZE];  // En-tête DATA suivi de données nulles
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s serveur] [-p port] [-n clients] [-t transferts] [-r requêtes/s] "
+            "[-o get|put|mix|mcast] [-f fichier] [-S taille_put] [-b blksize] [-w windowsize] "
+            "[-k bloc] [-P pid_serveur]\n"
+            "  Un %%d dans le nom de fichier est remplacé par le numéro du transfert.\n"
+            "  -k : avec -o mcast, le premier maître s'arrête sans prévenir après ce bloc\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+// Nom distant du transfert : %d remplacé par son numéro. Le serveur garde le verrou
+// d'un fichier reçu quelques délais après le dernier ACK : un PUT par fichier.
+static void remote_file(char *buf, size_t size, int seq) {
+    const char *mark = strstr(remote_name, "%d");
+    if (mark)
+        snprintf(buf, size, "%.*s%d%s", (int)(mark - remote_name), remote_name, seq, mark + 2);
+    else
+        snprintf(buf, size, "%s", remote_name);
+}
+
+static void send_to_peer(xfer *x, const void *buf, int len) {
+    sendto(x->fd, buf, len, 0, (struct sockaddr*)&x->peer, sizeof(x->peer));
+}
+
+static void send_ack(xfer *x, long long block) {
+    unsigned int wire = block_to_wire(block, 0);
+    char ack[TFTP_HEADER_SIZE];
+    send_to_peer(x, ack, encode_ack(ack, wire));
+}
+
+static void arm(xfer *x, long long now, int retransmitted) {
+    x->sent_us = now;
+    x->retransmitted = retransmitted;
+    x->deadline_us = now + x->rtt.rto_us;
+}
+
+// Envoie la fenêtre qui suit le dernier bloc acquitté
+static void send_window(xfer *x, int retransmitted) {
+    long long end = x->acked + x->windowsize;
+    if (end > x->last_block)
+        end = x->last_block;
+    for (long long block = x->acked + 1; block <= end; block++) {
+        unsigned int wire = block_to_wire(block, 0);
+        long long left = put_size - (block - 1) * x->blksize;
+        int len = left < x->blksize ? (int)left : x->blksize;
+        encode_data_header(tx_buf, wire);
+        send_to_peer(x, tx_buf, len + 4);
+    }
+    x->sent = end;
+    arm(x, rtt_now_us(), retransmitted);
+}
+
+// Libère le client simulé, sans rien envoyer
+static void release(xfer *x) {
+    close(x->fd);  // Le retire aussi de l'instance epoll
+    if (x->mcast_fd >= 0)
+        close(x->mcast_fd);
+    free(x->have);
+    x->have = NULL;
+    x->kind = XFER_FREE;
+}
+
+static void finish(xfer *x, int ok) {
+    long long now = rtt_now_us();
+    if (ok) {
+        latencies[completed++] = now - x->start_us;
+        total_bytes += x->bytes;
+    } else {
+        failed++;
+    }
+    release(x);
+}
+
+// Une fenêtre entière doit tenir dans le tampon de réception (borné par net.core.rmem_max)
+static void set_rcvbuf(int fd) {
+    int rcvbuf = 2 * (req_windowsize > 0 ? req_windowsize : 1) * (req_blksize > 0 ? req_blksize + 4 : 516);
+    if (rcvbuf > RCVBUF_MAX)
+        rcvbuf = RCVBUF_MAX;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+}
+
+static int start_xfer(int client, int seq, xfer_kind kind) {
+    xfer *x = &xfers[client];
+    memset(x, 0, sizeof(*x));
+    x->mcast_fd = -1;
+    x->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (x->fd < 0)
+        return -1;
+    set_rcvbuf(x->fd);
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = client };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, x->fd, &ev) < 0) {
+        close(x->fd);
+        return -1;
+    }
+    x->kind = kind;
+    x->peer = server;
+    x->blksize = DEFAULT_BLKSIZE;
+    x->windowsize = DEFAULT_WINDOWSIZE;
+    x->next_block = 1;
+    x->ooo_block = -1;
+    rtt_init(&x->rtt, 0);
+
+    tftp_options opts;
+    memset(&opts, 0, sizeof(opts));
+    if (req_blksize > 0) {
+        opts.present |= OPT_BLKSIZE;
+        opts.blksize = req_blksize;
+    }
+    if (req_windowsize > 0) {
+        opts.present |= OPT_WINDOWSIZE;
+        opts.windowsize = req_windowsize;
+    }
+    if (kind == XFER_PUT) {
+        opts.present |= OPT_TSIZE;
+        opts.tsize = put_size;
+    }
+    if (kind == XFER_MCAST)
+        opts.present |= OPT_TSIZE | OPT_MULTICAST;  // Le groupe a besoin de la taille du fichier
+    char name[256];
+    remote_file(name, sizeof(name), seq);
+    x->req_len = build_request(x->request, sizeof(x->request), kind == XFER_PUT ? WRQ : RRQ, name, &opts);
+    if (x->req_len < 0) {
+        close(x->fd);
+        x->kind = XFER_FREE;
+        return -1;
+    }
+    long long now = rtt_now_us();
+    x->start_us = now;
+    send_to_peer(x, x->request, x->req_len);
+    arm(x, now, 0);
+    return 0;
+}
+
+// Première réponse du serveur : port de session et options retenues
+static void answer(xfer *x, const struct sockaddr_in *from, const char *buf, int n, int oack) {
+    x->answered = 1;
+    x->peer = *from;
+    if (oack) {
+        tftp_options accepted;
+        if (parse_oack(buf, n, &accepted) == 0) {
+            if (accepted.present & OPT_BLKSIZE)
+                x->blksize = accepted.blksize;
+            if (accepted.present & OPT_WINDOWSIZE)
+                x->windowsize = accepted.windowsize;
+        }
+    }
+    x->last_block = put_size / x->blksize + 1;
+}
+
+static void handle_get(xfer *x, const struct sockaddr_in *from, int opcode, int n) {
+    long long now = rtt_now_us();
+    if (opcode == OACK) {
+        if (!x->answered) {
+            answer(x, from, rx_buf, n, 1);
+            rtt_progress(&x->rtt, x->sent_us, x->retransmitted);
+        }
+        if (x->next_block == 1) {
+            send_ack(x, 0);
+            arm(x, now, 0);
+        }
+        return;
+    }
+    if (opcode != DATA)
+        return;
+    if (!x->answered)
+        answer(x, from, rx_buf, n, 0);
+    unsigned int wire = packet_block(rx_buf);
+    long long block = block_from_wire(wire, x->next_block - 1, 0);
+    if (block != x->next_block) {
+        // Perte ou doublon : un ACK du dernier bloc reçu dans l'ordre par passage de fenêtre
+        if (x->ooo_block < 0 || block <= x->ooo_block) {
+            send_ack(x, x->next_block - 1);
+            x->window_count = 0;
+            arm(x, now, 1);
+        }
+        x->ooo_block = block;
+        return;
+    }
+    int len = n - 4;
+    x->bytes += len;
+    x->next_block++;
+    x->ooo_block = -1;
+    rtt_progress(&x->rtt, x->sent_us, x->retransmitted || x->window_count > 0);
+    if (len < x->blksize) {
+        send_ack(x, block);
+        finish(x, 1);
+        return;
+    }
+    if (++x->window_count >= x->windowsize) {
+        send_ack(x, block);
+        x->window_count = 0;
+        arm(x, now, 0);
+    } else {
+        x->deadline_us = now + x->rtt.rto_us;
+    }
+}
+
+static void handle_put(xfer *x, const struct sockaddr_in *from, int opcode, int n) {
+    if (opcode == OACK || (opcode == ACK && !x->answered)) {
+        if (x->answered)
+            return;  // OACK ou ACK(0) en double
+        answer(x, from, rx_buf, n, opcode == OACK);
+        rtt_progress(&x->rtt, x->sent_us, x->retransmitted);
+        send_window(x, 0);
+        return;
+    }
+    if (opcode != ACK)
+        return;
+    unsigned int wire = packet_block(rx_buf);
+    long long block = block_from_wire(wire, x->acked, 0);
+    if (block <= x->acked || block > x->sent)
+        return;
+    rtt_progress(&x->rtt, x->sent_us, x->retransmitted);
+    x->acked = block;
+    if (block == x->last_block) {
+        x->bytes = put_size;
+        finish(x, 1);
+        return;
+    }
+    send_window(x, block + 1 <= x->sent);
+}
+
+// Maître du groupe : acquitte les blocs reçus sans trou, le serveur reprend au
+// premier manquant
+static void mcast_ack(xfer *x, long long now, int retransmitted) {
+    send_ack(x, x->next_block - 1);
+    x->window_count = 0;
+    arm(x, now, retransmitted);
+}
+
+// OACK multicast : abonnement au groupe annoncé. Renvoie -1 en cas d'échec.
+static int join_group(xfer *x, const tftp_options *accepted) {
+    if (!(accepted->present & OPT_TSIZE))
+        return -1;
+    x->last_block = accepted->tsize / x->blksize + 1;
+    x->have = calloc(x->last_block + 1, 1);
+    struct sockaddr_in group = { .sin_family = AF_INET, .sin_addr = accepted->mcast_addr,
+                                 .sin_port = htons(accepted->mcast_port) };
+    struct ip_mreq mreq = { .imr_multiaddr = accepted->mcast_addr, .imr_interface.s_addr = INADDR_ANY };
+    int reuse = 1;  // Tous les clients simulés écoutent le même groupe
+    x->mcast_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (!x->have || x->mcast_fd < 0 ||
+        setsockopt(x->mcast_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+        bind(x->mcast_fd, (struct sockaddr*)&group, sizeof(group)) < 0 ||
+        setsockopt(x->mcast_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+        return -1;
+    // Le flux du groupe ne ralentit pas pour un client à l'écoute : tampon maximal
+    int rcvbuf = RCVBUF_MAX;
+    setsockopt(x->mcast_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (unsigned int)(x - xfers) };
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, x->mcast_fd, &ev);
+}
+
+// GET multicast : les blocs du groupe arrivent dans n'importe quel ordre. Seul
+// le maître acquitte ; un OACK fait d'un client à l'écoute le nouveau maître.
+// Sans l'option multicast dans l'OACK, le transfert se poursuit en unicast.
+static void handle_mcast(xfer *x, const struct sockaddr_in *from, int opcode, int n) {
+    long long now = rtt_now_us();
+    if (opcode == OACK) {
+        tftp_options role;
+        if (parse_oack(rx_buf, n, &role) < 0)
+            return;
+        if (!x->answered) {
+            if (!(role.present & OPT_MULTICAST)) {
+                x->kind = XFER_GET;
+                handle_get(x, from, opcode, n);
+                return;
+            }
+            answer(x, from, rx_buf, n, 1);
+            rtt_progress(&x->rtt, x->sent_us, x->retransmitted);
+            if (join_group(x, &role) < 0) {
+                perror("Abonnement au groupe multicast");
+                finish(x, 0);
+                return;
+            }
+        }
+        if ((role.present & OPT_MULTICAST) && role.mcast_master && !x->master) {
+            x->master = 1;
+            if (x->next_block > 1)
+                printf("Nouveau maître : %lld blocs reçus sans trou\n", x->next_block - 1);
+        }
+        if (x->master)
+            mcast_ack(x, now, 0);
+        else
+            arm(x, now, 0);
+        return;
+    }
+    if (opcode != DATA || !x->have)
+        return;
+    unsigned int wire = packet_block(rx_buf);
+    long long block = block_from_wire(wire, x->next_block, 0);
+    long long expected = x->next_block;
+    int len = n - 4;
+    if (block >= 1 && block <= x->last_block && !x->have[block]) {
+        x->have[block] = 1;
+        x->received++;
+        x->bytes += len;
+        while (x->next_block <= x->last_block && x->have[x->next_block])
+            x->next_block++;
+    }
+    // Un client à l'écoute ne mesure pas le RTT, mais le flux le garde en vie
+    rtt_progress(&x->rtt, x->sent_us, !x->master || x->retransmitted || x->window_count > 0);
+    x->deadline_us = now + x->rtt.rto_us;
+    if (x->received == x->last_block) {
+        // Fichier complet : le dernier ACK fait quitter le groupe, maître ou non
+        send_ack(x, x->last_block);
+        finish(x, 1);
+        return;
+    }
+    if (!x->master)
+        return;
+    if (kill_block > 0 && killed == 0 && x->next_block - 1 > kill_block) {
+        // Panne simulée : plus un paquet, ni ERROR ni ACK ; le serveur doit
+        // s'en apercevoir par lui-même et passer au client suivant
+        printf("Maître arrêté après le bloc %lld\n", x->next_block - 1);
+        killed++;
+        release(x);
+        return;
+    }
+    if (block > expected) {
+        // Trou dans la fenêtre : un seul ACK par passage de la fenêtre retransmise
+        if (x->ooo_block < 0 || block <= x->ooo_block)
+            mcast_ack(x, now, 1);
+        x->ooo_block = block;
+        return;
+    }
+    if (block == expected)
+        x->ooo_block = -1;
+    if (++x->window_count >= x->windowsize)
+        mcast_ack(x, now, 0);
+}
+
+// Vide un socket du transfert : réponses du serveur, ou DATA du groupe
+static void drain(xfer *x, int client, int fd) {
+    while (x->kind != XFER_FREE) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(fd, rx_buf, sizeof(rx_buf), 0, (struct sockaddr*)&from, &from_len);
+        if (n < 0)
+            return;  // EAGAIN, ou ICMP d'un serveur absent : l'échéance s'en chargera
+        if (n < 4)
+            continue;
+        // Les DATA du groupe partent de l'adresse de l'interface multicast du
+        // serveur : seul leur port est comparé
+        if (x->answered && (from.sin_port != x->peer.sin_port ||
+                            (fd == x->fd && from.sin_addr.s_addr != x->peer.sin_addr.s_addr)))
+            continue;
+        int opcode = packet_opcode(rx_buf, n);
+        int code, msg_len;
+        const char *msg;
+        if (parse_error(rx_buf, n, &code, &msg, &msg_len) == 0) {
+            fprintf(stderr, "Client %d : erreur du serveur : %.*s\n", client, msg_len, msg);
+            finish(x, 0);
+            return;
+        }
+        if (x->kind == XFER_GET)
+            handle_get(x, &from, opcode, n);
+        else if (x->kind == XFER_MCAST)
+            handle_mcast(x, &from, opcode, n);
+        else
+            handle_put(x, &from, opcode, n);
+    }
+}
+
+static void handle_readable(int client) {
+    xfer *x = &xfers[client];
+    drain(x, client, x->fd);
+    if (x->kind != XFER_FREE && x->mcast_fd >= 0)
+        drain(x, client, x->mcast_fd);
+}
+
+// Échéance expirée : renvoi de la requête, du dernier ACK (GET) ou de la fenêtre (PUT)
+static void expire(xfer *x, long long now) {
+    rtt_timeout(&x->rtt);
+    if (rtt_gave_up(&x->rtt, now)) {
+        finish(x, 0);
+        return;
+    }
+    retransmits++;
+    if (!x->answered) {
+        send_to_peer(x, x->request, x->req_len);
+        arm(x, now, 1);
+    } else if (x->kind == XFER_MCAST && !x->master) {
+        x->deadline_us = now + x->rtt.rto_us;  // À l'écoute : le flux est mené par le maître
+    } else if (x->kind == XFER_GET || x->kind == XFER_MCAST) {
+        send_ack(x, x->next_block - 1);
+        x->window_count = 0;
+        arm(x, now, 1);
+    } else {
+        send_window(x, 1);
+    }
+}
+
+// Temps CPU (utilisateur + système) du processus pid, en secondes ; -1 si inconnu
+static double process_cpu(int pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    char line[1024];
+    double cpu = -1;
+    if (fgets(line, sizeof(line), fp)) {
+        // Les champs 14 et 15 (utime, stime) suivent le nom entre parenthèses
+        char *p = strrchr(line, ')');
+        unsigned long utime, stime;
+        if (p && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2)
+            cpu = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+    }
+    fclose(fp);
+    return cpu;
+}
+
+static double self_cpu(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static int compare_ll(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_ms(double p) {
+    if (completed == 0)
+        return 0;
+    int k = (int)(p * (completed - 1) + 0.5);
+    return latencies[k] / 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = "127.0.0.1";
+    int port = DEFAULT_PORT, clients = 16, total = -1, server_pid = 0;
+    double rate = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:p:n:t:r:o:f:S:b:w:k:P:")) != -1) {
+        switch (opt) {
+            case 's': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'n': clients = atoi(optarg); break;
+            case 't': total = atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'o':
+                if (strcmp(optarg, "get") == 0) mode = XFER_GET;
+                else if (strcmp(optarg, "put") == 0) mode = XFER_PUT;
+                else if (strcmp(optarg, "mix") == 0) mix = 1;
+                else if (strcmp(optarg, "mcast") == 0) mode = XFER_MCAST;
+                else usage(argv[0]);
+                break;
+            case 'f': remote_name = optarg; break;
+            case 'S': put_size = atoll(optarg); break;
+            case 'b': req_blksize = atoi(optarg); break;
+            case 'w': req_windowsize = atoi(optarg); break;
+            case 'k': kill_block = atoll(optarg); break;
+            case 'P': server_pid = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (total < 0)
+        total = clients;
+    if (port < 1 || port > 65535 || clients < 1 || total < 1 || rate < 0 || put_size < 0 ||
+        (req_blksize != 0 && (req_blksize < MIN_BLKSIZE || req_blksize > MAX_BLKSIZE)) ||
+        req_windowsize < 0 || req_windowsize > MAX_WINDOWSIZE)
+        usage(argv[0]);
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &server.sin_addr) != 1)
+        usage(argv[0]);
+
+    // Un socket par client simultané
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    xfers = calloc(clients, sizeof(*xfers));
+    latencies = malloc(total * sizeof(*latencies));
+    epfd = epoll_create1(0);
+    if (!xfers || !latencies || epfd < 0) {
+        perror("Initialisation");
+        return EXIT_FAILURE;
+    }
+
+    double server_cpu0 = server_pid ? process_cpu(server_pid) : -1;
+    double self_cpu0 = self_cpu();
+    long long t0 = rtt_now_us();
+    long long next_start = t0;       // Avec -r : départ du prochain transfert
+    long long next_tick = t0 + TICK_US;
+    int started = 0;
+    struct epoll_event events[MAX_EVENTS];
+    while (completed + failed + killed < total) {
+        long long now = rtt_now_us();
+        // Charge fermée (sans -r) : chaque client enchaîne ses transferts ;
+        // charge ouverte : départs au rythme demandé, dans la limite des clients
+        for (int c = 0; c < clients && started < total && (rate == 0 || now >= next_start); c++) {
+            if (xfers[c].kind != XFER_FREE)
+                continue;
+            xfer_kind kind = mix ? (started % 2 ? XFER_PUT : XFER_GET) : mode;
+            if (start_xfer(c, started, kind) < 0) {
+                perror("Démarrage d'un transfert");
+                failed++;
+            }
+            started++;
+            if (rate > 0)
+                next_start += (long long)(1000000 / rate);
+        }
+        int wait_ms = (int)((next_tick - now) / 1000);
+        if (rate > 0 && started < total && next_start - now < (next_tick - now))
+            wait_ms = (int)((next_start - now) / 1000);
+        int n = epoll_wait(epfd, events, MAX_EVENTS, wait_ms > 0 ? wait_ms : 0);
+        for (int e = 0; e < n; e++)
+            handle_readable(events[e].data.u32);
+        now = rtt_now_us();
+        if (now >= next_tick) {
+            next_tick = now + TICK_US;
+            for (int c = 0; c < clients; c++) {
+                if (xfers[c].kind != XFER_FREE && xfers[c].deadline_us <= now)
+                    expire(&xfers[c], now);
+            }
+        }
+    }
+    double elapsed = (rtt_now_us() - t0) / 1e6;
+    double self_used = self_cpu() - self_cpu0;
+    double server_used = server_cpu0 >= 0 ? process_cpu(server_pid) - server_cpu0 : -1;
+
+    qsort(latencies, completed, sizeof(*latencies), compare_ll);
+    printf("Transferts : %d réussis, %d échoués en %.2f s (%.1f transferts/s)\n",
+           completed, failed, elapsed, completed / elapsed);
+    printf("Débit : %.1f Mo, %.1f Mo/s\n", total_bytes / 1e6, total_bytes / 1e6 / elapsed);
+    printf("Latence (ms) : p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+           percentile_ms(0.50), percentile_ms(0.90), percentile_ms(0.99), percentile_ms(1.0));
+    printf("Retransmissions : %lu\n", retransmits);
+    if (killed)
+        printf("Maîtres arrêtés : %d\n", killed);
+    if (server_used >= 0 && total_bytes > 0)
+        printf("CPU serveur : %.2f s (%.2f ns/octet), générateur : %.2f s\n",
+               server_used, server_used * 1e9 / total_bytes, self_used);
+    else
+        printf("CPU générateur : %.2f s\n", self_used);
+    close(epfd);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "LockTable.h"
+#include "Rtt.h"
+
+#define LOCK_BUCKETS 256
+
+struct lock_entry {
+    char *name;
+    int readers;                // Lecteurs qui tiennent le verrou
+    int writer;                 // Un écrivain tient le verrou
+    int waiting_writers;        // Écrivains en attente, prioritaires sur les nouveaux lecteurs
+    int waiters;                // Demandes en attente (l'entrée ne peut pas être libérée)
+    pthread_cond_t changed;     // Signalé à chaque libération
+    lock_entry *hash_next;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    lock_entry *buckets[LOCK_BUCKETS];
+    lock_table_stats stats;
+} table = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static unsigned int name_hash(const char *name) {
+    unsigned int h = 2166136261u;  // FNV-1a
+    for (; *name; name++)
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    return h % LOCK_BUCKETS;
+}
+
+// Entrée de name, créée au besoin
+static lock_entry *entry_get(const char *name) {
+    unsigned int h = name_hash(name);
+    for (lock_entry *e = table.buckets[h]; e; e = e->hash_next) {
+        if (strcmp(e->name, name) == 0)
+            return e;
+    }
+    lock_entry *e = calloc(1, sizeof(*e));
+    if (!e)
+        return NULL;
+    e->name = strdup(name);
+    if (!e->name) {
+        free(e);
+        return NULL;
+    }
+    // Les attentes sont bornées sur l'horloge monotone, comme les délais de retransmission
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&e->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    e->hash_next = table.buckets[h];
+    table.buckets[h] = e;
+    return e;
+}
+
+// Libère l'entrée dès que plus personne ne la tient ni ne l'attend
+static void entry_put(lock_entry *e) {
+    if (e->readers || e->writer || e->waiters)
+        return;
+    lock_entry **link = &table.buckets[name_hash(e->name)];
+    while (*link != e)
+        link = &(*link)->hash_next;
+    *link = e->hash_next;
+    pthread_cond_destroy(&e->changed);
+    free(e->name);
+    free(e);
+}
+
+static int available(const lock_entry *e, lock_mode mode) {
+    if (mode == LOCK_EXCLUSIVE)
+        return !e->writer && e->readers == 0;
+    return !e->writer && e->waiting_writers == 0;
+}
+
+lock_entry *lock_table_acquire(const char *name, lock_mode mode, int timeout_ms) {
+    pthread_mutex_lock(&table.lock);
+    lock_entry *e = entry_get(name);
+    if (!e) {
+        pthread_mutex_unlock(&table.lock);
+        return NULL;
+    }
+    long long wait_us = 0;
+    if (!available(e, mode)) {
+        table.stats.contended++;
+        long long start = rtt_now_us();
+        long long deadline = start + timeout_ms * 1000LL;
+        struct timespec ts = { deadline / 1000000, (deadline % 1000000) * 1000 };
+        e->waiters++;
+        if (mode == LOCK_EXCLUSIVE)
+            e->waiting_writers++;
+        int ret = 0;
+        while (!available(e, mode) && ret != ETIMEDOUT && timeout_ms > 0)
+            ret = pthread_cond_timedwait(&e->changed, &table.lock, &ts);
+        e->waiters--;
+        if (mode == LOCK_EXCLUSIVE) {
+            e->waiting_writers--;
+            // Des lecteurs bloqués derrière cet écrivain peuvent repartir
+            pthread_cond_broadcast(&e->changed);
+        }
+        if (!available(e, mode)) {
+            table.stats.refused++;
+            entry_put(e);
+            pthread_mutex_unlock(&table.lock);
+            return NULL;
+        }
+        wait_us = rtt_now_us() - start;
+    }
+    if (mode == LOCK_EXCLUSIVE)
+        e->writer = 1;
+    else
+        e->readers++;
+    table.stats.acquired++;
+    table.stats.held++;
+    table.stats.total_wait_us += wait_us;
+    if (wait_us > table.stats.max_wait_us)
+        table.stats.max_wait_us = wait_us;
+    pthread_mutex_unlock(&table.lock);
+    return e;
+}
+
+void lock_table_release(lock_entry *e) {
+    pthread_mutex_lock(&table.lock);
+    // Un écrivain tient le verrou seul : s'il est pris, c'est le sien
+    if (e->writer)
+        e->writer = 0;
+    else
+        e->readers--;
+    table.stats.held--;
+    pthread_cond_broadcast(&e->changed);
+    entry_put(e);
+    pthread_mutex_unlock(&table.lock);
+}
+
+void lock_table_get_stats(lock_table_stats *stats) {
+    pthread_mutex_lock(&table.lock);
+    *stats = table.stats;
+    pthread_mutex_unlock(&table.lock);
+}
@@ -0,0 +1,32 @@
+#ifndef LOCK_TABLE_H
+#define LOCK_TABLE_H
+
+// Verrous de transfert par fichier, tenus en mémoire pour tout le processus :
+// partagés pour les lectures (RRQ), exclusifs pour les écritures (WRQ). Un
+// écrivain en attente passe avant les nouveaux lecteurs.
+
+typedef enum {
+    LOCK_SHARED,     // Plusieurs lecteurs simultanés
+    LOCK_EXCLUSIVE   // Un seul écrivain, sans lecteur
+} lock_mode;
+
+typedef struct lock_entry lock_entry;
+
+typedef struct {
+    unsigned long acquired;      // Verrous obtenus
+    unsigned long contended;     // Demandes qui ont trouvé le fichier verrouillé
+    unsigned long refused;       // Demandes abandonnées (délai écoulé ou sans attente)
+    long long total_wait_us;     // Attente cumulée des verrous obtenus après contention
+    long long max_wait_us;
+    int held;                    // Verrous actuellement tenus
+} lock_table_stats;
+
+// Verrouille name dans le mode demandé, en attendant au plus timeout_ms
+// (0 : sans attendre). Renvoie NULL si le verrou n'a pas pu être pris.
+lock_entry *lock_table_acquire(const char *name, lock_mode mode, int timeout_ms);
+
+void lock_table_release(lock_entry *entry);
+
+void lock_table_get_stats(lock_table_stats *stats);
+
+#endif
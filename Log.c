@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "Log.h"
+
+log_level_t log_level = LOG_INFO;
+
+// Anneau d'un thread : un seul producteur (le thread), un seul consommateur
+// (le thread d'écriture). head et tail croissent sans fin, modulo LOG_RING_SLOTS.
+typedef struct log_ring {
+    _Atomic unsigned int head;           // Prochain message écrit par le thread
+    _Atomic unsigned int tail;           // Prochain message vidé sur stdout
+    _Atomic unsigned long dropped;       // Messages perdus, anneau plein
+    unsigned long reported;              // Pertes déjà signalées (thread d'écriture)
+    struct log_ring *next;
+    char lines[LOG_RING_SLOTS][LOG_LINE_MAX];
+} log_ring;
+
+static _Atomic(log_ring *) rings;        // Anneaux de tous les threads (ajout en tête)
+static atomic_int started;
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread log_ring *my_ring;
+
+static const char *level_names[] = { "error", "warn", "info", "debug", "packet" };
+
+int log_level_parse(const char *name) {
+    for (int k = 0; k <= LOG_PACKET; k++) {
+        if (strcasecmp(name, level_names[k]) == 0)
+            return k;
+    }
+    return -1;
+}
+
+// Anneau du thread appelant, créé à son premier message
+static log_ring *thread_ring(void) {
+    if (my_ring)
+        return my_ring;
+    log_ring *r = calloc(1, sizeof(*r));
+    if (!r)
+        return NULL;
+    r->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &r->next, r))
+        ;
+    my_ring = r;
+    return r;
+}
+
+// Vide les anneaux ; renvoie le nombre de messages écrits
+static int drain(void) {
+    int written = 0;
+    pthread_mutex_lock(&flush_lock);
+    for (log_ring *r = atomic_load_explicit(&rings, memory_order_acquire); r; r = r->next) {
+        unsigned int head = atomic_load_explicit(&r->head, memory_order_acquire);
+        unsigned int tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        for (; tail != head; tail++, written++)
+            fputs(r->lines[tail % LOG_RING_SLOTS], stdout);
+        atomic_store_explicit(&r->tail, tail, memory_order_release);
+        unsigned long dropped = atomic_load_explicit(&r->dropped, memory_order_relaxed);
+        if (dropped != r->reported) {
+            printf("[WARN] Journal saturé : %lu messages perdus\n", dropped - r->reported);
+            r->reported = dropped;
+            written++;
+        }
+    }
+    if (written)
+        fflush(stdout);
+    pthread_mutex_unlock(&flush_lock);
+    return written;
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    struct timespec idle = { 0, LOG_IDLE_MS * 1000000L };
+    while (1) {
+        if (drain() == 0)
+            nanosleep(&idle, NULL);
+    }
+    return NULL;
+}
+
+int log_init(log_level_t level) {
+    log_level = level;
+    pthread_t id;
+    if (pthread_create(&id, NULL, writer_main, NULL) != 0)
+        return -1;
+    pthread_detach(id);
+    atomic_store(&started, 1);
+    return 0;
+}
+
+void log_flush(void) {
+    drain();
+}
+
+void log_write(log_level_t level, const char *fmt, ...) {
+    (void)level;
+    va_list ap;
+    va_start(ap, fmt);
+    log_ring *r = atomic_load_explicit(&started, memory_order_relaxed) ? thread_ring() : NULL;
+    if (!r) {
+        // Pas encore de thread d'écriture (ou plus de mémoire) : écriture directe
+        vprintf(fmt, ap);
+        va_end(ap);
+        return;
+    }
+    unsigned int head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&r->tail, memory_order_acquire) >= LOG_RING_SLOTS) {
+        atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+        va_end(ap);
+        return;
+    }
+    char *line = r->lines[head % LOG_RING_SLOTS];
+    int n = vsnprintf(line, LOG_LINE_MAX, fmt, ap);
+    va_end(ap);
+    // Message tronqué : la fin de ligne est conservée
+    if (n >= LOG_LINE_MAX && LOG_LINE_MAX >= 2) {
+        line[LOG_LINE_MAX - 2] = '\n';
+        line[LOG_LINE_MAX - 1] = '\0';
+    }
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+}
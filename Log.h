@@ -0,0 +1,49 @@
+#ifndef LOG_H
+#define LOG_H
+
+// Journal asynchrone des serveurs. Chaque thread écrit ses messages dans son
+// propre anneau, sans verrou ; un thread d'écriture les vide sur stdout. Un
+// anneau plein fait perdre le message (compté) plutôt que bloquer le transfert.
+// Les messages par paquet (log_packet) ne sont compilés qu'avec -DLOG_PACKETS.
+
+typedef enum {
+    LOG_ERROR,
+    LOG_WARN,
+    LOG_INFO,      // Sessions, requêtes, statistiques (niveau par défaut)
+    LOG_DEBUG,     // Retransmissions et détails de négociation
+    LOG_PACKET     // Chaque DATA et ACK (seulement avec -DLOG_PACKETS)
+} log_level_t;
+
+#define LOG_RING_SLOTS 512      // Messages en attente par thread
+#define LOG_LINE_MAX 256        // Longueur maximale d'un message (tronqué au-delà)
+#define LOG_IDLE_MS 5           // Sommeil du thread d'écriture quand tout est vidé
+
+extern log_level_t log_level;   // Messages de niveau supérieur ignorés
+
+// Lance le thread d'écriture. Avant l'appel, les messages sont écrits directement.
+int log_init(log_level_t level);
+
+// Niveau désigné par son nom (error, warn, info, debug, packet), -1 si inconnu
+int log_level_parse(const char *name);
+
+// Écrit tous les messages en attente (fin du programme)
+void log_flush(void);
+
+void log_write(log_level_t level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Le niveau est testé avant le formatage : un message filtré ne coûte qu'une comparaison
+#define LOG_AT(level, ...) do { if ((level) <= log_level) log_write((level), __VA_ARGS__); } while (0)
+
+#define log_error(...) LOG_AT(LOG_ERROR, __VA_ARGS__)
+#define log_warn(...)  LOG_AT(LOG_WARN, __VA_ARGS__)
+#define log_info(...)  LOG_AT(LOG_INFO, __VA_ARGS__)
+#define log_debug(...) LOG_AT(LOG_DEBUG, __VA_ARGS__)
+
+#ifdef LOG_PACKETS
+#define log_packet(...) LOG_AT(LOG_PACKET, __VA_ARGS__)
+#else
+// Arguments toujours vérifiés par le compilateur, mais aucun code généré
+#define log_packet(...) do { if (0) log_write(LOG_PACKET, __VA_ARGS__); } while (0)
+#endif
+
+#endif
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "Metrics.h"
+
+#define SNAPSHOT_SIZE 16384
+
+typedef struct {
+    _Atomic unsigned long buckets[METRICS_BUCKETS];
+    _Atomic long long sum_us;
+} histogram;
+
+typedef struct {
+    _Atomic long long counters[MET_COUNTERS];
+    _Atomic unsigned long errors_sent[METRICS_ERROR_CODES];
+    histogram histograms[HIST_COUNT];
+} metrics_store;
+
+static metrics_store local_store;
+static metrics_store *stores = &local_store;  // Emplacements de tous les processus
+static int nstores = 1;
+static metrics_store *mine = &local_store;    // Emplacement du processus courant
+
+static const struct {
+    const char *name;
+    const char *help;
+    int gauge;
+} counter_info[MET_COUNTERS] = {
+    [MET_SESSIONS_ACTIVE] = { "tftp_sessions_active", "Transferts en cours", 1 },
+    [MET_RRQ] = { "tftp_rrq_total", "Lectures (RRQ) commencées", 0 },
+    [MET_WRQ] = { "tftp_wrq_total", "Écritures (WRQ) commencées", 0 },
+    [MET_BYTES_SENT] = { "tftp_bytes_sent_total", "Octets de données envoyés", 0 },
+    [MET_BYTES_RECEIVED] = { "tftp_bytes_received_total", "Octets de données reçus", 0 },
+    [MET_BLOCKS_SENT] = { "tftp_blocks_sent_total", "Blocs DATA envoyés", 0 },
+    [MET_BLOCKS_RECEIVED] = { "tftp_blocks_received_total", "Blocs DATA reçus dans l'ordre", 0 },
+    [MET_RETRANSMITS] = { "tftp_retransmits_total", "Retransmissions après expiration du délai", 0 },
+    [MET_TIMEOUTS] = { "tftp_timeouts_total", "Transferts abandonnés faute de réponse", 0 },
+    [MET_ERRORS_RECEIVED] = { "tftp_errors_received_total", "Paquets ERROR reçus", 0 },
+    [MET_WORKERS] = { "tftp_workers", "Processus workers en service", 1 },
+    [MET_WORKER_RESTARTS] = { "tftp_worker_restarts_total", "Workers relancés après un arrêt anormal", 0 },
+    [MET_REQUESTS_WAITING] = { "tftp_requests_waiting", "Requêtes en attente d'admission", 1 },
+    [MET_REQUESTS_QUEUED] = { "tftp_requests_queued_total", "Requêtes mises en attente faute de ressources", 0 },
+    [MET_REQUESTS_REJECTED] = { "tftp_requests_rejected_total", "Requêtes refusées en surcharge", 0 },
+};
+
+static const struct {
+    const char *name;
+    const char *help;
+} histogram_info[HIST_COUNT] = {
+    [HIST_RTT] = { "tftp_rtt_us", "RTT mesuré entre un envoi et sa réponse" },
+    [HIST_FIRST_DATA] = { "tftp_first_data_us", "Délai entre la requête et le premier bloc" },
+    [HIST_TRANSFER] = { "tftp_transfer_us", "Durée des transferts terminés" },
+};
+
+void metrics_add(metric_counter counter, long long value) {
+    atomic_fetch_add_explicit(&mine->counters[counter], value, memory_order_relaxed);
+}
+
+void metrics_error_sent(int code) {
+    if (code >= 0 && code < METRICS_ERROR_CODES)
+        atomic_fetch_add_explicit(&mine->errors_sent[code], 1, memory_order_relaxed);
+}
+
+void metrics_observe(metric_histogram hist, long long us) {
+    if (us < 0)
+        return;
+    // Seau k : ]2^(k-1), 2^k] µs ; le dernier reçoit tout ce qui dépasse
+    int k = us <= 1 ? 0 : 64 - __builtin_clzll((unsigned long long)us - 1);
+    if (k >= METRICS_BUCKETS)
+        k = METRICS_BUCKETS - 1;
+    histogram *h = &mine->histograms[hist];
+    atomic_fetch_add_explicit(&h->buckets[k], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_us, us, memory_order_relaxed);
+}
+
+// Ajoute au tampon sans jamais dépasser sa taille
+static void append(char *buf, size_t size, size_t *len, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void append(char *buf, size_t size, size_t *len, const char *fmt, ...) {
+    if (*len >= size)
+        return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *len, size - *len, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        *len = *len + n < size ? *len + n : size;
+}
+
+// Sommes sur les emplacements de tous les processus
+static long long counter_total(int c) {
+    long long total = 0;
+    for (int p = 0; p < nstores; p++)
+        total += atomic_load_explicit(&stores[p].counters[c], memory_order_relaxed);
+    return total;
+}
+
+static unsigned long errors_total(int code) {
+    unsigned long total = 0;
+    for (int p = 0; p < nstores; p++)
+        total += atomic_load_explicit(&stores[p].errors_sent[code], memory_order_relaxed);
+    return total;
+}
+
+static unsigned long bucket_total(int h, int k) {
+    unsigned long total = 0;
+    for (int p = 0; p < nstores; p++)
+        total += atomic_load_explicit(&stores[p].histograms[h].buckets[k], memory_order_relaxed);
+    return total;
+}
+
+static long long sum_total(int h) {
+    long long total = 0;
+    for (int p = 0; p < nstores; p++)
+        total += atomic_load_explicit(&stores[p].histograms[h].sum_us, memory_order_relaxed);
+    return total;
+}
+
+static size_t snapshot(char *buf, size_t size) {
+    size_t len = 0;
+    for (int c = 0; c < MET_COUNTERS; c++) {
+        append(buf, size, &len, "# HELP %s %s\n# TYPE %s %s\n%s %lld\n",
+               counter_info[c].name, counter_info[c].help, counter_info[c].name,
+               counter_info[c].gauge ? "gauge" : "counter", counter_info[c].name,
+               counter_total(c));
+    }
+    append(buf, size, &len, "# HELP tftp_errors_sent_total Paquets ERROR envoyés, par code\n"
+                            "# TYPE tftp_errors_sent_total counter\n");
+    for (int code = 0; code < METRICS_ERROR_CODES; code++) {
+        append(buf, size, &len, "tftp_errors_sent_total{code=\"%d\"} %lu\n", code, errors_total(code));
+    }
+    for (int h = 0; h < HIST_COUNT; h++) {
+        const char *name = histogram_info[h].name;
+        append(buf, size, &len, "# HELP %s %s\n# TYPE %s histogram\n", name, histogram_info[h].help, name);
+        // Seaux cumulés, comme l'attend le format
+        unsigned long total = 0;
+        for (int k = 0; k < METRICS_BUCKETS; k++) {
+            total += bucket_total(h, k);
+            if (k < METRICS_BUCKETS - 1)
+                append(buf, size, &len, "%s_bucket{le=\"%llu\"} %lu\n", name, 1ULL << k, total);
+            else
+                append(buf, size, &len, "%s_bucket{le=\"+Inf\"} %lu\n", name, total);
+        }
+        append(buf, size, &len, "%s_sum %lld\n%s_count %lu\n", name, sum_total(h), name, total);
+    }
+    return len;
+}
+
+static void *serve_metrics(void *arg) {
+    int listen_fd = (int)(long)arg;
+    char *buf = malloc(SNAPSHOT_SIZE);
+    if (!buf)
+        return NULL;
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+        size_t len = snapshot(buf, SNAPSHOT_SIZE);
+        for (size_t off = 0; off < len; ) {
+            ssize_t n = send(fd, buf + off, len - off, MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+            off += n;
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+int metrics_init(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    // Un socket laissé par une exécution précédente est remplacé
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        close(fd);
+        return -1;
+    }
+    pthread_t id;
+    if (pthread_create(&id, NULL, serve_metrics, (void*)(long)fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    pthread_detach(id);
+    return 0;
+}
+
+int metrics_share(int processes) {
+    metrics_store *shared = mmap(NULL, processes * sizeof(*shared), PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+        return -1;
+    // Les mesures déjà faites sont conservées dans le premier emplacement
+    memcpy(&shared[0], &local_store, sizeof(local_store));
+    stores = shared;
+    nstores = processes;
+    mine = &stores[0];
+    return 0;
+}
+
+void metrics_select(int process) {
+    if (process >= 0 && process < nstores)
+        mine = &stores[process];
+}
+
+void metrics_reset_gauges(int process) {
+    if (process < 0 || process >= nstores)
+        return;
+    for (int c = 0; c < MET_COUNTERS; c++) {
+        if (counter_info[c].gauge)
+            atomic_store_explicit(&stores[process].counters[c], 0, memory_order_relaxed);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// Compteurs et histogrammes de latence des serveurs, exposés sur un socket
+// Unix local : chaque connexion reçoit un instantané au format texte de
+// Prometheus, puis le socket est fermé (par exemple : socat - UNIX:<chemin>).
+// Les mises à jour sont des additions atomiques relâchées, sans verrou.
+// En mode multi-processus, chaque processus compte dans son propre
+// emplacement d'une zone partagée ; l'instantané en donne la somme.
+
+#define METRICS_DEFAULT_PATH "/tmp/tftp-metrics.sock"
+#define METRICS_ERROR_CODES 9       // Codes d'erreur TFTP 0 à 8
+#define METRICS_BUCKETS 32          // Seaux de latence : puissances de 2 en µs, puis +Inf
+
+typedef enum {
+    MET_SESSIONS_ACTIVE,            // Transferts en cours (jauge)
+    MET_RRQ,                        // Lectures commencées
+    MET_WRQ,                        // Écritures commencées
+    MET_BYTES_SENT,                 // Octets de données envoyés (retransmissions comprises)
+    MET_BYTES_RECEIVED,             // Octets de données reçus dans l'ordre
+    MET_BLOCKS_SENT,
+    MET_BLOCKS_RECEIVED,
+    MET_RETRANSMITS,                // Échéances expirées : fenêtre, ACK ou OACK renvoyé
+    MET_TIMEOUTS,                   // Transferts abandonnés faute de réponse
+    MET_ERRORS_RECEIVED,            // Paquets ERROR reçus des clients
+    MET_WORKERS,                    // Processus workers en service (jauge, superviseur)
+    MET_WORKER_RESTARTS,            // Workers relancés après un arrêt anormal
+    MET_REQUESTS_WAITING,           // Requêtes en attente d'admission (jauge)
+    MET_REQUESTS_QUEUED,            // Requêtes mises en attente faute de ressources
+    MET_REQUESTS_REJECTED,          // Requêtes refusées en surcharge (« réessayez plus tard »)
+    MET_COUNTERS
+} metric_counter;
+
+typedef enum {
+    HIST_RTT,                       // Délai entre un envoi et la réponse qui l'acquitte
+    HIST_FIRST_DATA,                // Requête reçue -> premier bloc DATA envoyé ou reçu
+    HIST_TRANSFER,                  // Requête reçue -> transfert terminé
+    HIST_COUNT
+} metric_histogram;
+
+// Ouvre le socket de statistiques et lance le thread qui y répond
+int metrics_init(const char *path);
+
+// Place les compteurs dans une zone partagée de processes emplacements, avant
+// de créer les processus qui la partagent. Renvoie -1 en cas d'échec.
+int metrics_share(int processes);
+
+// Emplacement où compte le processus courant (0 après metrics_share)
+void metrics_select(int process);
+
+// Remet à zéro les jauges de l'emplacement d'un processus arrêté, dont les
+// transferts en cours ont disparu avec lui ; ses compteurs restent acquis
+void metrics_reset_gauges(int process);
+
+void metrics_add(metric_counter counter, long long value);
+
+#define metrics_inc(counter) metrics_add((counter), 1)
+
+// Paquet ERROR envoyé avec ce code
+void metrics_error_sent(int code);
+
+// Ajoute une mesure de us microsecondes à l'histogramme (ignorée si négative)
+void metrics_observe(metric_histogram hist, long long us);
+
+#endif
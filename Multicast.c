@@ -0,0 +1,453 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "Multicast.h"
+#include "TftpPacket.h"
+#include "Rtt.h"
+#include "BatchIo.h"
+#include "FileMap.h"
+#include "FileCache.h"
+#include "LockTable.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "WritePipe.h"
+
+#define WAKE_EVENT MCAST_MAX_GROUPS  // Donnée epoll de l'eventfd de réveil
+
+typedef struct {
+    struct sockaddr_in addr;
+    int tsize;                  // Le client a demandé tsize : l'OACK la lui renvoie
+} member;
+
+typedef struct {
+    int used;
+    int sockfd;                 // Envoi des DATA au groupe, OACK et ACK avec chaque client
+    struct sockaddr_in group;   // Destination des DATA
+    char filename[256];
+    lock_entry *lock;           // Verrou partagé, comme un RRQ
+    cache_entry *cached;        // Entrée du cache dont map est une vue (NULL sinon)
+    file_map map;
+    int mapped;
+    int fd;                     // Sans projection : lecture par pread
+    long long file_size;
+    long long last_block;       // Le seul bloc de moins de blksize octets
+    tftp_options opts;          // Options du groupe, imposées aux clients suivants
+    member *members;            // members[0] est le maître
+    int count, capacity;
+    long long acked;            // Dernier bloc acquitté par le maître (-1 : OACK en attente)
+    long long sent;             // Dernier bloc de la fenêtre envoyée
+    long long highest_sent;
+    rtt_estimator rtt;
+    long long sent_us;
+    long long deadline_us;      // Échéance de retransmission (0 si aucune)
+    int retransmitted;
+    long long start_us;
+} mcast_group;
+
+static struct {
+    pthread_mutex_t lock;
+    int enabled;
+    char dir[PATH_MAX];
+    struct in_addr first_group;
+    int port;
+    int epfd;                   // Sockets des groupes et eventfd de réveil
+    int wake_fd;                // Signale un groupe créé ou une échéance avancée
+    packet_batch tx;            // Fenêtre en cours d'envoi
+    char rx[MAX_PACKET_SIZE];
+    mcast_group groups[MCAST_MAX_GROUPS];
+} mc = { .lock = PTHREAD_MUTEX_INITIALIZER, .epfd = -1, .wake_fd = -1 };
+
+int mcast_init(const char *dir, const char *first_group, int port) {
+    snprintf(mc.dir, sizeof(mc.dir), "%s", dir);
+    if (inet_pton(AF_INET, first_group, &mc.first_group) != 1 ||
+        !IN_MULTICAST(ntohl(mc.first_group.s_addr)) || port <= 0 || port > 65535) {
+        errno = EINVAL;
+        return -1;
+    }
+    mc.port = port;
+    mc.epfd = epoll_create1(EPOLL_CLOEXEC);
+    mc.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mc.epfd < 0 || mc.wake_fd < 0 || batch_alloc(&mc.tx, BATCH_MAX, MAX_PACKET_SIZE) < 0)
+        return -1;
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = WAKE_EVENT };
+    if (epoll_ctl(mc.epfd, EPOLL_CTL_ADD, mc.wake_fd, &ev) < 0)
+        return -1;
+    mc.enabled = 1;
+    return 0;
+}
+
+int mcast_fd(void) {
+    return mc.enabled ? mc.epfd : -1;
+}
+
+// Réveille la boucle qui surveille mcast_fd pour qu'elle recalcule son échéance
+static void wake(void) {
+    unsigned long long one = 1;
+    if (write(mc.wake_fd, &one, sizeof(one)) < 0)
+        log_debug("[WARN] Réveil du multicast : %s\n", strerror(errno));
+}
+
+// OACK propre à un client : options du groupe, son rôle, et tsize s'il l'a demandée
+static void send_oack(mcast_group *g, const member *m, int master) {
+    tftp_options opts = g->opts;
+    if (!m->tsize)
+        opts.present &= ~OPT_TSIZE;
+    opts.present |= OPT_MULTICAST;
+    opts.mcast_addr = g->group.sin_addr;
+    opts.mcast_port = ntohs(g->group.sin_port);
+    opts.mcast_master = master;
+    char oack[MAX_PACKET_SIZE];
+    int len = build_oack(oack, sizeof(oack), &opts);
+    sendto(g->sockfd, oack, len, 0, (const struct sockaddr*)&m->addr, sizeof(m->addr));
+    log_debug("[INFO] Multicast %s : OACK envoyé à %s:%d (%s)\n", g->filename,
+              inet_ntoa(m->addr.sin_addr), ntohs(m->addr.sin_port), master ? "maître" : "à l'écoute");
+}
+
+static void send_error(mcast_group *g, const struct sockaddr_in *to, int code, const char *msg) {
+    char packet[128];
+    int len = encode_error(packet, sizeof(packet), code, msg);
+    sendto(g->sockfd, packet, len, 0, (const struct sockaddr*)to, sizeof(*to));
+    metrics_error_sent(code);
+}
+
+static void arm_timer(mcast_group *g, int retransmitted) {
+    g->sent_us = rtt_now_us();
+    g->retransmitted = retransmitted;
+    g->deadline_us = g->sent_us + g->rtt.rto_us;
+}
+
+static void close_group(mcast_group *g) {
+    log_info("[INFO] Multicast %s : groupe %s fermé.\n", g->filename, inet_ntoa(g->group.sin_addr));
+    close(g->sockfd);  // Le retire aussi de l'instance epoll
+    if (g->cached)
+        file_cache_release(g->cached);
+    else if (g->mapped)
+        file_map_close(&g->map);
+    if (g->fd >= 0)
+        close(g->fd);
+    lock_table_release(g->lock);
+    free(g->members);
+    g->members = NULL;
+    g->used = 0;
+}
+
+// Le premier client restant devient maître ; sans client, le groupe est fermé
+static void promote(mcast_group *g) {
+    if (g->count == 0) {
+        close_group(g);
+        return;
+    }
+    g->acked = -1;
+    g->rtt.last_progress_us = rtt_now_us();  // Le nouveau maître a son propre délai pour répondre
+    send_oack(g, &g->members[0], 1);
+    arm_timer(g, 0);
+}
+
+static void remove_member(mcast_group *g, int k) {
+    g->count--;
+    memmove(&g->members[k], &g->members[k + 1], (g->count - k) * sizeof(*g->members));
+    if (k == 0)
+        promote(g);
+}
+
+static int find_member(const mcast_group *g, const struct sockaddr_in *addr) {
+    for (int k = 0; k < g->count; k++) {
+        if (g->members[k].addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+            g->members[k].addr.sin_port == addr->sin_port)
+            return k;
+    }
+    return -1;
+}
+
+static int add_member(mcast_group *g, const struct sockaddr_in *addr, const tftp_options *opts) {
+    if (g->count == g->capacity) {
+        int capacity = g->capacity ? 2 * g->capacity : 16;
+        member *grown = realloc(g->members, capacity * sizeof(*grown));
+        if (!grown)
+            return -1;
+        g->members = grown;
+        g->capacity = capacity;
+    }
+    g->members[g->count].addr = *addr;
+    g->members[g->count].tsize = (opts->present & OPT_TSIZE) != 0;
+    return g->count++;
+}
+
+// Envoie au groupe la fenêtre qui suit le dernier bloc acquitté par le maître
+static void send_window(mcast_group *g) {
+    int blksize = g->opts.blksize;
+    g->sent = g->acked + g->opts.windowsize;
+    if (g->sent > g->last_block)
+        g->sent = g->last_block;
+    for (long long block_num = g->acked + 1; block_num <= g->sent; block_num++) {
+        unsigned int wire = block_to_wire(block_num, g->opts.rollover);
+        char *buffer = batch_next(&mc.tx);
+        if (!buffer) {
+            batch_send(&mc.tx, g->sockfd);
+            buffer = batch_next(&mc.tx);
+        }
+        encode_data_header(buffer, wire);
+        size_t len;
+        if (g->mapped) {
+            const char *data = file_map_block(&g->map, block_num, blksize, &len);
+            batch_commit_payload(&mc.tx, 4, data, len, &g->group);
+        } else {
+            ssize_t n = pread(g->fd, buffer + 4, blksize, (block_num - 1) * blksize);
+            len = n > 0 ? n : 0;
+            batch_commit(&mc.tx, len + 4, &g->group);
+        }
+        metrics_add(MET_BYTES_SENT, len);
+    }
+    batch_send(&mc.tx, g->sockfd);
+    metrics_add(MET_BLOCKS_SENT, g->sent - g->acked);
+    // Règle de Karn : pas de mesure de RTT sur une fenêtre qui renvoie un bloc
+    int retransmitted = g->acked + 1 <= g->highest_sent;
+    if (g->sent > g->highest_sent)
+        g->highest_sent = g->sent;
+    arm_timer(g, retransmitted);
+}
+
+// Options du groupe créé pour le premier client : elles valent pour tous les suivants
+static void group_options(mcast_group *g, const tftp_options *opts) {
+    g->opts = *opts;
+    g->opts.present &= OPT_BLKSIZE | OPT_WINDOWSIZE | OPT_ROLLOVER | OPT_TSIZE;
+    // Les DATA empruntent la route du groupe : la taille de bloc suit son MTU
+    g->opts.blksize = (opts->present & OPT_BLKSIZE) ? negotiate_blksize(opts->blksize, &g->group)
+                                                    : DEFAULT_BLKSIZE;
+    if (!(opts->present & OPT_WINDOWSIZE))
+        g->opts.windowsize = DEFAULT_WINDOWSIZE;
+    if (!(opts->present & OPT_ROLLOVER))
+        g->opts.rollover = 0;
+    g->opts.tsize = g->file_size;
+}
+
+// Un client rejoint un groupe en cours seulement s'il accepte ses options :
+// le serveur ne peut que réduire blksize et windowsize, et renvoie rollover tel quel
+static int compatible(const mcast_group *g, const tftp_options *opts) {
+    if ((g->opts.present & OPT_BLKSIZE) &&
+        (!(opts->present & OPT_BLKSIZE) || opts->blksize < g->opts.blksize))
+        return 0;
+    if ((g->opts.present & OPT_WINDOWSIZE) &&
+        (!(opts->present & OPT_WINDOWSIZE) || opts->windowsize < g->opts.windowsize))
+        return 0;
+    if ((g->opts.present & OPT_ROLLOVER) &&
+        (!(opts->present & OPT_ROLLOVER) || opts->rollover != g->opts.rollover))
+        return 0;
+    return 1;
+}
+
+// Ouvre le fichier et le socket d'un nouveau groupe. Renvoie -1 en cas d'échec.
+static int open_group(mcast_group *g, int slot, const char *filename) {
+    memset(g, 0, sizeof(*g));
+    g->fd = -1;
+    snprintf(g->filename, sizeof(g->filename), "%s", filename);
+    g->group.sin_family = AF_INET;
+    g->group.sin_addr.s_addr = htonl(ntohl(mc.first_group.s_addr) + slot);
+    g->group.sin_port = htons(mc.port);
+    g->lock = lock_table_acquire(filename, LOCK_SHARED, 0);
+    if (!g->lock)
+        return -1;
+    g->cached = file_cache_acquire(filename);
+    if (g->cached) {
+        g->map = *file_cache_map(g->cached);
+        g->mapped = 1;
+    } else {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s%s", mc.dir, filename);
+        g->fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (g->fd < 0) {
+            lock_table_release(g->lock);
+            return -1;
+        }
+        g->mapped = file_map_open(&g->map, g->fd) == 0;
+    }
+    g->file_size = g->mapped ? (long long)g->map.size : lseek(g->fd, 0, SEEK_END);
+    g->sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    struct sockaddr_in local = { .sin_family = AF_INET, .sin_addr.s_addr = INADDR_ANY };
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = slot };
+    int loop = 1;  // Les clients de cette machine reçoivent aussi le groupe
+    if (g->sockfd < 0 || bind(g->sockfd, (struct sockaddr*)&local, sizeof(local)) < 0 ||
+        setsockopt(g->sockfd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0 ||
+        epoll_ctl(mc.epfd, EPOLL_CTL_ADD, g->sockfd, &ev) < 0) {
+        perror("[ERROR] Socket du groupe multicast");
+        if (g->sockfd >= 0)
+            close(g->sockfd);
+        if (g->cached)
+            file_cache_release(g->cached);
+        else if (g->mapped)
+            file_map_close(&g->map);
+        if (g->fd >= 0)
+            close(g->fd);
+        lock_table_release(g->lock);
+        return -1;
+    }
+    g->used = 1;
+    g->start_us = rtt_now_us();
+    return 0;
+}
+
+int mcast_join(const struct sockaddr_in *client, const char *filename, const tftp_options *opts) {
+    // Un nom caché est refusé par le service unicast, vers lequel on renvoie
+    if (!mc.enabled || (opts->present & OPT_OFFSET) || write_pipe_hidden(filename))
+        return -1;
+    pthread_mutex_lock(&mc.lock);
+    mcast_group *g = NULL;
+    int free_slot = -1;
+    for (int i = 0; i < MCAST_MAX_GROUPS; i++) {
+        if (mc.groups[i].used && strcmp(mc.groups[i].filename, filename) == 0)
+            g = &mc.groups[i];
+        else if (!mc.groups[i].used && free_slot < 0)
+            free_slot = i;
+    }
+    int ret = -1;
+    if (g) {
+        int k = find_member(g, client);
+        if (k >= 0) {
+            // RRQ retransmis : l'OACK s'est perdu
+            send_oack(g, &g->members[k], k == 0);
+            ret = 0;
+        } else if (compatible(g, opts) && (k = add_member(g, client, opts)) >= 0) {
+            log_info("[INFO] Multicast %s : %s:%d rejoint le groupe (%d clients).\n", filename,
+                     inet_ntoa(client->sin_addr), ntohs(client->sin_port), g->count);
+            send_oack(g, &g->members[k], 0);
+            ret = 0;
+        }
+    } else if (free_slot >= 0 && open_group(&mc.groups[free_slot], free_slot, filename) == 0) {
+        g = &mc.groups[free_slot];
+        group_options(g, opts);
+        rtt_init(&g->rtt, 0);
+        g->last_block = g->file_size / g->opts.blksize + 1;
+        if (add_member(g, client, opts) < 0) {
+            close_group(g);
+        } else {
+            log_info("[INFO] Multicast %s : groupe %s:%d ouvert (%lld octets, blocs de %d octets).\n",
+                     filename, inet_ntoa(g->group.sin_addr), mc.port, g->file_size, g->opts.blksize);
+            promote(g);
+            wake();
+            ret = 0;
+        }
+    }
+    pthread_mutex_unlock(&mc.lock);
+    return ret;
+}
+
+// Numéro du bloc acquitté par le maître. Il ne peut dépasser le plus grand bloc
+// envoyé au groupe, mais un maître promu acquitte le préfixe sans trou qu'il a
+// reçu à l'écoute, parfois plus d'un demi-cycle de numéros au-delà du dernier
+// ACK : le numéro retenu est le plus grand de ceux qui ne dépassent pas
+// highest_sent. Un 0 avant tout ACK est celui de l'OACK par un client sans bloc.
+static long long master_ack(const mcast_group *g, unsigned int wire) {
+    if (g->acked < 0 && wire == 0)
+        return 0;
+    long long block = block_from_wire(wire, g->highest_sent, g->opts.rollover);
+    if (block > g->highest_sent)
+        block -= g->opts.rollover ? MAX_WIRE_BLOCK : MAX_WIRE_BLOCK + 1;
+    return block;
+}
+
+// Paquet reçu sur le socket du groupe. Seul le maître fait avancer le flux ; un
+// autre client qui acquitte le dernier bloc a tout reçu et quitte le groupe.
+static void handle_packet(mcast_group *g, const char *packet, int n, const struct sockaddr_in *from) {
+    int k = find_member(g, from);
+    if (k < 0) {
+        send_error(g, from, 5, "TID inconnu");
+        return;
+    }
+    if (n < 4)
+        return;
+    int opcode = packet_opcode(packet, n);
+    if (opcode == ERROR) {
+        log_info("[INFO] Multicast %s : %s:%d quitte le groupe (ERROR).\n", g->filename,
+                 inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+        metrics_inc(MET_ERRORS_RECEIVED);
+        remove_member(g, k);
+        return;
+    }
+    if (opcode != ACK)
+        return;
+    unsigned int wire = packet_block(packet);
+    if (k > 0) {
+        if (block_from_wire(wire, g->last_block, g->opts.rollover) == g->last_block)
+            remove_member(g, k);
+        return;
+    }
+    long long block = master_ack(g, wire);
+    // Le maître acquitte le dernier bloc reçu sans trou : au-delà de la fenêtre
+    // envoyée s'il a reçu la suite quand il n'était qu'à l'écoute
+    if (block <= g->acked || block < 0 || block > g->last_block)
+        return;
+    metrics_observe(HIST_RTT, rtt_progress(&g->rtt, g->sent_us, g->retransmitted));
+    g->acked = block;
+    if (block == g->last_block) {
+        log_info("[INFO] Multicast %s : %s:%d a reçu le fichier.\n", g->filename,
+                 inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+        metrics_observe(HIST_TRANSFER, rtt_now_us() - g->start_us);
+        remove_member(g, 0);
+        return;
+    }
+    send_window(g);
+}
+
+static void handle_timeout(mcast_group *g, long long now) {
+    rtt_timeout(&g->rtt);
+    if (rtt_gave_up(&g->rtt, now)) {
+        log_warn("[WARN] Multicast %s : plus de réponse du maître %s:%d, client suivant.\n",
+                 g->filename, inet_ntoa(g->members[0].addr.sin_addr), ntohs(g->members[0].addr.sin_port));
+        metrics_inc(MET_TIMEOUTS);
+        remove_member(g, 0);
+        return;
+    }
+    metrics_inc(MET_RETRANSMITS);
+    if (g->acked < 0) {
+        send_oack(g, &g->members[0], 1);
+        arm_timer(g, 1);
+    } else {
+        send_window(g);
+    }
+}
+
+long long mcast_process(void) {
+    if (!mc.enabled)
+        return -1;
+    pthread_mutex_lock(&mc.lock);
+    struct epoll_event events[MCAST_MAX_GROUPS + 1];
+    int nev = epoll_wait(mc.epfd, events, MCAST_MAX_GROUPS + 1, 0);
+    for (int e = 0; e < nev; e++) {
+        if (events[e].data.u32 == WAKE_EVENT) {
+            // Le réveil ne porte rien : les échéances sont recalculées plus bas
+            unsigned long long count;
+            while (read(mc.wake_fd, &count, sizeof(count)) > 0)
+                ;
+            continue;
+        }
+        mcast_group *g = &mc.groups[events[e].data.u32];
+        while (g->used) {
+            struct sockaddr_in from;
+            socklen_t len = sizeof(from);
+            int n = recvfrom(g->sockfd, mc.rx, sizeof(mc.rx), MSG_DONTWAIT, (struct sockaddr*)&from, &len);
+            if (n < 0)
+                break;
+            handle_packet(g, mc.rx, n, &from);
+        }
+    }
+    long long now = rtt_now_us();
+    long long next = -1;
+    for (int i = 0; i < MCAST_MAX_GROUPS; i++) {
+        mcast_group *g = &mc.groups[i];
+        if (g->used && g->deadline_us <= now)
+            handle_timeout(g, now);
+        if (g->used && (next < 0 || g->deadline_us < next))
+            next = g->deadline_us;
+    }
+    pthread_mutex_unlock(&mc.lock);
+    return next;
+}
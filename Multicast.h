@@ -0,0 +1,38 @@
+#ifndef MULTICAST_H
+#define MULTICAST_H
+
+#include <netinet/in.h>
+
+#include "TftpOptions.h"
+
+// Transferts multicast (RFC 2090), pour les démarrages en masse : les clients qui
+// lisent le même fichier avec l'option multicast rejoignent un groupe alimenté par
+// un seul flux de DATA. Le client maître acquitte les fenêtres ; quand il a tout
+// reçu, le client suivant devient maître et redemande les blocs qu'il a manqués.
+// Chaque groupe a son socket, TID du serveur pour tous ses clients. Ces sockets
+// sont surveillés par une instance epoll interne, dont le descripteur se
+// surveille comme celui d'un socket.
+
+#define MCAST_DEFAULT_GROUP "239.255.69.1"  // Premier groupe attribué
+#define MCAST_DEFAULT_PORT 1758
+#define MCAST_MAX_GROUPS 16                 // Groupes simultanés, sur des adresses consécutives
+
+// Prépare les groupes first_group, first_group + 1... sur port, pour les fichiers
+// de dir (chemin terminé par '/'). Renvoie -1 en cas d'échec : l'option multicast
+// est alors ignorée et les clients servis en unicast.
+int mcast_init(const char *dir, const char *first_group, int port);
+
+// Descripteur à surveiller en lecture (-1 si le multicast est désactivé)
+int mcast_fd(void);
+
+// Rattache le client au groupe qui diffuse filename, créé au besoin, et lui envoie
+// l'OACK. Renvoie 0 si le client est servi par le groupe, -1 s'il doit l'être en
+// unicast : multicast désactivé, fichier illisible ou verrouillé, options
+// incompatibles avec celles du groupe en cours, plus de groupe libre.
+int mcast_join(const struct sockaddr_in *client, const char *filename, const tftp_options *opts);
+
+// Traite les paquets reçus et les échéances expirées.
+// Renvoie la prochaine échéance (horloge de rtt_now_us), -1 si aucune.
+long long mcast_process(void);
+
+#endif
@@ -0,0 +1,440 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+
+#include "Rtt.h"
+
+// Proxy UDP de dégradation du réseau, placé entre le client et un serveur :
+// pertes, doublons, réordonnancement, délai et gigue, tirés d'un générateur
+// pseudo-aléatoire à graine. Chaque flux (un port client) et chaque sens ont
+// leur propre suite de tirages : une même graine donne les mêmes décisions
+// pour le n-ième paquet du k-ième flux, quel que soit l'entrelacement des
+// paquets des différents flux.
+//
+// Le changement de port du serveur (socket de session) est reproduit : les
+// réponses d'une session arrivent au client depuis un port propre du proxy.
+
+#define DEFAULT_LISTEN_PORT 7000
+#define DEFAULT_SERVER_PORT 6969
+#define MAX_DATAGRAM 65536
+#define MAX_EVENTS 64
+#define FLOW_IDLE_US 30000000LL     // Flux oublié après 30 s sans paquet
+#define LISTEN_ID UINT64_MAX        // Donnée epoll du socket d'écoute
+
+enum { UP, DOWN };                  // UP : client -> serveur, DOWN : serveur -> client
+
+typedef struct {
+    double loss;                    // Probabilités entre 0 et 1
+    double duplicate;
+    double reorder;
+    long delay_us;
+    long jitter_us;                 // Ajout uniforme dans [0, jitter]
+    long reorder_us;                // Retard supplémentaire d'un paquet réordonné
+} impairment;
+
+typedef struct {
+    unsigned long received, dropped, duplicated, reordered, sent;
+} direction_stats;
+
+typedef struct {
+    struct sockaddr_in client;
+    struct sockaddr_in session;     // Adresse de session du serveur (port 0 avant sa réponse)
+    int up_fd;                      // Échange avec le serveur
+    int down_fd;                    // Échange avec le client une fois la session ouverte
+    unsigned int generation;        // Distingue les flux successifs d'un même emplacement
+    unsigned long long rng[2];      // Tirages de chaque sens
+    long long last_due_us[2];       // Sans réordonnancement, l'ordre d'un sens est conservé
+    long long last_us;
+} flow;
+
+// Paquet retardé, envoyé à due_us par le flux s'il existe encore
+typedef struct {
+    long long due_us;
+    unsigned long seq;              // Départage les échéances égales (ordre d'arrivée)
+    int slot;
+    unsigned int generation;
+    int dir;
+    struct sockaddr_in to;
+    int len;
+    char data[];
+} packet;
+
+static impairment imp;
+static unsigned long long seed = 1;
+static struct sockaddr_in server;
+static int epfd, listen_fd;
+static flow **flows;
+static int flow_slots;
+static unsigned int next_generation;
+static direction_stats stats[2];
+static packet **heap;
+static int heap_len, heap_cap;
+static unsigned long next_seq;
+static volatile sig_atomic_t stop;
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-p port_écoute] [-s serveur] [-P port_serveur] [-x graine]\n"
+            "          [-L pertes%%] [-D doublons%%] [-R réordonnancement%%]\n"
+            "          [-d délai_ms] [-j gigue_ms] [-g retard_réordonné_ms]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+// splitmix64 : dérive l'état d'une suite à partir de la graine
+static unsigned long long mix64(unsigned long long x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// xorshift64* : tirage uniforme dans [0, 1)
+static double uniform(unsigned long long *state) {
+    unsigned long long x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return ((x * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53;
+}
+
+static int heap_before(const packet *a, const packet *b) {
+    return a->due_us < b->due_us || (a->due_us == b->due_us && a->seq < b->seq);
+}
+
+static int heap_push(packet *p) {
+    if (heap_len == heap_cap) {
+        int cap = heap_cap ? 2 * heap_cap : 256;
+        packet **grown = realloc(heap, cap * sizeof(*heap));
+        if (!grown)
+            return -1;
+        heap = grown;
+        heap_cap = cap;
+    }
+    int i = heap_len++;
+    while (i > 0 && heap_before(p, heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = p;
+    return 0;
+}
+
+static packet *heap_pop(void) {
+    packet *top = heap[0];
+    packet *last = heap[--heap_len];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= heap_len)
+            break;
+        if (child + 1 < heap_len && heap_before(heap[child + 1], heap[child]))
+            child++;
+        if (!heap_before(heap[child], last))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (heap_len > 0)
+        heap[i] = last;
+    return top;
+}
+
+static int open_socket(unsigned long long id) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    struct epoll_event ev = { .events = EPOLLIN, .data.u64 = id };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void free_flow(int slot) {
+    flow *f = flows[slot];
+    close(f->up_fd);
+    if (f->down_fd >= 0)
+        close(f->down_fd);
+    free(f);
+    flows[slot] = NULL;
+}
+
+static int find_flow(const struct sockaddr_in *client) {
+    for (int slot = 0; slot < flow_slots; slot++) {
+        flow *f = flows[slot];
+        if (f && f->client.sin_port == client->sin_port && f->client.sin_addr.s_addr == client->sin_addr.s_addr)
+            return slot;
+    }
+    return -1;
+}
+
+static int create_flow(const struct sockaddr_in *client) {
+    int slot = 0;
+    while (slot < flow_slots && flows[slot])
+        slot++;
+    if (slot == flow_slots) {
+        int count = flow_slots ? 2 * flow_slots : 64;
+        flow **grown = realloc(flows, count * sizeof(*flows));
+        if (!grown)
+            return -1;
+        memset(grown + flow_slots, 0, (count - flow_slots) * sizeof(*grown));
+        flows = grown;
+        flow_slots = count;
+    }
+    flow *f = calloc(1, sizeof(*f));
+    if (!f)
+        return -1;
+    f->up_fd = open_socket((unsigned long long)slot << 1 | UP);
+    if (f->up_fd < 0) {
+        free(f);
+        return -1;
+    }
+    f->client = *client;
+    f->down_fd = -1;
+    // Tirages propres au flux : la graine et son rang de création
+    f->generation = next_generation++;
+    f->rng[UP] = mix64(seed ^ mix64(2ULL * f->generation)) | 1;
+    f->rng[DOWN] = mix64(seed ^ mix64(2ULL * f->generation + 1)) | 1;
+    flows[slot] = f;
+    return slot;
+}
+
+static void transmit(flow *f, int dir, const struct sockaddr_in *to, const char *data, int len) {
+    int fd = dir == UP ? f->up_fd : f->down_fd;
+    if (fd >= 0 && sendto(fd, data, len, 0, (const struct sockaddr*)to, sizeof(*to)) == len)
+        stats[dir].sent++;
+}
+
+// Applique la dégradation à un paquet puis l'envoie ou le met en attente
+static void impair(int slot, int dir, const struct sockaddr_in *to, const char *data, int len) {
+    flow *f = flows[slot];
+    unsigned long long *rng = &f->rng[dir];
+    long long now = rtt_now_us();
+    stats[dir].received++;
+    f->last_us = now;
+    // Autant de tirages pour chaque paquet : les décisions du n-ième paquet d'un
+    // flux ne dépendent que de la graine
+    double lost = uniform(rng), dup = uniform(rng);
+    int copies = lost < imp.loss ? 0 : dup < imp.duplicate ? 2 : 1;
+    if (copies == 0)
+        stats[dir].dropped++;
+    if (copies == 2)
+        stats[dir].duplicated++;
+    for (int c = 0; c < 2; c++) {
+        double jitter = uniform(rng), reorder = uniform(rng);
+        if (c >= copies)
+            continue;
+        long long due = now + imp.delay_us + (long long)(jitter * imp.jitter_us);
+        if (reorder < imp.reorder) {
+            due += imp.reorder_us;
+            stats[dir].reordered++;
+        } else {
+            if (due < f->last_due_us[dir])
+                due = f->last_due_us[dir];
+            f->last_due_us[dir] = due;
+        }
+        if (due <= now && heap_len == 0) {
+            transmit(f, dir, to, data, len);
+            continue;
+        }
+        packet *p = malloc(sizeof(*p) + len);
+        if (!p)
+            continue;
+        p->due_us = due;
+        p->seq = next_seq++;
+        p->slot = slot;
+        p->generation = f->generation;
+        p->dir = dir;
+        p->to = *to;
+        p->len = len;
+        memcpy(p->data, data, len);
+        if (heap_push(p) < 0)
+            free(p);
+    }
+}
+
+static void send_due(long long now) {
+    while (heap_len > 0 && heap[0]->due_us <= now) {
+        packet *p = heap_pop();
+        flow *f = flows[p->slot];
+        // Le flux a pu être oublié entre-temps
+        if (f && f->generation == p->generation)
+            transmit(f, p->dir, &p->to, p->data, p->len);
+        free(p);
+    }
+}
+
+// Requête d'un client sur le port d'écoute : nouveau flux ou nouveau transfert d'un flux connu
+static void from_listener(const struct sockaddr_in *from, const char *data, int len) {
+    int slot = find_flow(from);
+    if (slot < 0 && (slot = create_flow(from)) < 0) {
+        perror("Création d'un flux");
+        return;
+    }
+    impair(slot, UP, &server, data, len);
+}
+
+// Réponse du serveur : un nouveau port source ouvre une nouvelle session côté client
+static void from_server(int slot, const struct sockaddr_in *from, const char *data, int len) {
+    flow *f = flows[slot];
+    if (f->down_fd < 0 || f->session.sin_port != from->sin_port || f->session.sin_addr.s_addr != from->sin_addr.s_addr) {
+        if (f->down_fd >= 0)
+            close(f->down_fd);
+        f->down_fd = open_socket((unsigned long long)slot << 1 | DOWN);
+        if (f->down_fd < 0) {
+            perror("Socket de session");
+            return;
+        }
+        f->session = *from;
+    }
+    impair(slot, DOWN, &f->client, data, len);
+}
+
+static void handle_readable(unsigned long long id, char *buf) {
+    int fd;
+    int slot = -1, dir = UP;
+    if (id == LISTEN_ID) {
+        fd = listen_fd;
+    } else {
+        slot = (int)(id >> 1);
+        dir = (int)(id & 1);
+        if (slot >= flow_slots || !flows[slot])
+            return;
+        fd = dir == UP ? flows[slot]->up_fd : flows[slot]->down_fd;
+    }
+    while (1) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        int n = recvfrom(fd, buf, MAX_DATAGRAM, 0, (struct sockaddr*)&from, &from_len);
+        if (n < 0)
+            return;
+        if (id == LISTEN_ID)
+            from_listener(&from, buf, n);
+        else if (dir == UP)
+            from_server(slot, &from, buf, n);
+        else if (from.sin_port == flows[slot]->client.sin_port && from.sin_addr.s_addr == flows[slot]->client.sin_addr.s_addr)
+            impair(slot, UP, &flows[slot]->session, buf, n);
+    }
+}
+
+static void expire_flows(long long now) {
+    for (int slot = 0; slot < flow_slots; slot++) {
+        if (flows[slot] && now - flows[slot]->last_us > FLOW_IDLE_US)
+            free_flow(slot);
+    }
+}
+
+static void print_stats(void) {
+    static const char *names[2] = { "client -> serveur", "serveur -> client" };
+    for (int dir = UP; dir <= DOWN; dir++) {
+        printf("%s : %lu reçus, %lu perdus, %lu doublés, %lu réordonnés, %lu envoyés\n",
+               names[dir], stats[dir].received, stats[dir].dropped, stats[dir].duplicated,
+               stats[dir].reordered, stats[dir].sent);
+    }
+}
+
+static double percent(const char *arg) {
+    double p = atof(arg);
+    if (p < 0 || p > 100) {
+        fprintf(stderr, "Pourcentage invalide : %s\n", arg);
+        exit(EXIT_FAILURE);
+    }
+    return p / 100;
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = "127.0.0.1";
+    int listen_port = DEFAULT_LISTEN_PORT, server_port = DEFAULT_SERVER_PORT;
+    imp.reorder_us = 10000;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:P:x:L:D:R:d:j:g:")) != -1) {
+        switch (opt) {
+            case 'p': listen_port = atoi(optarg); break;
+            case 's': host = optarg; break;
+            case 'P': server_port = atoi(optarg); break;
+            case 'x': seed = strtoull(optarg, NULL, 0); break;
+            case 'L': imp.loss = percent(optarg); break;
+            case 'D': imp.duplicate = percent(optarg); break;
+            case 'R': imp.reorder = percent(optarg); break;
+            case 'd': imp.delay_us = atol(optarg) * 1000; break;
+            case 'j': imp.jitter_us = atol(optarg) * 1000; break;
+            case 'g': imp.reorder_us = atol(optarg) * 1000; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (listen_port < 1 || listen_port > 65535 || server_port < 1 || server_port > 65535 ||
+        imp.delay_us < 0 || imp.jitter_us < 0 || imp.reorder_us < 0)
+        usage(argv[0]);
+
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_port = htons(server_port);
+    if (inet_pton(AF_INET, host, &server.sin_addr) != 1)
+        usage(argv[0]);
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    listen_fd = epfd < 0 ? -1 : open_socket(LISTEN_ID);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(listen_port);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Socket d'écoute");
+        return EXIT_FAILURE;
+    }
+    char *buf = malloc(MAX_DATAGRAM);
+    if (!buf)
+        return EXIT_FAILURE;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("Proxy en écoute sur le port %d vers %s:%d (graine %llu, pertes %.1f%%, doublons %.1f%%, "
+           "réordonnancement %.1f%%, délai %ld ms, gigue %ld ms)\n",
+           listen_port, host, server_port, seed, imp.loss * 100, imp.duplicate * 100,
+           imp.reorder * 100, imp.delay_us / 1000, imp.jitter_us / 1000);
+    fflush(stdout);
+
+    long long next_expiry = rtt_now_us() + FLOW_IDLE_US;
+    struct epoll_event events[MAX_EVENTS];
+    while (!stop) {
+        long long now = rtt_now_us();
+        int wait_ms = 1000;
+        if (heap_len > 0) {
+            long long wait_us = heap[0]->due_us - now;
+            // Arrondi au-dessus : se réveiller avant l'échéance ne ferait que tourner à vide
+            wait_ms = wait_us <= 0 ? 0 : (int)((wait_us + 999) / 1000);
+        }
+        int n = epoll_wait(epfd, events, MAX_EVENTS, wait_ms);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int e = 0; e < n; e++)
+            handle_readable(events[e].data.u64, buf);
+        now = rtt_now_us();
+        send_due(now);
+        if (now >= next_expiry) {
+            expire_flows(now);
+            next_expiry = now + FLOW_IDLE_US;
+        }
+    }
+    print_stats();
+    return EXIT_SUCCESS;
+}
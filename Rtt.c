@@ -0,0 +1,72 @@
+#define _GNU_SOURCE
+#include <poll.h>
+#include <time.h>
+#include <errno.h>
+
+#include "Rtt.h"
+
+long long rtt_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static long clamp_rto(const rtt_estimator *rtt, long rto_us) {
+    if (rto_us < RTT_MIN_US)
+        return RTT_MIN_US;
+    if (rto_us > rtt->max_rto_us)
+        return rtt->max_rto_us;
+    return rto_us;
+}
+
+void rtt_init(rtt_estimator *rtt, int timeout_sec) {
+    rtt->srtt_us = 0;
+    rtt->rttvar_us = 0;
+    rtt->max_rto_us = timeout_sec > 0 ? timeout_sec * 1000000L : RTT_DEFAULT_MAX_US;
+    rtt->rto_us = clamp_rto(rtt, RTT_INITIAL_US);
+    rtt->last_progress_us = rtt_now_us();
+}
+
+long rtt_progress(rtt_estimator *rtt, long long sent_us, int retransmitted) {
+    long long now = rtt_now_us();
+    rtt->last_progress_us = now;
+    // Règle de Karn : le délai doublé est conservé jusqu'à une mesure non ambiguë
+    if (retransmitted)
+        return -1;
+    long sample = now - sent_us;
+    if (rtt->srtt_us == 0) {
+        rtt->srtt_us = sample;
+        rtt->rttvar_us = sample / 2;
+    } else {
+        long delta = sample > rtt->srtt_us ? sample - rtt->srtt_us : rtt->srtt_us - sample;
+        rtt->rttvar_us += (delta - rtt->rttvar_us) / 4;    // beta = 1/4
+        rtt->srtt_us += (sample - rtt->srtt_us) / 8;        // alpha = 1/8
+    }
+    rtt->rto_us = clamp_rto(rtt, rtt->srtt_us + 4 * rtt->rttvar_us);
+    return sample;
+}
+
+void rtt_timeout(rtt_estimator *rtt) {
+    rtt->rto_us = clamp_rto(rtt, rtt->rto_us * 2);
+}
+
+int rtt_gave_up(const rtt_estimator *rtt, long long now_us) {
+    return now_us - rtt->last_progress_us > rtt->max_rto_us * RTT_MAX_TIMEOUTS;
+}
+
+int rtt_wait_readable(int fd, long long deadline_us) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    while (1) {
+        long long remaining = deadline_us - rtt_now_us();
+        if (remaining <= 0)
+            return 0;
+        struct timespec ts = { remaining / 1000000, (remaining % 1000000) * 1000 };
+        int ret = ppoll(&pfd, 1, &ts, NULL);
+        if (ret > 0)
+            return 1;
+        if (ret == 0)
+            return 0;
+        if (errno != EINTR)
+            return 0;
+    }
+}
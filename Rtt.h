@@ -0,0 +1,43 @@
+#ifndef RTT_H
+#define RTT_H
+
+// Estimation du RTT et délai de retransmission adaptatif (RFC 6298) :
+// RTT lissé, variance, règle de Karn et backoff exponentiel.
+
+#define RTT_INITIAL_US 1000000L     // Délai avant le premier échantillon
+#define RTT_MIN_US 10000L           // Plancher : quelques ms suffisent sur un LAN
+#define RTT_DEFAULT_MAX_US 5000000L // Plafond sans option timeout (RFC 2349)
+#define RTT_MAX_TIMEOUTS 5          // Abandon après ce nombre de plafonds sans progrès
+#define RTT_DALLY_FACTOR 4          // Après le dernier ACK, le récepteur reste à l'écoute ce
+                                    // nombre de délais pour réacquitter un dernier bloc renvoyé
+
+typedef struct {
+    long srtt_us;               // RTT lissé (0 tant qu'aucun échantillon)
+    long rttvar_us;             // Variation du RTT
+    long rto_us;                // Délai de retransmission courant
+    long max_rto_us;            // Plafond du délai (option timeout)
+    long long last_progress_us; // Dernier ACK ou DATA ayant fait avancer le transfert
+} rtt_estimator;
+
+// Horloge monotone en microsecondes
+long long rtt_now_us(void);
+
+// Initialise l'estimateur ; timeout_sec est l'option timeout négociée (0 si absente)
+void rtt_init(rtt_estimator *rtt, int timeout_sec);
+
+// Le transfert a progressé. sent_us est l'instant d'envoi du paquet qui a provoqué
+// la réponse ; s'il a été retransmis, la mesure est ambiguë et ignorée (règle de Karn).
+// Renvoie le RTT mesuré en microsecondes, -1 si aucune mesure n'a été retenue.
+long rtt_progress(rtt_estimator *rtt, long long sent_us, int retransmitted);
+
+// Le délai a expiré sans réponse : il est doublé, dans la limite du plafond
+void rtt_timeout(rtt_estimator *rtt);
+
+// Vrai si le transfert n'a plus progressé depuis trop longtemps
+int rtt_gave_up(const rtt_estimator *rtt, long long now_us);
+
+// Attend qu'un paquet soit lisible sur fd jusqu'à deadline_us.
+// Renvoie 1 si un paquet est disponible, 0 à l'expiration du délai.
+int rtt_wait_readable(int fd, long long deadline_us);
+
+#endif
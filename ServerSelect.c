@@ -1,383 +1,1609 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <sys/time.h>
-#include <time.h>
-#include <errno.h>
-
-#define DATA_SIZE 512
-#define PACKET_SIZE (DATA_SIZE + 4)
-#define MAX_RETRIES 5
-
-#define MAX_SESSIONS 10
-#define TIMEOUT_SEC 5
-
-// Codes d'opération TFTP
-#define RRQ 1    // Read Request
-#define WRQ 2    // Write Request
-#define DATA 3   // Paquet DATA
-#define ACK 4    // Accusé de réception
-#define ERROR 5  // Message d'erreur
-
-// Répertoire de base pour les transferts
-#define TFTP_DIR "/var/lib/tftpboot/"
-
-// ----------------------- Structure de session -----------------------
-
-typedef enum {
-    ST_UNUSED = 0,   // Session libre
-    ST_RRQ,          // Envoi de fichier vers le client (lecture côté client)
-    ST_WRQ           // Réception de fichier depuis le client (écriture côté serveur)
-} session_state;
-
-typedef struct {
-    session_state state;           // État de la session (lecture ou écriture)
-    struct sockaddr_in client_addr; // Adresse du client associé à la session
-    FILE *fp;                      // Fichier en cours de transfert
-    int block_num;                 // Bloc courant (envoyé ou attendu)
-    int last_data_size;            // Taille du dernier bloc DATA envoyé (pour RRQ)
-    time_t last_activity;          // Dernière activité (pour gérer le timeout)
-    int retries;                   // Nombre de retransmissions effectuées
-    int sockfd_session;            // Socket dédiée à cette session
-} tftp_session;
-
-static tftp_session sessions[MAX_SESSIONS];
-static int sockfd;  // Socket globale pour l'initialisation
-
-// ----------------------- Fonctions d'envoi utilisant le socket de session -----------------------
-
-void send_ack_session(int session_sockfd, int block_num) {
-    char ack[4];
-    ack[0] = 0;
-    ack[1] = ACK;
-    ack[2] = (block_num >> 8) & 0xFF;
-    ack[3] = block_num & 0xFF;
-    send(session_sockfd, ack, sizeof(ack), 0);
-    printf("[INFO] ACK envoyé - Bloc %d\n", block_num);
-}
-
-void send_error_session(int session_sockfd, int error_code, char *msg) {
-    char buffer[PACKET_SIZE];
-    memset(buffer, 0, PACKET_SIZE);
-    buffer[0] = 0;
-    buffer[1] = ERROR;
-    buffer[2] = (error_code >> 8) & 0xFF;
-    buffer[3] = error_code & 0xFF;
-    strcpy(buffer + 4, msg);
-    send(session_sockfd, buffer, 4 + strlen(msg) + 1, 0);
-    printf("[INFO] ERROR envoyé : %s\n", msg);
-}
-
-// ----------------------- Gestion des sessions -----------------------
-
-int find_session_slot(struct sockaddr_in *addr) {
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (sessions[i].state != ST_UNUSED) {
-            if (sessions[i].client_addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
-                sessions[i].client_addr.sin_port == addr->sin_port)
-                return i;
-        }
-    }
-    return -1; // Aucune session existante pour ce client
-}
-
-int create_session(struct sockaddr_in *addr, session_state st) {
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (sessions[i].state == ST_UNUSED) {
-            sessions[i].state = st;
-            sessions[i].client_addr = *addr;
-            sessions[i].fp = NULL;
-            sessions[i].block_num = 0;
-            sessions[i].last_data_size = 0;
-            sessions[i].last_activity = time(NULL);
-            sessions[i].retries = 0;
-            // Création d'un socket dédié pour la session
-            sessions[i].sockfd_session = socket(AF_INET, SOCK_DGRAM, 0);
-            if (sessions[i].sockfd_session < 0) {
-                perror("socket");
-                sessions[i].state = ST_UNUSED;
-                return -1;
-            }
-            // Bind sur une adresse locale avec port éphémère (0)
-            struct sockaddr_in local_addr;
-            memset(&local_addr, 0, sizeof(local_addr));
-            local_addr.sin_family = AF_INET;
-            local_addr.sin_addr.s_addr = INADDR_ANY;
-            local_addr.sin_port = htons(0); // port éphémère
-            if (bind(sessions[i].sockfd_session, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
-                perror("bind");
-                close(sessions[i].sockfd_session);
-                sessions[i].state = ST_UNUSED;
-                return -1;
-            }
-            // Connecte le socket à l'adresse du client
-            if (connect(sessions[i].sockfd_session, (struct sockaddr*)addr, sizeof(*addr)) < 0) {
-                perror("connect");
-                close(sessions[i].sockfd_session);
-                sessions[i].state = ST_UNUSED;
-                return -1;
-            }
-            return i;
-        }
-    }
-    return -1; // Aucune session disponible
-}
-
-void close_session(int idx) {
-    if (sessions[idx].fp) {
-        fclose(sessions[idx].fp);
-        sessions[idx].fp = NULL;
-    }
-    if (sessions[idx].sockfd_session > 0) {
-        close(sessions[idx].sockfd_session);
-        sessions[idx].sockfd_session = -1;
-    }
-    sessions[idx].state = ST_UNUSED;
-    printf("[INFO] Session %d fermée.\n", idx);
-}
-
-void check_timeouts() {
-    time_t now = time(NULL);
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        if (sessions[i].state != ST_UNUSED) {
-            if (difftime(now, sessions[i].last_activity) > TIMEOUT_SEC) {
-                printf("[WARN] Timeout session %d\n", i);
-                close_session(i);
-            }
-        }
-    }
-}
-
-// ----------------------- Handlers pour les transferts -----------------------
-
-void handle_rrq(int idx, char *filename) {
-    char filepath[1024];
-    snprintf(filepath, sizeof(filepath), "%s%s", TFTP_DIR, filename);
-    FILE *fp = fopen(filepath, "rb");
-    if (!fp) {
-        perror("[ERROR] Fichier introuvable");
-        close_session(idx);
-        return;
-    }
-    sessions[idx].fp = fp;
-    sessions[idx].block_num = 1;
-    sessions[idx].state = ST_RRQ;
-    
-    // Envoi immédiat du premier bloc DATA
-    char buffer[PACKET_SIZE];
-    memset(buffer, 0, PACKET_SIZE);
-    buffer[0] = 0;
-    buffer[1] = DATA;
-    buffer[2] = (sessions[idx].block_num >> 8) & 0xFF;
-    buffer[3] = sessions[idx].block_num & 0xFF;
-    int n = fread(buffer + 4, 1, DATA_SIZE, fp);
-    sessions[idx].last_data_size = n;
-    send(sessions[idx].sockfd_session, buffer, n + 4, 0);
-    printf("[INFO] DATA envoyé - Bloc %d (%d octets)\n", sessions[idx].block_num, n);
-    sessions[idx].last_activity = time(NULL);
-}
-
-void handle_wrq(int idx, char *filename) {
-    char filepath[1024];
-    snprintf(filepath, sizeof(filepath), "%s%s", TFTP_DIR, filename);
-    FILE *fp = fopen(filepath, "wb");
-    if (!fp) {
-        perror("[ERROR] Impossible de créer le fichier");
-        close_session(idx);
-        return;
-    }
-    sessions[idx].fp = fp;
-    sessions[idx].block_num = 0;  // On attend le bloc 1
-    sessions[idx].state = ST_WRQ;
-    send_ack_session(sessions[idx].sockfd_session, 0);
-    sessions[idx].last_activity = time(NULL);
-}
-
-void handle_data(int idx, char *buffer, int n) {
-    if (n < 4) return;
-    int block_num = (buffer[2] << 8) | (unsigned char)buffer[3];
-    if (block_num == sessions[idx].block_num + 1) {
-        int data_len = n - 4;
-        fwrite(buffer + 4, 1, data_len, sessions[idx].fp);
-        sessions[idx].block_num = block_num;
-        send_ack_session(sessions[idx].sockfd_session, block_num);
-        sessions[idx].last_activity = time(NULL);
-        if (data_len < DATA_SIZE) {
-            printf("[INFO] Fin WRQ session %d\n", idx);
-            close_session(idx);
-        }
-    } else if (block_num == sessions[idx].block_num) {
-        // Bloc déjà reçu, renvoie de l'ACK
-        send_ack_session(sessions[idx].sockfd_session, block_num);
-    } else {
-        printf("[WARN] Session %d: bloc inattendu %d (attendu %d)\n",
-               idx, block_num, sessions[idx].block_num + 1);
-    }
-}
-
-void handle_ack(int idx, char *buffer) {
-    int block_num = (buffer[2] << 8) | (unsigned char)buffer[3];
-    if (block_num == sessions[idx].block_num) {
-        if (sessions[idx].last_data_size < DATA_SIZE) {
-            printf("[INFO] Fin RRQ session %d\n", idx);
-            close_session(idx);
-        } else {
-            sessions[idx].block_num++;
-            char data_buffer[PACKET_SIZE];
-            memset(data_buffer, 0, PACKET_SIZE);
-            data_buffer[0] = 0;
-            data_buffer[1] = DATA;
-            data_buffer[2] = (sessions[idx].block_num >> 8) & 0xFF;
-            data_buffer[3] = sessions[idx].block_num & 0xFF;
-            int n = fread(data_buffer + 4, 1, DATA_SIZE, sessions[idx].fp);
-            sessions[idx].last_data_size = n;
-            send(sessions[idx].sockfd_session, data_buffer, n + 4, 0);
-            printf("[INFO] DATA envoyé - Bloc %d (%d octets)\n", sessions[idx].block_num, n);
-            sessions[idx].last_activity = time(NULL);
-        }
-    } else if (block_num < sessions[idx].block_num) {
-        printf("[WARN] ACK en double pour bloc %d (session %d)\n", block_num, idx);
-    } else {
-        printf("[WARN] ACK inattendu bloc %d (session %d, current %d)\n",
-               block_num, idx, sessions[idx].block_num);
-    }
-}
-
-// ----------------------- Boucle principale -----------------------
-
-int main(void) {
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t addr_len = sizeof(client_addr);
-    char buffer[PACKET_SIZE];
-
-    // Création du socket global pour l'initialisation
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
-        perror("[ERROR] Échec de la création du socket.");
-        exit(EXIT_FAILURE);
-    }
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(6969);
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    if (bind(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("[ERROR] Échec du bind.");
-        exit(EXIT_FAILURE);
-    }
-
-    printf("[STARTING] Serveur TFTP multi‑clients modifié avec sockets par session sur le port 6969...\n");
-
-    // Initialisation des sessions
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        sessions[i].state = ST_UNUSED;
-        sessions[i].fp = NULL;
-        sessions[i].sockfd_session = -1;
-    }
-
-    while (1) {
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        // Ajout du socket global pour les nouvelles connexions
-        FD_SET(sockfd, &readfds);
-        int maxfd = sockfd;
-        // Ajout des sockets de session actifs
-        for (int i = 0; i < MAX_SESSIONS; i++) {
-            if (sessions[i].state != ST_UNUSED) {
-                FD_SET(sessions[i].sockfd_session, &readfds);
-                if (sessions[i].sockfd_session > maxfd)
-                    maxfd = sessions[i].sockfd_session;
-            }
-        }
-        struct timeval tv;
-        tv.tv_sec = 1;
-        tv.tv_usec = 0;
-        int ret = select(maxfd + 1, &readfds, NULL, NULL, &tv);
-        if (ret < 0) {
-            if (errno == EINTR)
-                continue;
-            perror("select");
-            break;
-        }
-        // Gestion des nouvelles requêtes sur le socket global
-        if (FD_ISSET(sockfd, &readfds)) {
-            memset(buffer, 0, PACKET_SIZE);
-            int n = recvfrom(sockfd, buffer, PACKET_SIZE, 0,
-                             (struct sockaddr*)&client_addr, &addr_len);
-            if (n < 0)
-                continue;
-            int opcode = (buffer[0] << 8) | (unsigned char)buffer[1];
-            char *filename = buffer + 2;
-            if (opcode == RRQ) {
-                printf("[INFO] RRQ reçu - Demande de lecture de fichier : %s\n", filename);
-                int idx = find_session_slot(&client_addr);
-                if (idx < 0) {
-                    idx = create_session(&client_addr, ST_RRQ);
-                    if (idx < 0) {
-                        send_error_session(sockfd, 3, "Trop de sessions actives");
-                        continue;
-                    }
-                    handle_rrq(idx, filename);
-                } else {
-                    printf("[WARN] Session existante pour ce client.\n");
-                }
-            } else if (opcode == WRQ) {
-                printf("[INFO] WRQ reçu - Demande d'écriture de fichier : %s\n", filename);
-                int idx = find_session_slot(&client_addr);
-                if (idx < 0) {
-                    idx = create_session(&client_addr, ST_WRQ);
-                    if (idx < 0) {
-                        send_error_session(sockfd, 3, "Trop de sessions actives");
-                        continue;
-                    }
-                    handle_wrq(idx, filename);
-                } else {
-                    printf("[WARN] Session existante pour ce client.\n");
-                }
-            } else {
-                send_error_session(sockfd, 4, "Opération non supportée");
-            }
-        }
-        // Traitement des paquets sur les sockets de session
-        for (int i = 0; i < MAX_SESSIONS; i++) {
-            if (sessions[i].state != ST_UNUSED &&
-                FD_ISSET(sessions[i].sockfd_session, &readfds)) {
-                memset(buffer, 0, PACKET_SIZE);
-                int n = recv(sessions[i].sockfd_session, buffer, PACKET_SIZE, 0);
-                if (n < 0)
-                    continue;
-                int opcode = (buffer[0] << 8) | (unsigned char)buffer[1];
-                switch (opcode) {
-                    case DATA:
-                        if (sessions[i].state == ST_WRQ)
-                            handle_data(i, buffer, n);
-                        else
-                            send_error_session(sessions[i].sockfd_session, 4, "Session inexistante (DATA)");
-                        break;
-                    case ACK:
-                        if (sessions[i].state == ST_RRQ)
-                            handle_ack(i, buffer);
-                        else
-                            send_error_session(sessions[i].sockfd_session, 4, "Session inexistante (ACK)");
-                        break;
-                    case ERROR:
-                        printf("[ERROR] Paquet ERROR reçu du client.\n");
-                        close_session(i);
-                        break;
-                    default:
-                        send_error_session(sessions[i].sockfd_session, 4, "Opération non supportée");
-                        break;
-                }
-            }
-        }
-        // Vérification régulière des timeouts des sessions
-        check_timeouts();
-    }
-
-    // Fermeture de toutes les sessions et du socket global avant de quitter
-    for (int i = 0; i < MAX_SESSIONS; i++) {
-        close_session(i);
-    }
-    close(sockfd);
-    return 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+
+#include "TftpOptions.h"
+#include "TftpPacket.h"
+#include "Rtt.h"
+#include "BatchIo.h"
+#include "FileMap.h"
+#include "FileCache.h"
+#include "Uring.h"
+#include "WritePipe.h"
+#include "LockTable.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Multicast.h"
+#include "Supervisor.h"
+#include "SessionPool.h"
+#include "TimerWheel.h"
+
+#define DATA_SIZE 512
+#define PACKET_SIZE (DATA_SIZE + 4)
+#define MAX_RETRIES 5
+
+#define MAX_EVENTS 256        // Événements traités par appel à epoll_wait
+#define LISTEN_EVENT UINT64_MAX  // Donnée epoll du socket global
+#define CACHE_EVENT (UINT64_MAX - 1)  // Donnée epoll du descripteur inotify du cache
+#define MCAST_EVENT (UINT64_MAX - 2)  // Donnée epoll des groupes multicast
+#define COMMIT_EVENT (UINT64_MAX - 3) // Donnée epoll des fins de validation des WRQ
+#define STATS_INTERVAL_SEC 10    // Période du rapport sur le cache
+#define LISTEN_RCVBUF (4 * 1024 * 1024)  // Tampon du socket global (borné par net.core.rmem_max)
+
+#define URING_ENTRIES 4096       // Taille de l'anneau de soumission io_uring
+#define URING_MAX_WINDOW 64      // Fenêtre maximale avec io_uring (tampons par session)
+#define LISTEN_SLOTS 16          // Réceptions toujours postées sur le socket global
+
+// Opérations io_uring, codées dans les 8 bits de poids fort du user_data
+enum {
+    OP_LISTEN = 1,   // Requête reçue sur le socket global (indice du slot de réception)
+    OP_CACHE,        // Événements inotify du cache disponibles
+    OP_CANCEL,       // Annulation de la réception d'une session fermée
+    OP_RECV,         // Paquet reçu sur le socket de session
+    OP_READ,         // RRQ : lecture de la fenêtre dans le fichier
+    OP_SEND_DATA,    // RRQ : envoi d'un bloc DATA
+    OP_WRITE,        // WRQ : écriture des blocs reçus depuis le dernier ACK
+    OP_SEND_ACK,     // WRQ : envoi d'un ACK
+    OP_MCAST,        // Paquets ou réveil en attente sur les groupes multicast
+    OP_COMMIT        // WRQ : validations de fichiers reçus terminées
+};
+
+// Répertoire de base pour les transferts
+#define TFTP_DIR "/var/lib/tftpboot/"
+
+// ----------------------- Structure de session -----------------------
+
+typedef enum {
+    ST_UNUSED = 0,   // Session libre
+    ST_RRQ,          // Envoi de fichier vers le client (lecture côté client)
+    ST_WRQ,          // Réception de fichier depuis le client (écriture côté serveur)
+    ST_CLOSING       // Fermée, en attente des opérations io_uring encore en cours
+} session_state;
+
+// Envoi d'un bloc DATA par io_uring : en-tête et charge utile
+typedef struct {
+    struct msghdr msg;
+    struct iovec iov[2];
+    char hdr[4];
+} uring_tx;
+
+// Tampons d'une session servie par io_uring, alloués une fois les options négociées
+typedef struct {
+    char *rx_buf;                  // Réception du socket de session
+    int rx_size;
+    char *data;                    // RRQ : fenêtre lue ; WRQ : blocs en attente d'écriture
+    char ack[4];                   // WRQ : dernier ACK envoyé
+    uring_tx tx[];                 // RRQ : un envoi par bloc de la fenêtre
+} uring_io;
+
+typedef struct {
+    session_state state;           // État de la session (lecture ou écriture)
+    struct sockaddr_in client_addr; // Adresse du client associé à la session
+    FILE *fp;                      // RRQ : fichier servi
+    file_map map;                  // RRQ : fichier projeté en mémoire
+    file_map view;                 // RRQ : plage servie de la projection (tout le fichier sans offset)
+    int mapped;                    // RRQ : les DATA partent de la projection (sinon fread)
+    cache_entry *cached;           // RRQ : entrée du cache dont map est une vue (NULL sinon)
+    write_pipe *pipe;              // WRQ : fichier reçu, écrit en différé puis renommé
+    lock_entry *lock;              // Verrou du fichier : partagé (RRQ) ou exclusif (WRQ)
+    long long block_num;           // RRQ : dernier bloc envoyé ; WRQ : dernier bloc reçu dans l'ordre
+    long long acked;               // RRQ : dernier bloc acquitté (-1 tant que l'OACK ne l'est pas)
+    long long last_block;          // Numéro du dernier bloc, le seul de moins de blksize octets
+                                   // (WRQ : 0 tant qu'il n'est pas reçu)
+    long long file_size;           // RRQ : taille de la plage servie (le fichier sans option offset)
+    long long range_start;         // RRQ : position du premier octet servi dans le fichier
+    int blksize;                   // Taille de bloc négociée (512 par défaut)
+    int windowsize;                // Blocs envoyés avant d'attendre un ACK (RFC 7440)
+    int window_count;              // WRQ : blocs reçus depuis le dernier ACK envoyé
+    long long ooo_block;           // WRQ : dernier bloc hors séquence reçu (-1 si aucun)
+    tftp_options opts;             // Options acceptées (pour renvoyer l'OACK)
+    int has_oack;                  // Le transfert a commencé par un OACK
+    rtt_estimator rtt;             // Délai de retransmission adaptatif
+    long long sent_us;             // Envoi du dernier paquet attendant une réponse
+    int retransmitted;             // Le dernier envoi est une retransmission (règle de Karn)
+    long long highest_sent;        // RRQ : plus grand bloc déjà envoyé
+    int committing;                // WRQ : fichier reçu, écriture finale et renommage en cours
+    int done;                      // WRQ : fichier en place, en attente d'un dernier bloc renvoyé
+    long long start_us;            // Réception de la requête (métriques de latence)
+    int retries;                   // Nombre de retransmissions effectuées
+    int sockfd_session;            // Socket dédiée à cette session
+    unsigned int gen;              // Génération du slot, pour ignorer les événements périmés
+    int hash_next;                 // Session suivante dans le même seau (-1 en fin de chaîne)
+    int free_next;                 // Slot libre suivant (-1 en fin de liste)
+    timer_node timer;              // Échéance de retransmission ou de fin, dans la roue
+    uring_io *io;                  // Tampons io_uring (NULL avec epoll)
+    int inflight;                  // Opérations io_uring en cours sur la session
+    int busy;                      // Lecture, envois DATA ou écriture en cours
+    int window_wanted;             // RRQ : fenêtre à renvoyer dès la fin des envois en cours
+    long long io_len;              // Octets de la lecture en cours (RRQ) ou en attente d'écriture (WRQ)
+    long long write_off;           // WRQ : position d'écriture dans le fichier
+    size_t reserved;               // Tampons du transfert réservés dans le budget des sessions
+} tftp_session;
+
+// Réserve des sessions, allouée par slabs (SessionPool) et agrandie à la demande
+// dans la limite du budget. Les sessions sont désignées par leur indice.
+static slab_pool pool;
+static int active_sessions;
+static int free_slot = -1;       // Tête de la liste des slots libres
+static int *hash_buckets;        // Seaux indexés par l'adresse du client
+static int bucket_count;         // Nombre de seaux, puissance de 2 au moins égale à pool.capacity
+static admission_queue admission;  // Requêtes en attente d'une session libre
+static timer_wheel wheel;        // Échéances des sessions
+static int epfd;                 // Instance epoll de la boucle principale
+static packet_batch rx_batch;    // Paquets reçus par recvmmsg sur un socket
+static packet_batch tx_batch;    // Paquets DATA d'une fenêtre, envoyés par sendmmsg
+static int use_gso;              // Option -g : fenêtres envoyées par segmentation UDP (GSO)
+static int use_uring;            // Option -u : moteur io_uring au lieu d'epoll
+static uring ring;               // Anneau io_uring du moteur -u
+static int sockfd;  // Socket globale pour l'initialisation
+static long long mcast_next = -1;  // Prochaine échéance des groupes multicast (-1 si aucune)
+
+static inline tftp_session *session_at(int idx) {
+    return pool_at(&pool, idx);
+}
+
+// ----------------------- Fonctions d'envoi utilisant le socket de session -----------------------
+
+void send_ack_session(int session_sockfd, long long block_num, int rollover) {
+    unsigned int wire = block_to_wire(block_num, rollover);
+    char ack[TFTP_HEADER_SIZE];
+    int len = encode_ack(ack, wire);
+    send(session_sockfd, ack, len, 0);
+    log_packet("[INFO] ACK envoyé - Bloc %lld\n", block_num);
+}
+
+void send_error_session(int session_sockfd, int error_code, const char *msg) {
+    char buffer[PACKET_SIZE];
+    int len = encode_error(buffer, sizeof(buffer), error_code, msg);
+    send(session_sockfd, buffer, len, 0);
+    metrics_error_sent(error_code);
+    log_info("[INFO] ERROR envoyé : %s\n", msg);
+}
+
+// Erreur en réponse à une requête reçue sur le socket global, qui n'est pas connecté
+void send_error_to(const struct sockaddr_in *client_addr, int error_code, const char *msg) {
+    char buffer[PACKET_SIZE];
+    int len = encode_error(buffer, sizeof(buffer), error_code, msg);
+    sendto(sockfd, buffer, len, 0, (const struct sockaddr*)client_addr, sizeof(*client_addr));
+    metrics_error_sent(error_code);
+    log_info("[INFO] ERROR envoyé : %s\n", msg);
+}
+
+void send_oack_session(int session_sockfd, const tftp_options *opts) {
+    char oack[PACKET_SIZE];
+    int len = build_oack(oack, sizeof(oack), opts);
+    send(session_sockfd, oack, len, 0);
+    log_debug("[INFO] OACK envoyé - blksize %d, windowsize %d\n", opts->blksize, opts->windowsize);
+}
+
+// ----------------------- Gestion des sessions -----------------------
+
+static unsigned int addr_hash(const struct sockaddr_in *addr) {
+    unsigned int h = addr->sin_addr.s_addr * 2654435761u ^ addr->sin_port;
+    h ^= h >> 16;
+    h *= 0x45d9f3bu;
+    h ^= h >> 16;
+    return h & (bucket_count - 1);
+}
+
+// Ajoute un slab de sessions. Les seaux doublent d'abord si la réserve agrandie
+// les dépasse, et sont alors redistribués.
+int grow_sessions(void) {
+    int capacity = pool.capacity + POOL_SLAB_OBJECTS;
+    if (capacity > bucket_count) {
+        int new_count = bucket_count ? bucket_count * 2 : capacity;
+        int *new_buckets = malloc(new_count * sizeof(*new_buckets));
+        if (!new_buckets)
+            return -1;
+        free(hash_buckets);
+        hash_buckets = new_buckets;
+        bucket_count = new_count;
+        for (int i = 0; i < bucket_count; i++)
+            hash_buckets[i] = -1;
+        for (int i = 0; i < pool.capacity; i++) {
+            if (session_at(i)->state == ST_RRQ || session_at(i)->state == ST_WRQ) {
+                unsigned int h = addr_hash(&session_at(i)->client_addr);
+                session_at(i)->hash_next = hash_buckets[h];
+                hash_buckets[h] = i;
+            }
+        }
+    }
+    int first = pool_grow(&pool);
+    if (first < 0)
+        return -1;
+    // Les nouveaux slots rejoignent la liste des slots libres
+    for (int i = pool.capacity - 1; i >= first; i--) {
+        memset(session_at(i), 0, sizeof(*session_at(i)));
+        session_at(i)->state = ST_UNUSED;
+        session_at(i)->sockfd_session = -1;
+        timer_node_init(&session_at(i)->timer, i);
+        session_at(i)->free_next = free_slot;
+        free_slot = i;
+    }
+    return 0;
+}
+
+int find_session_slot(struct sockaddr_in *addr) {
+    for (int i = hash_buckets[addr_hash(addr)]; i >= 0; i = session_at(i)->hash_next) {
+        if (session_at(i)->client_addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+            session_at(i)->client_addr.sin_port == addr->sin_port)
+            return i;
+    }
+    return -1; // Aucune session existante pour ce client
+}
+
+void hash_remove(int idx) {
+    int *link = &hash_buckets[addr_hash(&session_at(idx)->client_addr)];
+    while (*link != idx)
+        link = &session_at(*link)->hash_next;
+    *link = session_at(idx)->hash_next;
+}
+
+// Rend le slot à la liste libre ; sa génération change pour invalider les événements en attente
+void release_slot(int idx) {
+    active_sessions--;
+    session_at(idx)->state = ST_UNUSED;
+    session_at(idx)->gen++;
+    session_at(idx)->free_next = free_slot;
+    free_slot = idx;
+}
+
+int create_session(struct sockaddr_in *addr, session_state st) {
+    if (free_slot < 0 && grow_sessions() < 0) {
+        perror("[ERROR] Agrandissement de la table des sessions");
+        return -1;
+    }
+    int i = free_slot;
+    free_slot = session_at(i)->free_next;
+    active_sessions++;
+    session_at(i)->state = st;
+    session_at(i)->client_addr = *addr;
+    session_at(i)->fp = NULL;
+    session_at(i)->mapped = 0;
+    session_at(i)->cached = NULL;
+    session_at(i)->pipe = NULL;
+    session_at(i)->lock = NULL;
+    session_at(i)->block_num = 0;
+    session_at(i)->acked = 0;
+    session_at(i)->last_block = 0;
+    session_at(i)->file_size = 0;
+    session_at(i)->range_start = 0;
+    session_at(i)->blksize = DATA_SIZE;
+    session_at(i)->windowsize = DEFAULT_WINDOWSIZE;
+    session_at(i)->window_count = 0;
+    session_at(i)->ooo_block = -1;
+    memset(&session_at(i)->opts, 0, sizeof(session_at(i)->opts));
+    session_at(i)->has_oack = 0;
+    rtt_init(&session_at(i)->rtt, 0);
+    session_at(i)->sent_us = 0;
+    session_at(i)->retransmitted = 0;
+    session_at(i)->highest_sent = 0;
+    session_at(i)->committing = 0;
+    session_at(i)->done = 0;
+    session_at(i)->start_us = rtt_now_us();
+    session_at(i)->retries = 0;
+    session_at(i)->io = NULL;
+    session_at(i)->inflight = 0;
+    session_at(i)->busy = 0;
+    session_at(i)->window_wanted = 0;
+    session_at(i)->io_len = 0;
+    session_at(i)->write_off = 0;
+    session_at(i)->reserved = 0;
+    // Création d'un socket dédié pour la session, non bloquant pour epoll en mode front
+    // (io_uring attend lui-même que le socket soit prêt)
+    session_at(i)->sockfd_session = socket(AF_INET, SOCK_DGRAM | (use_uring ? 0 : SOCK_NONBLOCK), 0);
+    if (session_at(i)->sockfd_session < 0) {
+        perror("socket");
+        release_slot(i);
+        return -1;
+    }
+    // Bind sur une adresse locale avec port éphémère (0)
+    struct sockaddr_in local_addr;
+    memset(&local_addr, 0, sizeof(local_addr));
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_addr.s_addr = INADDR_ANY;
+    local_addr.sin_port = htons(0); // port éphémère
+    if (bind(session_at(i)->sockfd_session, (struct sockaddr*)&local_addr, sizeof(local_addr)) < 0) {
+        perror("bind");
+        close(session_at(i)->sockfd_session);
+        release_slot(i);
+        return -1;
+    }
+    // Connecte le socket à l'adresse du client
+    if (connect(session_at(i)->sockfd_session, (struct sockaddr*)addr, sizeof(*addr)) < 0) {
+        perror("connect");
+        close(session_at(i)->sockfd_session);
+        release_slot(i);
+        return -1;
+    }
+    // L'événement porte l'indice et la génération du slot ; avec io_uring,
+    // la réception est postée une fois les options négociées
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.u64 = ((uint64_t)session_at(i)->gen << 32) | (unsigned int)i;
+    if (!use_uring && epoll_ctl(epfd, EPOLL_CTL_ADD, session_at(i)->sockfd_session, &ev) < 0) {
+        perror("epoll_ctl");
+        close(session_at(i)->sockfd_session);
+        release_slot(i);
+        return -1;
+    }
+    unsigned int h = addr_hash(addr);
+    session_at(i)->hash_next = hash_buckets[h];
+    hash_buckets[h] = i;
+    metrics_inc(MET_SESSIONS_ACTIVE);
+    return i;
+}
+
+// ----------------------- Échéances de retransmission -----------------------
+
+// Fixe l'échéance de la session, en remplaçant la précédente
+void set_deadline(int idx, long long deadline_us) {
+    timer_schedule(&wheel, &session_at(idx)->timer, deadline_us);
+}
+
+void cancel_deadline(int idx) {
+    timer_cancel(&wheel, &session_at(idx)->timer);
+}
+
+// Libère les ressources de la session et rend son slot
+void free_session(int idx) {
+    if (session_at(idx)->fp) {
+        fclose(session_at(idx)->fp);
+        session_at(idx)->fp = NULL;
+    }
+    if (session_at(idx)->cached) {
+        file_cache_release(session_at(idx)->cached);
+        session_at(idx)->cached = NULL;
+    } else if (session_at(idx)->mapped) {
+        file_map_close(&session_at(idx)->map);
+    }
+    session_at(idx)->mapped = 0;
+    if (session_at(idx)->pipe) {
+        // Réception inachevée : le fichier temporaire est abandonné par un
+        // thread d'écriture, sans attendre ici la fin d'un pwritev en cours
+        write_pipe_abort(session_at(idx)->pipe);
+        session_at(idx)->pipe = NULL;
+    }
+    if (session_at(idx)->lock) {
+        lock_table_release(session_at(idx)->lock);
+        session_at(idx)->lock = NULL;
+    }
+    // La fermeture du socket le retire aussi de l'instance epoll
+    if (session_at(idx)->sockfd_session > 0) {
+        close(session_at(idx)->sockfd_session);
+        session_at(idx)->sockfd_session = -1;
+    }
+    if (session_at(idx)->io) {
+        free(session_at(idx)->io->rx_buf);
+        free(session_at(idx)->io->data);
+        free(session_at(idx)->io);
+        session_at(idx)->io = NULL;
+    }
+    pool_unreserve(&pool, session_at(idx)->reserved);
+    session_at(idx)->reserved = 0;
+    release_slot(idx);
+    metrics_add(MET_SESSIONS_ACTIVE, -1);
+    log_info("[INFO] Session %d fermée.\n", idx);
+}
+
+static unsigned long long uring_data(int op, int idx);
+
+void close_session(int idx) {
+    cancel_deadline(idx);
+    hash_remove(idx);
+    if (session_at(idx)->inflight > 0) {
+        // Des opérations io_uring utilisent encore les tampons, le fichier et le
+        // socket : la session est libérée à la dernière complétion
+        session_at(idx)->state = ST_CLOSING;
+        uring_prep_cancel(&ring, uring_data(OP_RECV, idx), uring_data(OP_CANCEL, idx));
+        return;
+    }
+    free_session(idx);
+}
+
+// Arme l'échéance de retransmission après l'envoi d'un paquet attendant une réponse
+void arm_timer(int idx, int retransmitted) {
+    session_at(idx)->sent_us = rtt_now_us();
+    session_at(idx)->retransmitted = retransmitted;
+    set_deadline(idx, session_at(idx)->sent_us + session_at(idx)->rtt.rto_us);
+}
+
+void retransmit(int idx);
+
+// Traite les échéances expirées et renvoie la plus proche des suivantes (-1 si aucune) :
+// une session terminée est fermée ; sinon le dernier envoi est renvoyé avec un
+// délai doublé, jusqu'à épuisement des tentatives (rtt_gave_up)
+long long check_timeouts() {
+    long long now = rtt_now_us();
+    timer_node *node;
+    while ((node = timer_expired(&wheel, now))) {
+        int i = node->owner;
+        if (session_at(i)->done) {
+            close_session(i);
+            continue;
+        }
+        rtt_timeout(&session_at(i)->rtt);
+        if (rtt_gave_up(&session_at(i)->rtt, now)) {
+            log_warn("[WARN] Timeout session %d\n", i);
+            metrics_inc(MET_TIMEOUTS);
+            close_session(i);
+            continue;
+        }
+        // La retransmission réarme l'échéance de la session
+        retransmit(i);
+    }
+    return timer_next(&wheel);
+}
+
+// ----------------------- Soumissions io_uring -----------------------
+
+// user_data d'une opération : code (8 bits), génération du slot (24 bits) et indice
+static unsigned long long uring_data(int op, int idx) {
+    return ((unsigned long long)op << 56) |
+           ((unsigned long long)(session_at(idx)->gen & 0xFFFFFF) << 32) | (unsigned int)idx;
+}
+
+// Poste la réception du prochain paquet sur le socket de session
+static void uring_post_recv(int idx) {
+    uring_io *io = session_at(idx)->io;
+    if (uring_prep_recv(&ring, session_at(idx)->sockfd_session, io->rx_buf, io->rx_size,
+                        uring_data(OP_RECV, idx)))
+        session_at(idx)->inflight++;
+}
+
+// Alloue les tampons de la session une fois les options négociées, puis poste
+// sa première réception. Renvoie -1 si la mémoire manque.
+int uring_start_session(int idx) {
+    tftp_session *s = session_at(idx);
+    int rrq = s->state == ST_RRQ;
+    uring_io *io = calloc(1, sizeof(*io) + (rrq ? s->windowsize * sizeof(uring_tx) : 0));
+    if (!io)
+        return -1;
+    s->io = io;
+    // Un RRQ ne reçoit que des ACK et ERROR ; un WRQ reçoit des DATA complets
+    io->rx_size = rrq ? PACKET_SIZE : s->blksize + 4;
+    io->rx_buf = malloc(io->rx_size);
+    // Fenêtre lue dans le fichier, sauf si elle part directement du cache
+    if (!rrq || !s->cached)
+        io->data = malloc((size_t)s->windowsize * s->blksize);
+    if (!io->rx_buf || (!io->data && (!rrq || !s->cached)))
+        return -1;
+    uring_post_recv(idx);
+    return 0;
+}
+
+// Soumet la fenêtre [first, end] : lecture dans le fichier (sauf fichier en cache)
+// suivie des envois DATA, liés pour ne partir qu'une fois les données lues
+void uring_queue_window(int idx, long long first, long long end) {
+    tftp_session *s = session_at(idx);
+    uring_io *io = s->io;
+    int count = end - first + 1;
+    long long offset = (long long)(first - 1) * s->blksize;
+    long long remaining = s->file_size - offset;
+    const char *data = s->mapped ? s->view.data + offset : io->data;
+    uring_reserve(&ring, count + 1);
+    if (!s->mapped && remaining > 0) {
+        long long len = remaining < (long long)count * s->blksize ? remaining : (long long)count * s->blksize;
+        s->io_len = len;
+        struct io_uring_sqe *sqe = uring_prep_read(&ring, fileno(s->fp), io->data, len, s->range_start + offset,
+                                                   uring_data(OP_READ, idx));
+        sqe->flags |= IOSQE_IO_LINK;
+        s->inflight++;
+        s->busy++;
+    }
+    for (int k = 0; k < count; k++) {
+        long long block_num = first + k;
+        unsigned int wire = block_to_wire(block_num, s->opts.rollover);
+        long long left = remaining - (long long)k * s->blksize;
+        size_t len = left <= 0 ? 0 : left < s->blksize ? (size_t)left : (size_t)s->blksize;
+        uring_tx *tx = &io->tx[k];
+        encode_data_header(tx->hdr, wire);
+        tx->iov[0].iov_base = tx->hdr;
+        tx->iov[0].iov_len = 4;
+        tx->iov[1].iov_base = (char *)data + (size_t)k * s->blksize;
+        tx->iov[1].iov_len = len;
+        memset(&tx->msg, 0, sizeof(tx->msg));
+        tx->msg.msg_iov = tx->iov;
+        tx->msg.msg_iovlen = 2;
+        struct io_uring_sqe *sqe = uring_prep_sendmsg(&ring, s->sockfd_session, &tx->msg,
+                                                      uring_data(OP_SEND_DATA, idx));
+        // Une lecture en tête de chaîne : les envois restent liés pour garder leur ordre
+        if (!s->mapped && k < count - 1)
+            sqe->flags |= IOSQE_IO_LINK;
+        s->inflight++;
+        s->busy++;
+        metrics_inc(MET_BLOCKS_SENT);
+        metrics_add(MET_BYTES_SENT, len);
+        log_packet("[INFO] DATA envoyé - Bloc %lld (%zu octets)\n", block_num, len);
+    }
+}
+
+// Soumet l'écriture des blocs reçus depuis l'ACK précédent, s'il y en a.
+// Avec link, l'opération soumise ensuite ne part qu'une fois l'écriture faite.
+void uring_write(int idx, int link) {
+    tftp_session *s = session_at(idx);
+    if (s->io_len == 0)
+        return;
+    struct io_uring_sqe *sqe = uring_prep_write(&ring, write_pipe_fd(s->pipe), s->io->data, s->io_len,
+                                                s->write_off, uring_data(OP_WRITE, idx));
+    if (link)
+        sqe->flags |= IOSQE_IO_LINK;
+    s->inflight++;
+    s->busy++;
+}
+
+// Acquitte le bloc : les blocs reçus depuis l'ACK précédent sont d'abord écrits,
+// et l'ACK, lié à l'écriture, ne part qu'une fois les données sur le fichier
+void uring_ack(int idx, long long block_num) {
+    tftp_session *s = session_at(idx);
+    // Écriture en cours : l'ACK qui lui est lié couvre déjà ce bloc
+    if (s->busy)
+        return;
+    uring_io *io = s->io;
+    encode_ack(io->ack, block_to_wire(block_num, s->opts.rollover));
+    uring_reserve(&ring, 2);
+    uring_write(idx, 1);
+    uring_prep_send(&ring, s->sockfd_session, io->ack, sizeof(io->ack), uring_data(OP_SEND_ACK, idx));
+    s->inflight++;
+    log_packet("[INFO] ACK envoyé - Bloc %lld\n", block_num);
+}
+
+// ----------------------- Handlers pour les transferts -----------------------
+
+// Mémoire des tampons d'un transfert : avec io_uring, réception et fenêtre
+// (sauf RRQ d'un fichier en cache) ; pour un WRQ, tampons d'écriture du
+// fichier reçu, selon sa taille si le client l'annonce (tsize)
+static size_t transfer_cost(int rrq, int cached, int blksize, int windowsize, long long tsize) {
+    size_t cost = 0;
+    if (use_uring) {
+        if (rrq)
+            cost = PACKET_SIZE + windowsize * sizeof(uring_tx) + (cached ? 0 : (size_t)windowsize * blksize);
+        else
+            cost = blksize + 4 + (size_t)windowsize * blksize;
+    }
+    if (!rrq) {
+        long long buffers = tsize > 0 ? (tsize + WRITE_PIPE_BUFFER - 1) / WRITE_PIPE_BUFFER : WRITE_PIPE_BUFFERS;
+        if (buffers > WRITE_PIPE_BUFFERS)
+            buffers = WRITE_PIPE_BUFFERS;
+        cost += (size_t)buffers * WRITE_PIPE_BUFFER;
+    }
+    return cost;
+}
+
+// Porte la réservation de la session (celle d'une fenêtre d'un bloc, faite à
+// l'admission) au coût du transfert négocié. Quand le budget ne le permet pas,
+// la fenêtre est réduite plutôt que la requête refusée.
+static void reserve_session(int idx, tftp_options *opts) {
+    tftp_session *s = session_at(idx);
+    long long tsize = (opts->present & OPT_TSIZE) ? opts->tsize : 0;
+    while (1) {
+        size_t cost = transfer_cost(s->state == ST_RRQ, s->cached != NULL, s->blksize, s->windowsize, tsize);
+        if (cost <= s->reserved) {
+            pool_unreserve(&pool, s->reserved - cost);
+            s->reserved = cost;
+            break;
+        }
+        if (pool_reserve(&pool, cost - s->reserved) == 0) {
+            s->reserved = cost;
+            break;
+        }
+        if (s->windowsize == 1)
+            break;
+        s->windowsize = (s->windowsize + 1) / 2;
+    }
+    if ((opts->present & OPT_WINDOWSIZE) && s->windowsize < opts->windowsize) {
+        log_warn("[WARN] Session %d : fenêtre réduite de %d à %d blocs (budget mémoire)\n",
+                 idx, opts->windowsize, s->windowsize);
+        opts->windowsize = s->windowsize;
+    }
+}
+
+// Retient les options acceptées pour la session.
+// Renvoie 1 si un OACK doit être envoyé au client.
+int negotiate_session(int idx, tftp_options *opts) {
+    int has_options = 0;
+    if (opts->present & OPT_BLKSIZE) {
+        opts->blksize = negotiate_blksize(opts->blksize, &session_at(idx)->client_addr);
+        session_at(idx)->blksize = opts->blksize;
+        has_options = 1;
+    }
+    if (opts->present & OPT_WINDOWSIZE) {
+        // Avec io_uring, chaque bloc de la fenêtre a son tampon : l'OACK annonce la fenêtre réduite
+        if (use_uring && opts->windowsize > URING_MAX_WINDOW)
+            opts->windowsize = URING_MAX_WINDOW;
+        session_at(idx)->windowsize = opts->windowsize;
+        has_options = 1;
+    }
+    // tsize : taille du fichier servi (RRQ) ou annoncée par le client et renvoyée (WRQ) ;
+    // rollover : renvoyé tel quel, opts->rollover (0 par défaut) fixe la numérotation ;
+    // offset et length : plage retenue (RRQ)
+    if (opts->present & (OPT_TIMEOUT | OPT_TSIZE | OPT_ROLLOVER | OPT_OFFSET))
+        has_options = 1;
+    reserve_session(idx, opts);
+    // L'option timeout plafonne le délai de retransmission
+    rtt_init(&session_at(idx)->rtt, (opts->present & OPT_TIMEOUT) ? opts->timeout : 0);
+    session_at(idx)->opts = *opts;
+    session_at(idx)->has_oack = has_options;
+    return has_options;
+}
+
+// Envoie les DATA en attente dans le lot : un sendmsg segmenté par groupe de
+// blocs pleins avec -g, sinon sendmmsg
+void flush_window(int idx) {
+    if (use_gso)
+        batch_send_gso(&tx_batch, session_at(idx)->sockfd_session, session_at(idx)->blksize + 4);
+    else
+        batch_send(&tx_batch, session_at(idx)->sockfd_session);
+}
+
+// Ajoute un bloc DATA de la session au lot d'envoi
+void send_data_block(int idx, long long block_num) {
+    unsigned int wire = block_to_wire(block_num, session_at(idx)->opts.rollover);
+    char *buffer = batch_next(&tx_batch);
+    if (!buffer) {
+        flush_window(idx);
+        buffer = batch_next(&tx_batch);
+    }
+    encode_data_header(buffer, wire);
+    int n;
+    if (session_at(idx)->mapped) {
+        // Seul l'en-tête est construit : la charge utile part de la projection
+        size_t len;
+        const char *data = file_map_block(&session_at(idx)->view, block_num, session_at(idx)->blksize, &len);
+        batch_commit_payload(&tx_batch, 4, data, len, NULL);
+        n = len;
+    } else {
+        long long offset = (block_num - 1) * session_at(idx)->blksize;
+        long long left = session_at(idx)->file_size - offset;
+        // Une retransmission repart du dernier bloc acquitté : on se repositionne
+        if (ftell(session_at(idx)->fp) != session_at(idx)->range_start + offset)
+            fseek(session_at(idx)->fp, session_at(idx)->range_start + offset, SEEK_SET);
+        // Le dernier bloc d'une plage s'arrête à sa fin, pas à celle du fichier
+        n = left <= 0 ? 0 : fread(buffer + 4, 1, left < session_at(idx)->blksize ? left : session_at(idx)->blksize,
+                                  session_at(idx)->fp);
+        batch_commit(&tx_batch, n + 4, NULL);
+    }
+    metrics_inc(MET_BLOCKS_SENT);
+    metrics_add(MET_BYTES_SENT, n);
+    log_packet("[INFO] DATA envoyé - Bloc %lld (%d octets)\n", block_num, n);
+}
+
+// Envoie la fenêtre qui suit le dernier bloc acquitté
+void send_window(int idx) {
+    long long block_num = session_at(idx)->acked + 1;
+    long long end = session_at(idx)->acked + session_at(idx)->windowsize;
+    if (end > session_at(idx)->last_block)
+        end = session_at(idx)->last_block;
+    // Une fenêtre qui renvoie un bloc déjà parti ne donne pas de mesure de RTT fiable
+    int retransmitted = block_num <= session_at(idx)->highest_sent;
+    if (block_num == 1 && session_at(idx)->highest_sent < 1)
+        metrics_observe(HIST_FIRST_DATA, rtt_now_us() - session_at(idx)->start_us);
+    if (use_uring) {
+        if (session_at(idx)->busy) {
+            // Les tampons servent encore à la fenêtre précédente : celle-ci partira
+            // à la fin de ses envois
+            session_at(idx)->window_wanted = 1;
+            set_deadline(idx, rtt_now_us() + session_at(idx)->rtt.rto_us);
+            return;
+        }
+        uring_queue_window(idx, block_num, end);
+    } else {
+        for (; block_num <= end; block_num++)
+            send_data_block(idx, block_num);
+        // Toute la fenêtre part en un minimum d'appels système
+        flush_window(idx);
+    }
+    session_at(idx)->block_num = end;
+    if (end > session_at(idx)->highest_sent)
+        session_at(idx)->highest_sent = end;
+    arm_timer(idx, retransmitted);
+}
+
+// Échéance expirée : renvoi de l'OACK, de la fenêtre (RRQ) ou du dernier ACK (WRQ)
+void ack_block(int idx, long long block_num);
+
+void retransmit(int idx) {
+    session_at(idx)->retries++;
+    metrics_inc(MET_RETRANSMITS);
+    log_debug("[WARN] Session %d: retransmission %d (délai %ld ms)\n",
+              idx, session_at(idx)->retries, session_at(idx)->rtt.rto_us / 1000);
+    if (session_at(idx)->state == ST_RRQ) {
+        if (session_at(idx)->acked < 0) {
+            send_oack_session(session_at(idx)->sockfd_session, &session_at(idx)->opts);
+            arm_timer(idx, 1);
+        } else {
+            send_window(idx);
+        }
+    } else {
+        if (session_at(idx)->block_num == 0 && session_at(idx)->has_oack)
+            send_oack_session(session_at(idx)->sockfd_session, &session_at(idx)->opts);
+        else
+            ack_block(idx, session_at(idx)->block_num);
+        session_at(idx)->window_count = 0;
+        arm_timer(idx, 1);
+    }
+}
+
+// Verrouille le fichier de la session, sans attendre : la boucle ne se bloque jamais.
+// Renvoie -1 (session fermée) si un transfert incompatible est en cours.
+int lock_session_file(int idx, const char *filename, lock_mode mode) {
+    session_at(idx)->lock = lock_table_acquire(filename, mode, 0);
+    if (session_at(idx)->lock)
+        return 0;
+    log_error("[ERROR] Transfert du fichier %s refusé : déjà en cours (autre client).\n", filename);
+    send_error_session(session_at(idx)->sockfd_session, 0, "Erreur: un transfert de fichier est déjà en cours");
+    close_session(idx);
+    return -1;
+}
+
+// Noms cachés : réservés aux fichiers temporaires des réceptions en cours
+int refuse_hidden(int idx, const char *filename) {
+    if (!write_pipe_hidden(filename))
+        return 0;
+    log_error("[ERROR] Accès refusé au fichier caché %s.\n", filename);
+    send_error_session(session_at(idx)->sockfd_session, 2, "Accès refusé");
+    close_session(idx);
+    return -1;
+}
+
+void handle_rrq(int idx, const char *filename, tftp_options *opts) {
+    session_at(idx)->state = ST_RRQ;
+    if (refuse_hidden(idx, filename) < 0)
+        return;
+    if (lock_session_file(idx, filename, LOCK_SHARED) < 0)
+        return;
+    // Fichier déjà en mémoire : ni ouverture ni lecture disque
+    session_at(idx)->cached = file_cache_acquire(filename);
+    if (session_at(idx)->cached) {
+        session_at(idx)->map = *file_cache_map(session_at(idx)->cached);
+        session_at(idx)->mapped = 1;
+    } else {
+        char filepath[1024];
+        snprintf(filepath, sizeof(filepath), "%s%s", TFTP_DIR, filename);
+        FILE *fp = fopen(filepath, "rb");
+        if (!fp) {
+            perror("[ERROR] Fichier introuvable");
+            send_error_session(session_at(idx)->sockfd_session, 1, "Fichier introuvable");
+            close_session(idx);
+            return;
+        }
+        session_at(idx)->fp = fp;
+        // Projection du fichier une fois pour toute la session ; à défaut, lecture par stdio.
+        // Avec io_uring, le fichier est lu par l'anneau plutôt que par défauts de page.
+        session_at(idx)->mapped = !use_uring && file_map_open(&session_at(idx)->map, fileno(fp)) == 0;
+    }
+    long file_size;
+    if (session_at(idx)->mapped) {
+        file_size = session_at(idx)->map.size;
+    } else {
+        fseek(session_at(idx)->fp, 0, SEEK_END);
+        file_size = ftell(session_at(idx)->fp);
+        rewind(session_at(idx)->fp);
+    }
+    // Avec l'option offset, seule une plage du fichier est servie ; tsize reste
+    // la taille du fichier entier, pour que le client découpe les suivantes
+    long long range_start, range_len;
+    if (request_range(opts, file_size, &range_start, &range_len) < 0) {
+        log_error("[ERROR] Plage demandée hors du fichier %s (offset %lld).\n", filename, opts->offset);
+        send_error_session(session_at(idx)->sockfd_session, 8, "Plage hors du fichier");
+        close_session(idx);
+        return;
+    }
+    session_at(idx)->range_start = range_start;
+    session_at(idx)->file_size = range_len;
+    if (session_at(idx)->mapped)
+        session_at(idx)->view = file_map_slice(&session_at(idx)->map, range_start, range_len);
+    opts->tsize = file_size;
+    int oack = negotiate_session(idx, opts);
+    // Le dernier bloc est le premier à contenir moins de blksize octets (éventuellement 0)
+    session_at(idx)->last_block = range_len / session_at(idx)->blksize + 1;
+    if (use_uring && uring_start_session(idx) < 0) {
+        perror("[ERROR] Allocation des tampons de session");
+        close_session(idx);
+        return;
+    }
+    if (oack) {
+        // La première fenêtre part à la réception de l'ACK(0) de l'OACK
+        session_at(idx)->block_num = 0;
+        session_at(idx)->acked = -1;
+        send_oack_session(session_at(idx)->sockfd_session, opts);
+        arm_timer(idx, 0);
+        return;
+    }
+
+    // Envoi immédiat de la première fenêtre
+    session_at(idx)->acked = 0;
+    send_window(idx);
+}
+
+void handle_wrq(int idx, const char *filename, tftp_options *opts) {
+    if (refuse_hidden(idx, filename) < 0)
+        return;
+    if (lock_session_file(idx, filename, LOCK_EXCLUSIVE) < 0)
+        return;
+    char filepath[1024];
+    snprintf(filepath, sizeof(filepath), "%s%s", TFTP_DIR, filename);
+    // Réception dans un fichier temporaire renommé à la fin : un RRQ en cours
+    // sur l'ancien contenu (projeté en mémoire) n'est jamais tronqué. Avec tsize,
+    // l'espace est réservé d'avance et un fichier trop gros refusé tout de suite.
+    session_at(idx)->pipe = write_pipe_open(filepath, (opts->present & OPT_TSIZE) ? opts->tsize : 0);
+    if (!session_at(idx)->pipe) {
+        if (errno == ENOSPC) {
+            log_error("[ERROR] Espace disque insuffisant pour %s (%lld octets).\n", filename, opts->tsize);
+            send_error_session(session_at(idx)->sockfd_session, 3, "Disque plein ou dépassement de capacité");
+            close_session(idx);
+            return;
+        }
+        perror("[ERROR] Impossible de créer le fichier");
+        close_session(idx);
+        return;
+    }
+    session_at(idx)->block_num = 0;  // On attend le bloc 1
+    session_at(idx)->state = ST_WRQ;
+    opts->present &= ~(OPT_OFFSET | OPT_LENGTH | OPT_MULTICAST);  // RRQ seulement
+    int oack = negotiate_session(idx, opts);
+    if (use_uring && uring_start_session(idx) < 0) {
+        perror("[ERROR] Allocation des tampons de session");
+        close_session(idx);
+        return;
+    }
+    // L'OACK tient lieu d'ACK(0) lorsque des options sont acceptées
+    if (oack)
+        send_oack_session(session_at(idx)->sockfd_session, opts);
+    else
+        ack_block(idx, 0);
+    arm_timer(idx, 0);
+}
+
+void complete_wrq(int idx);
+
+// Range un bloc reçu dans l'ordre : copie dans les tampons d'écriture différée,
+// ou ajout aux blocs que io_uring écrira avant l'ACK. Renvoie -1 si le bloc
+// n'est pas pris (la session est fermée si l'écriture a échoué).
+int store_block(int idx, const char *data, int len) {
+    if (!use_uring) {
+        // Tampons pleins en attente du disque : le bloc n'est pas acquitté, le
+        // client le renverra, mais la boucle ne se bloque jamais sur une écriture
+        int ret = write_pipe_append(session_at(idx)->pipe, data, len, 0);
+        if (ret < 0) {
+            perror("[ERROR] Écriture du fichier reçu");
+            send_error_session(session_at(idx)->sockfd_session, 3, "Disque plein ou erreur d'écriture");
+            close_session(idx);
+        }
+        return ret == 0 ? 0 : -1;
+    }
+    // Écriture précédente en cours, ou tampon plein : le client renverra le bloc
+    if (session_at(idx)->busy ||
+        session_at(idx)->io_len + len > (long long)session_at(idx)->windowsize * session_at(idx)->blksize)
+        return -1;
+    memcpy(session_at(idx)->io->data + session_at(idx)->io_len, data, len);
+    session_at(idx)->io_len += len;
+    return 0;
+}
+
+void ack_block(int idx, long long block_num) {
+    if (use_uring)
+        uring_ack(idx, block_num);
+    else
+        send_ack_session(session_at(idx)->sockfd_session, block_num, session_at(idx)->opts.rollover);
+}
+
+// Fin de la validation du fichier reçu : err vaut 0 si le fichier a pris son
+// nom, sinon l'errno de l'échec (la session est alors fermée). L'ACK final part
+// maintenant ; la session reste ouverte le temps de réacquitter un dernier bloc
+// renvoyé si cet ACK se perd.
+void finish_wrq(int idx, int err) {
+    session_at(idx)->committing = 0;
+    if (err) {
+        errno = err;
+        perror("[ERROR] Écriture du fichier reçu");
+        send_error_session(session_at(idx)->sockfd_session, 3, "Disque plein ou erreur d'écriture");
+        close_session(idx);
+        return;
+    }
+    log_info("[INFO] Fin WRQ session %d\n", idx);
+    metrics_observe(HIST_TRANSFER, rtt_now_us() - session_at(idx)->start_us);
+    session_at(idx)->done = 1;
+    ack_block(idx, session_at(idx)->block_num);
+    set_deadline(idx, rtt_now_us() + RTT_DALLY_FACTOR * session_at(idx)->rtt.rto_us);
+}
+
+// Fichier complet : les dernières données sont écrites et le fichier prend son
+// nom dans un thread d'écriture, sans bloquer la boucle. La session attend la
+// fin (process_commits) sans échéance : le client renvoie son dernier bloc
+// tant qu'il n'a pas l'ACK final.
+void complete_wrq(int idx) {
+    tftp_session *s = session_at(idx);
+    cancel_deadline(idx);
+    s->committing = 1;
+    int ret = write_pipe_commit(s->pipe, ((unsigned long long)s->gen << 32) | (unsigned int)idx);
+    s->pipe = NULL;
+    if (ret <= 0)
+        finish_wrq(idx, ret < 0 ? errno : 0);
+}
+
+// Relève les validations terminées par les threads d'écriture. Celle d'une
+// session fermée entre-temps (slot libéré ou réutilisé) est ignorée.
+void process_commits(void) {
+    unsigned long long owner;
+    int err;
+    while (write_pipe_completed(&owner, &err)) {
+        int idx = (int)(owner & 0xFFFFFFFF);
+        unsigned int gen = (unsigned int)(owner >> 32);
+        if (idx < pool.capacity && session_at(idx)->gen == gen && session_at(idx)->committing)
+            finish_wrq(idx, err);
+    }
+}
+
+void handle_data(int idx, char *buffer, int n) {
+    if (n < 4) return;
+    unsigned int wire = packet_block(buffer);
+    long long block_num = block_from_wire(wire, session_at(idx)->block_num, session_at(idx)->opts.rollover);
+    if (session_at(idx)->done) {
+        // Le client n'a pas reçu le dernier ACK et renvoie sa fenêtre
+        ack_block(idx, session_at(idx)->block_num);
+        return;
+    }
+    // Validation en cours : l'ACK final partira à sa fin
+    if (session_at(idx)->committing)
+        return;
+    if (block_num == session_at(idx)->block_num + 1) {
+        int data_len = n - 4;
+        if (store_block(idx, buffer + 4, data_len) < 0)
+            return;
+        session_at(idx)->block_num = block_num;
+        session_at(idx)->ooo_block = -1;
+        session_at(idx)->retries = 0;
+        metrics_inc(MET_BLOCKS_RECEIVED);
+        metrics_add(MET_BYTES_RECEIVED, data_len);
+        if (block_num == 1)
+            metrics_observe(HIST_FIRST_DATA, rtt_now_us() - session_at(idx)->start_us);
+        // Seul le premier bloc qui suit un ACK mesure le RTT
+        metrics_observe(HIST_RTT, rtt_progress(&session_at(idx)->rtt, session_at(idx)->sent_us,
+                                               session_at(idx)->retransmitted || session_at(idx)->window_count > 0));
+        set_deadline(idx, rtt_now_us() + session_at(idx)->rtt.rto_us);
+        // Un seul ACK par fenêtre : après windowsize blocs ou sur le dernier bloc
+        if (data_len < session_at(idx)->blksize) {
+            session_at(idx)->last_block = block_num;
+            // Le dernier ACK ne part qu'une fois le fichier en place ; avec io_uring,
+            // la validation attend la complétion de la dernière écriture
+            if (use_uring && session_at(idx)->io_len > 0) {
+                uring_reserve(&ring, 1);
+                uring_write(idx, 0);
+            } else {
+                complete_wrq(idx);
+            }
+        } else if (++session_at(idx)->window_count >= session_at(idx)->windowsize) {
+            ack_block(idx, block_num);
+            session_at(idx)->window_count = 0;
+            arm_timer(idx, 0);
+        }
+    } else {
+        // Bloc en double ou perte dans la fenêtre : on acquitte le dernier bloc reçu
+        // dans l'ordre pour que le client reprenne à partir de là. Une fenêtre
+        // retransmise arrive en ordre croissant : un seul ACK par passage suffit.
+        if (block_num > session_at(idx)->block_num)
+            log_packet("[WARN] Session %d: bloc inattendu %lld (attendu %lld)\n",
+                       idx, block_num, session_at(idx)->block_num + 1);
+        if (session_at(idx)->ooo_block < 0 || block_num <= session_at(idx)->ooo_block) {
+            ack_block(idx, session_at(idx)->block_num);
+            session_at(idx)->window_count = 0;
+            arm_timer(idx, 1);
+        }
+        session_at(idx)->ooo_block = block_num;
+    }
+}
+
+void handle_ack(int idx, char *buffer, int n) {
+    if (n < 4) return;
+    unsigned int wire = packet_block(buffer);
+    long long ref = session_at(idx)->acked < 0 ? 0 : session_at(idx)->acked;
+    long long block_num = block_from_wire(wire, ref, session_at(idx)->opts.rollover);
+    if (block_num > session_at(idx)->acked && block_num <= session_at(idx)->block_num) {
+        metrics_observe(HIST_RTT, rtt_progress(&session_at(idx)->rtt, session_at(idx)->sent_us,
+                                               session_at(idx)->retransmitted));
+        session_at(idx)->acked = block_num;
+        session_at(idx)->retries = 0;
+        if (block_num == session_at(idx)->last_block) {
+            log_info("[INFO] Fin RRQ session %d\n", idx);
+            metrics_observe(HIST_TRANSFER, rtt_now_us() - session_at(idx)->start_us);
+            close_session(idx);
+        } else {
+            // Un ACK partiel signale une perte : la fenêtre repart du bloc suivant
+            send_window(idx);
+        }
+    } else if (block_num <= session_at(idx)->acked) {
+        log_packet("[WARN] ACK en double pour bloc %lld (session %d)\n", block_num, idx);
+    } else {
+        log_packet("[WARN] ACK inattendu bloc %lld (session %d, current %lld)\n",
+                   block_num, idx, session_at(idx)->block_num);
+    }
+}
+
+// Paquet reçu sur le socket d'une session
+void handle_session_packet(int i, char *buffer, int n) {
+    if (n < 2)
+        return;
+    switch (packet_opcode(buffer, n)) {
+        case DATA:
+            if (session_at(i)->state == ST_WRQ)
+                handle_data(i, buffer, n);
+            else
+                send_error_session(session_at(i)->sockfd_session, 4, "Session inexistante (DATA)");
+            break;
+        case ACK:
+            if (session_at(i)->state == ST_RRQ)
+                handle_ack(i, buffer, n);
+            else
+                send_error_session(session_at(i)->sockfd_session, 4, "Session inexistante (ACK)");
+            break;
+        case ERROR:
+            log_error("[ERROR] Paquet ERROR reçu du client.\n");
+            metrics_inc(MET_ERRORS_RECEIVED);
+            close_session(i);
+            break;
+        default:
+            send_error_session(session_at(i)->sockfd_session, 4, "Opération non supportée");
+            break;
+    }
+}
+
+// Refus d'une requête en surcharge : le client peut la renvoyer plus tard
+void reject_request(const struct sockaddr_in *client_addr) {
+    metrics_inc(MET_REQUESTS_REJECTED);
+    send_error_to(client_addr, 0, "Serveur surchargé, réessayez plus tard");
+    log_warn("[WARN] Surcharge : requête de %s:%d refusée.\n",
+             inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port));
+}
+
+// Admission d'une requête : il faut un descripteur, un slot (la réserve peut
+// grandir) et la mémoire d'un transfert à fenêtre d'un bloc, réservée dans
+// *reserved. Renvoie -1 si les ressources manquent, -2 si le transfert demande
+// plus de la moitié du budget : en file, il bloquerait les suivants.
+static int admit_request(int opcode, const tftp_options *opts, size_t *reserved) {
+    int blksize = (opts->present & OPT_BLKSIZE) ? opts->blksize : DATA_SIZE;
+    long long tsize = (opts->present & OPT_TSIZE) ? opts->tsize : 0;
+    *reserved = transfer_cost(opcode == RRQ, 0, blksize, 1, tsize);
+    if (*reserved > pool.budget / 2)
+        return -2;
+    if (active_sessions >= pool.limit || (free_slot < 0 && grow_sessions() < 0))
+        return -1;
+    return pool_reserve(&pool, *reserved);
+}
+
+// Requête reçue sur le socket global, ou reprise de la file d'admission
+// (queued). Faute de ressources, une nouvelle requête est mise en file, et
+// une requête reprise y garde son rang : renvoie alors 1.
+int handle_request(char *buffer, int n, struct sockaddr_in *client_addr, int queued) {
+    if (n < 2)
+        return 0;
+    int opcode = packet_opcode(buffer, n);
+    const char *filename;
+    tftp_mode mode;
+    tftp_options opts;
+    if (opcode != RRQ && opcode != WRQ) {
+        send_error_to(client_addr, 4, "Opération non supportée");
+        return 0;
+    }
+    if (parse_request(buffer, n, &opcode, &filename, &mode, &opts) < 0) {
+        send_error_to(client_addr, 4, "Requête mal formée");
+        return 0;
+    }
+    if (opcode == RRQ)
+        log_info("[INFO] RRQ reçu - Demande de lecture de fichier : %s\n", filename);
+    else
+        log_info("[INFO] WRQ reçu - Demande d'écriture de fichier : %s\n", filename);
+    if (find_session_slot(client_addr) >= 0) {
+        log_warn("[WARN] Session existante pour ce client.\n");
+        return 0;
+    }
+    // Un seul flux pour tous les clients du même fichier ; à défaut de
+    // groupe, le client est servi en unicast et l'option ignorée
+    if (opcode == RRQ && (opts.present & OPT_MULTICAST) && mcast_join(client_addr, filename, &opts) == 0) {
+        metrics_inc(MET_RRQ);
+        return 0;
+    }
+    opts.present &= ~OPT_MULTICAST;
+    // Les requêtes en attente passent avant les nouvelles
+    size_t reserved;
+    int admitted = !queued && admission.count > 0 ? -1 : admit_request(opcode, &opts, &reserved);
+    if (admitted == -2) {
+        reject_request(client_addr);
+        return 0;
+    }
+    if (admitted < 0) {
+        if (queued)
+            return 1;
+        int ret = admission_push(&admission, client_addr, buffer, n);
+        if (ret < 0) {
+            reject_request(client_addr);
+        } else if (ret > 0) {
+            log_warn("[WARN] Requête en double de %s:%d ignorée.\n",
+                     inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port));
+        } else {
+            metrics_inc(MET_REQUESTS_QUEUED);
+            metrics_inc(MET_REQUESTS_WAITING);
+        }
+        return 0;
+    }
+    int idx = create_session(client_addr, opcode == RRQ ? ST_RRQ : ST_WRQ);
+    if (idx < 0) {
+        pool_unreserve(&pool, reserved);
+        reject_request(client_addr);
+        return 0;
+    }
+    session_at(idx)->reserved = reserved;
+    if (opcode == RRQ) {
+        metrics_inc(MET_RRQ);
+        handle_rrq(idx, filename, &opts);
+    } else {
+        metrics_inc(MET_WRQ);
+        handle_wrq(idx, filename, &opts);
+    }
+    return 0;
+}
+
+// Reprend les requêtes en attente, dans l'ordre, tant que les ressources le
+// permettent ; celles qui ont trop attendu sont refusées
+void admit_pending(void) {
+    pending_request *p;
+    long long now = rtt_now_us();
+    while ((p = admission_peek(&admission))) {
+        if (admission_expired(&admission, p, now))
+            reject_request(&p->addr);
+        else if (handle_request(p->buf, p->len, &p->addr, 1) > 0)
+            break;
+        admission_pop(&admission);
+        metrics_add(MET_REQUESTS_WAITING, -1);
+    }
+}
+
+// Rapport périodique sur le cache de fichiers, s'il a servi depuis le précédent
+void report_cache_stats(void) {
+    static long long next_report_us;
+    static unsigned long last_requests;
+    long long now = rtt_now_us();
+    if (now < next_report_us)
+        return;
+    next_report_us = now + STATS_INTERVAL_SEC * 1000000LL;
+    file_cache_stats st;
+    file_cache_get_stats(&st);
+    if (st.hits + st.misses == last_requests)
+        return;
+    last_requests = st.hits + st.misses;
+    log_info("[STATS] Cache : %lu succès, %lu échecs, %d fichiers (%zu Ko), "
+             "%lu évictions, %lu invalidations\n",
+             st.hits, st.misses, st.entries, st.bytes / 1024, st.evictions, st.invalidations);
+    lock_table_stats locks;
+    lock_table_get_stats(&locks);
+    log_info("[STATS] Verrous : %d tenus, %lu pris, %lu en conflit, %lu refusés\n",
+             locks.held, locks.acquired, locks.contended, locks.refused);
+}
+
+// Groupes multicast : traités quand leur descripteur est prêt ou leur échéance passée
+void process_multicast(int ready) {
+    if (ready || (mcast_next >= 0 && rtt_now_us() >= mcast_next))
+        mcast_next = mcast_process();
+}
+
+// Plus proche des échéances des sessions, des groupes multicast et de la
+// requête la plus ancienne en attente d'admission (-1 si aucune)
+static long long next_deadline(void) {
+    long long deadline = check_timeouts();
+    if (mcast_next >= 0 && (deadline < 0 || mcast_next < deadline))
+        deadline = mcast_next;
+    pending_request *p = admission_peek(&admission);
+    if (p && (deadline < 0 || p->queued_us + admission.max_wait_us < deadline))
+        deadline = p->queued_us + admission.max_wait_us;
+    return deadline;
+}
+
+// ----------------------- Complétions io_uring -----------------------
+
+// Réceptions postées sur le socket global
+static struct {
+    struct msghdr msg;
+    struct iovec iov;
+    struct sockaddr_in addr;
+    char buf[PACKET_SIZE];
+} listen_slots[LISTEN_SLOTS];
+
+static void uring_post_listen(int k) {
+    memset(&listen_slots[k].msg, 0, sizeof(listen_slots[k].msg));
+    listen_slots[k].iov.iov_base = listen_slots[k].buf;
+    listen_slots[k].iov.iov_len = sizeof(listen_slots[k].buf);
+    listen_slots[k].msg.msg_name = &listen_slots[k].addr;
+    listen_slots[k].msg.msg_namelen = sizeof(listen_slots[k].addr);
+    listen_slots[k].msg.msg_iov = &listen_slots[k].iov;
+    listen_slots[k].msg.msg_iovlen = 1;
+    uring_prep_recvmsg(&ring, sockfd, &listen_slots[k].msg, ((unsigned long long)OP_LISTEN << 56) | k);
+}
+
+static void uring_post_cache_poll(void) {
+    uring_prep_poll(&ring, file_cache_fd(), POLLIN, (unsigned long long)OP_CACHE << 56);
+}
+
+static void uring_post_commit_poll(void) {
+    uring_prep_poll(&ring, write_pipe_event_fd(), POLLIN, (unsigned long long)OP_COMMIT << 56);
+}
+
+static void uring_post_mcast_poll(void) {
+    uring_prep_poll(&ring, mcast_fd(), POLLIN, (unsigned long long)OP_MCAST << 56);
+}
+
+// Fait avancer la session selon l'opération terminée
+void uring_complete(int op, int idx, int res) {
+    tftp_session *s = session_at(idx);
+    s->inflight--;
+    if (s->state == ST_CLOSING) {
+        if (s->inflight == 0)
+            free_session(idx);
+        return;
+    }
+    switch (op) {
+        case OP_RECV:
+            if (res > 0)
+                handle_session_packet(idx, s->io->rx_buf, res);
+            // Une erreur (ICMP port inaccessible) n'interrompt pas la réception
+            if (s->state == ST_RRQ || s->state == ST_WRQ)
+                uring_post_recv(idx);
+            break;
+        case OP_READ:
+            s->busy--;
+            // Lecture courte ou en erreur : les envois liés sont annulés par le noyau
+            if (res != s->io_len) {
+                if (res < 0) {
+                    errno = -res;
+                    perror("[ERROR] Lecture du fichier");
+                }
+                send_error_session(s->sockfd_session, 0, "Erreur de lecture");
+                close_session(idx);
+            }
+            break;
+        case OP_SEND_DATA:
+            // Un envoi échoué ou annulé compte comme une perte : l'ACK partiel la rattrapera
+            if (--s->busy == 0 && s->window_wanted) {
+                s->window_wanted = 0;
+                send_window(idx);
+            }
+            break;
+        case OP_WRITE:
+            s->busy--;
+            if (res != s->io_len) {
+                if (res < 0) {
+                    errno = -res;
+                    perror("[ERROR] Écriture du fichier");
+                }
+                send_error_session(s->sockfd_session, 3, "Disque plein ou erreur d'écriture");
+                close_session(idx);
+                break;
+            }
+            s->write_off += res;
+            s->io_len = 0;
+            if (s->last_block && s->block_num == s->last_block && !s->committing && !s->done)
+                complete_wrq(idx);
+            break;
+        case OP_SEND_ACK:
+            break;
+    }
+}
+
+// Moteur io_uring : réceptions, lectures, écritures et envois sont soumis à
+// l'anneau, et les sessions avancent au fil des complétions, traitées par lots
+void uring_loop(void) {
+    int listen_done[LISTEN_SLOTS], listen_len[LISTEN_SLOTS];
+    while (1) {
+        long long deadline = next_deadline();
+        long long wait_us = -1;
+        if (deadline >= 0) {
+            wait_us = deadline - rtt_now_us();
+            if (wait_us < 0)
+                wait_us = 0;
+        }
+        if (uring_submit_and_wait(&ring, wait_us) < 0) {
+            perror("io_uring_enter");
+            break;
+        }
+        // Les complétions des sessions passent avant les nouvelles requêtes :
+        // le dernier ACK d'un transfert libère la session de ce client
+        int nlisten = 0, mcast_ready = 0;
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek_cqe(&ring))) {
+            unsigned long long data = cqe->user_data;
+            int res = cqe->res;
+            uring_cqe_seen(&ring);
+            int op = (int)(data >> 56);
+            int idx = (int)(data & 0xFFFFFFFF);
+            unsigned int gen = (unsigned int)(data >> 32) & 0xFFFFFF;
+            if (op == OP_LISTEN) {
+                if (res > 0) {
+                    listen_done[nlisten] = idx;
+                    listen_len[nlisten++] = res;
+                } else {
+                    uring_post_listen(idx);
+                }
+            } else if (op == OP_CACHE) {
+                file_cache_process_events(0);
+                uring_post_cache_poll();
+            } else if (op == OP_COMMIT) {
+                process_commits();
+                uring_post_commit_poll();
+            } else if (op == OP_MCAST) {
+                mcast_ready = 1;
+            } else if (op != OP_CANCEL && idx < pool.capacity &&
+                       (session_at(idx)->gen & 0xFFFFFF) == gen) {
+                uring_complete(op, idx, res);
+            }
+        }
+        // Les sessions libérées servent d'abord les requêtes en attente
+        admit_pending();
+        for (int k = 0; k < nlisten; k++) {
+            int slot = listen_done[k];
+            handle_request(listen_slots[slot].buf, listen_len[k], &listen_slots[slot].addr, 0);
+            uring_post_listen(slot);
+        }
+        process_multicast(mcast_ready);
+        if (mcast_ready)
+            uring_post_mcast_poll();
+        report_cache_stats();
+    }
+}
+
+// ----------------------- Boucle principale -----------------------
+
+// Moteur epoll : sockets en mode front, vidés par recvmmsg à chaque événement
+void epoll_loop(void) {
+    epfd = epoll_create1(0);
+    if (epfd < 0) {
+        perror("[ERROR] epoll_create1");
+        return;
+    }
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.u64 = LISTEN_EVENT;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &ev) < 0) {
+        perror("[ERROR] epoll_ctl");
+        return;
+    }
+    if (file_cache_fd() >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.u64 = CACHE_EVENT;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, file_cache_fd(), &ev);
+    }
+    if (write_pipe_event_fd() >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.u64 = COMMIT_EVENT;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, write_pipe_event_fd(), &ev);
+    }
+    if (mcast_fd() >= 0) {
+        ev.events = EPOLLIN;
+        ev.data.u64 = MCAST_EVENT;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, mcast_fd(), &ev);
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        // Retransmissions échues, puis attente jusqu'à la prochaine échéance
+        long long deadline = next_deadline();
+        int timeout_ms = -1;
+        if (deadline >= 0) {
+            long long wait_us = deadline - rtt_now_us();
+            // Arrondi supérieur : se réveiller avant l'échéance ferait tourner la boucle à vide
+            timeout_ms = wait_us > 0 ? (int)((wait_us + 999) / 1000) : 0;
+        }
+        int nev = epoll_wait(epfd, events, MAX_EVENTS, timeout_ms);
+        if (nev < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("epoll_wait");
+            break;
+        }
+        // Traitement des paquets sur les sockets de session, avant les nouvelles
+        // requêtes : le dernier ACK d'un transfert libère la session de ce client
+        int listen_ready = 0, mcast_ready = 0;
+        for (int e = 0; e < nev; e++) {
+            if (events[e].data.u64 == LISTEN_EVENT) {
+                listen_ready = 1;
+                continue;
+            }
+            if (events[e].data.u64 == CACHE_EVENT) {
+                file_cache_process_events(0);
+                continue;
+            }
+            if (events[e].data.u64 == COMMIT_EVENT) {
+                process_commits();
+                continue;
+            }
+            if (events[e].data.u64 == MCAST_EVENT) {
+                mcast_ready = 1;
+                continue;
+            }
+            int i = (int)(events[e].data.u64 & 0xFFFFFFFF);
+            unsigned int gen = (unsigned int)(events[e].data.u64 >> 32);
+            // Mode front : le socket est vidé jusqu'à EAGAIN, sauf si la session se ferme
+            while (session_at(i)->state != ST_UNUSED && session_at(i)->gen == gen) {
+                int nrecv = batch_recv(&rx_batch, session_at(i)->sockfd_session, MSG_DONTWAIT);
+                if (nrecv <= 0)
+                    break;
+                for (int k = 0; k < nrecv; k++) {
+                    if (session_at(i)->state == ST_UNUSED || session_at(i)->gen != gen)
+                        break;
+                    handle_session_packet(i, batch_slot(&rx_batch, k), batch_len(&rx_batch, k));
+                }
+            }
+        }
+        // Les sessions libérées servent d'abord les requêtes en attente,
+        // puis les nouvelles requêtes du socket global, par lots
+        admit_pending();
+        int nrecv;
+        while (listen_ready && (nrecv = batch_recv(&rx_batch, sockfd, MSG_DONTWAIT)) > 0) {
+            for (int k = 0; k < nrecv; k++)
+                handle_request(batch_slot(&rx_batch, k), batch_len(&rx_batch, k), &rx_batch.addrs[k], 0);
+        }
+        process_multicast(mcast_ready);
+        report_cache_stats();
+    }
+
+    close(epfd);
+}
+
+// Crée l'anneau et poste les réceptions du socket global et l'attente du cache
+int uring_setup(void) {
+    if (uring_init(&ring, URING_ENTRIES) < 0)
+        return -1;
+    for (int k = 0; k < LISTEN_SLOTS; k++)
+        uring_post_listen(k);
+    if (file_cache_fd() >= 0)
+        uring_post_cache_poll();
+    if (write_pipe_event_fd() >= 0)
+        uring_post_commit_poll();
+    if (mcast_fd() >= 0)
+        uring_post_mcast_poll();
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-c cache_Mo] [-s sessions_Mo] [-g] [-u] [-l error|warn|info|debug|packet] "
+            "[-m socket_stats] [-M premier_groupe_multicast] [-P processus [-b]]\n"
+            "  -s : budget mémoire des sessions ; au-delà, les requêtes attendent ou sont refusées\n"
+            "  -P : un processus par CPU (0) ou n processus, sous un superviseur\n"
+            "  -b : requêtes réparties selon le CPU qui les reçoit (BPF)\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    struct sockaddr_in server_addr;
+    long cache_mb = DEFAULT_CACHE_MB;
+    long sessions_mb = POOL_DEFAULT_MB;
+    int level = LOG_INFO;
+    const char *metrics_path = METRICS_DEFAULT_PATH;
+    const char *mcast_group = MCAST_DEFAULT_GROUP;
+    int processes = -1, steer_cpu = 0, worker = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:s:gul:m:M:P:b")) != -1) {
+        switch (opt) {
+            case 'c': cache_mb = atol(optarg); break;
+            case 's': sessions_mb = atol(optarg); break;
+            case 'g': use_gso = 1; break;
+            case 'u': use_uring = 1; break;
+            case 'l': level = log_level_parse(optarg); break;
+            case 'm': metrics_path = optarg; break;
+            case 'M': mcast_group = optarg; break;
+            case 'P': processes = atoi(optarg); break;
+            case 'b': steer_cpu = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (cache_mb < 0 || sessions_mb <= 0 || level < 0 || (steer_cpu && processes < 0))
+        usage(argv[0]);
+    // Fichiers temporaires des réceptions interrompues par un arrêt du serveur :
+    // supprimés avant le lancement des workers, jamais à leur relance
+    log_level = level;
+    int cleaned = write_pipe_cleanup(TFTP_DIR);
+    if (cleaned > 0)
+        log_warn("[WARN] %d fichier(s) temporaire(s) de réceptions interrompues supprimé(s).\n", cleaned);
+    if (processes >= 0) {
+        // Le superviseur ne revient que dans les workers ; il écrit ses messages
+        // directement, sans le thread du journal que fork ne recopierait pas
+        log_level = level;
+        sockfd = supervisor_run(processes, 6969, LISTEN_RCVBUF, steer_cpu, metrics_path, &worker);
+        if (sockfd < 0) {
+            perror("[ERROR] Lancement des workers");
+            exit(EXIT_FAILURE);
+        }
+        // Chaque worker a son cache, et ses groupes multicast sur un port à lui
+        cache_mb /= supervisor_workers();
+        sessions_mb = (sessions_mb + supervisor_workers() - 1) / supervisor_workers();
+    }
+    if (log_init(level) < 0)
+        perror("[WARN] Journal asynchrone indisponible");
+    if (worker < 0 && metrics_init(metrics_path) < 0)
+        perror("[WARN] Socket de statistiques indisponible");
+
+    if (worker < 0) {
+        // Création du socket global pour l'initialisation
+        sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sockfd < 0) {
+            perror("[ERROR] Échec de la création du socket.");
+            exit(EXIT_FAILURE);
+        }
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(6969);
+        server_addr.sin_addr.s_addr = INADDR_ANY;
+        if (bind(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+            perror("[ERROR] Échec du bind.");
+            exit(EXIT_FAILURE);
+        }
+        // Tampon de réception élargi pour absorber une rafale de requêtes simultanées
+        int rcvbuf = LISTEN_RCVBUF;
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    log_info("[STARTING] Serveur TFTP multi‑clients modifié avec sockets par session sur le port 6969...\n");
+
+    // Chaque session consomme des descripteurs : on relève la limite au maximum
+    // autorisé, qui fixe le nombre de sessions simultanées
+    struct rlimit rl;
+    int max_sessions = POOL_SLAB_OBJECTS;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        if (rl.rlim_cur < rl.rlim_max) {
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &rl);
+            getrlimit(RLIMIT_NOFILE, &rl);
+        }
+        long long fds = rl.rlim_cur == RLIM_INFINITY || rl.rlim_cur > INT_MAX ? INT_MAX : (long long)rl.rlim_cur;
+        if (fds > POOL_RESERVED_FDS + POOL_FDS_PER_SESSION)
+            max_sessions = (fds - POOL_RESERVED_FDS) / POOL_FDS_PER_SESSION;
+    }
+    pool_init(&pool, sizeof(tftp_session), max_sessions, (size_t)sessions_mb << 20);
+    timer_wheel_init(&wheel, rtt_now_us());
+    log_info("[INFO] Sessions : %d au plus, budget mémoire %ld Mo\n", max_sessions, sessions_mb);
+
+    // Initialisation de la réserve des sessions, de la file d'admission et des
+    // lots de paquets (un emplacement de lot contient un DATA au blksize maximal)
+    if (grow_sessions() < 0 ||
+        admission_init(&admission, ADMISSION_QUEUE_SIZE, ADMISSION_WAIT_MS) < 0 ||
+        batch_alloc(&rx_batch, BATCH_MAX, MAX_PACKET_SIZE) < 0 ||
+        batch_alloc(&tx_batch, BATCH_MAX, MAX_PACKET_SIZE) < 0) {
+        perror("[ERROR] Allocation de la table des sessions");
+        exit(EXIT_FAILURE);
+    }
+    // Cache des fichiers servis, invalidé par les événements inotify de la boucle
+    if (cache_mb > 0 && file_cache_init(TFTP_DIR, (size_t)cache_mb << 20) < 0)
+        perror("[WARN] Cache de fichiers désactivé (inotify)");
+    // Groupes multicast (RFC 2090) pour les clients qui demandent l'option
+    if (mcast_init(TFTP_DIR, mcast_group, MCAST_DEFAULT_PORT + (worker < 0 ? 0 : worker)) < 0)
+        perror("[WARN] Multicast désactivé");
+    if (use_uring && uring_setup() < 0) {
+        perror("[WARN] io_uring indisponible, retour à epoll");
+        use_uring = 0;
+    }
+    if (use_uring) {
+        if (use_gso)
+            log_warn("[WARN] -g sans effet avec -u\n");
+        uring_loop();
+    } else {
+        epoll_loop();
+    }
+
+    // Fermeture de toutes les sessions et du socket global avant de quitter
+    for (int i = 0; i < pool.capacity; i++) {
+        if (session_at(i)->state == ST_RRQ || session_at(i)->state == ST_WRQ)
+            close_session(i);
+    }
+    close(sockfd);
+    log_flush();
+    return 0;
 }
\ No newline at end of file
@@ -1,324 +1,921 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <arpa/inet.h>
-#include <pthread.h>
-#include <sys/time.h>
-
-#define DATA_SIZE 512               // Taille des données à envoyer dans chaque paquet (512 octets pour les données TFTP)
-#define PACKET_SIZE (DATA_SIZE + 4) // Taille totale d'un paquet, incluant les 4 octets d'en-tête TFTP (pour opcode et bloc)
-#define RRQ 1
-#define WRQ 2
-#define DATA 3
-#define ACK 4
-#define ERROR 5
-
-#define TFTP_DIR "/var/lib/tftpboot/"  // Répertoire où les fichiers seront sauvegardés ou reçus
-
-// Mutex pour gérer l'accès au fichier de manière sécurisée (empêche plusieurs accès simultanés)
-pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-// Structure pour stocker les informations d'une requête client
-typedef struct {
-    int sockfd;                  // Socket du client
-    struct sockaddr_in client_addr; // Adresse du client
-    char filename[256];           // Nom du fichier demandé
-    int opcode;                   // Type de la requête (RRQ ou WRQ)
-} client_request_t;
-
-// Fonction pour envoyer un ACK (accusé de réception) au client
-void send_ack(int sockfd, struct sockaddr_in addr, int block_num) {
-    char ack[4];
-    ack[0] = 0;
-    ack[1] = ACK; // Code de l'ACK
-    ack[2] = (block_num >> 8) & 0xFF; // Numéro de bloc (premiers 8 bits)
-    ack[3] = block_num & 0xFF; // Numéro de bloc (derniers 8 bits)
-    sendto(sockfd, ack, sizeof(ack), 0, (struct sockaddr*)&addr, sizeof(addr));
-    printf("[INFO] Serveur: ACK %d envoyé au client.\n", block_num);
-}
-
-// Fonction pour envoyer un fichier au client
-void send_file(int sockfd, struct sockaddr_in addr, char* filename) {
-    int n, block_num = 1;
-    char buffer[PACKET_SIZE];
-    socklen_t addr_size = sizeof(addr);
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len = sizeof(client_addr);
-    char filepath[1024];
-
-    snprintf(filepath, sizeof(filepath), "%s%s", TFTP_DIR, filename); // Crée le chemin du fichier
-
-    // Ouvrir le fichier en mode lecture
-    FILE* fp = fopen(filepath, "rb");
-    if (fp == NULL) {
-        perror("[ERROR] Fichier introuvable.");
-        return;
-    }
-
-    // Calculer la taille du fichier
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    rewind(fp);
-
-    if (file_size == 0) {
-        printf("[ERROR] Le fichier est vide, envoi annulé.\n");
-        fclose(fp);
-        return;
-    }
-
-    printf("[INFO] Début d'envoi du fichier : %s (%ld octets)\n", filename, file_size);
-
-    // Configurer un timeout pour la réception des ACKs
-    struct timeval timeout;
-    timeout.tv_sec = 2;
-    timeout.tv_usec = 0;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
-
-    while (1) {
-        memset(buffer, 0, PACKET_SIZE); // Nettoyer le buffer
-        buffer[0] = 0; // Initialisation du paquet TFTP
-        buffer[1] = DATA; // Code pour DATA
-        buffer[2] = (block_num >> 8) & 0xFF; // Premier octet du bloc
-        buffer[3] = block_num & 0xFF; // Deuxième octet du bloc
-
-        // Lire le fichier et stocker les données dans le buffer
-        n = fread(buffer + 4, 1, DATA_SIZE, fp);
-        if (n < 0) break;
-
-        // Envoyer le paquet DATA
-        sendto(sockfd, buffer, n + 4, 0, (struct sockaddr*)&addr, addr_size);
-        printf("[INFO] DATA envoyé - Bloc %d (%d octets)\n", block_num, n);
-
-        // Attente de l'ACK du client
-        char ack_buffer[PACKET_SIZE];
-        int ack_received, retries = 0;
-        while (retries < 3) {
-            ack_received = recvfrom(sockfd, ack_buffer, PACKET_SIZE, 0,
-                                    (struct sockaddr*)&client_addr, &client_addr_len);
-            if (ack_received >= 4) {
-                int ack_opcode = (ack_buffer[0] << 8) | ack_buffer[1];
-                int ack_block = (ack_buffer[2] << 8) | ack_buffer[3];
-                if (ack_opcode == ACK && ack_block == block_num) {
-                    printf("[INFO] Serveur: ACK %d reçu de %s:%d\n", block_num,
-                        inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
-                    addr = client_addr; // Mettre à jour l'adresse du client
-                    break;
-                } else {
-                    printf("[ERROR] ACK invalide reçu (opcode: %d, block: %d) pour bloc attendu %d\n",
-                        ack_opcode, ack_block, block_num);
-                }
-            } else {
-                printf("[WARNING] Aucun ACK reçu pour le bloc %d, tentative de renvoi (%d/3).\n", block_num, retries + 1);
-                sendto(sockfd, buffer, n + 4, 0, (struct sockaddr*)&addr, addr_size);
-                retries++;
-            }
-        }
-        if (retries == 3) {
-            printf("[ERROR] Abandon de l'envoi du bloc %d après 3 tentatives.\n", block_num);
-            break;
-        }
-        block_num++;
-        sleep(1);
-        if (n < DATA_SIZE) break; // Fin du fichier si moins de données sont lues
-    }
-    fclose(fp);
-    printf("[INFO] Fin d'envoi du fichier : %s\n", filename);
-    printf("[INFO] Fin de transmission.\n");
-}
-
-// Fonction pour recevoir un fichier du client
-void receive_file(int sockfd, struct sockaddr_in addr, char* filename) {
-    int n, block_num = 0;
-    char buffer[PACKET_SIZE];
-    socklen_t addr_size = sizeof(addr);
-    char filepath[1024], temp_filepath[1024];
-
-    snprintf(filepath, sizeof(filepath), "%s%s", TFTP_DIR, filename);
-    snprintf(temp_filepath, sizeof(temp_filepath), "%s%s.tmp", TFTP_DIR, filename);
-
-    // Verrouiller l'accès au fichier avec mutex pour éviter les écritures simultanées
-    pthread_mutex_lock(&file_mutex);
-    FILE* fp = fopen(temp_filepath, "wb");
-    pthread_mutex_unlock(&file_mutex);
-
-    if (fp == NULL) {
-        perror("[ERROR] Impossible de créer le fichier temporaire.");
-        return;
-    }
-
-    send_ack(sockfd, addr, block_num); // Envoi de l'ACK initial
-    printf("[DEBUG] ACK initial envoyé, attente des blocs DATA...\n");
-
-    while (1) {
-        memset(buffer, 0, PACKET_SIZE); // Nettoyage du buffer
-        n = recvfrom(sockfd, buffer, PACKET_SIZE, 0, (struct sockaddr*)&addr, &addr_size);
-        printf("[DEBUG] Paquet reçu - Taille: %d octets\n", n);
-        if (n < 4) break; // Si le paquet est trop petit, on arrête
-
-        int opcode = (buffer[0] << 8) | buffer[1];
-        if (opcode == DATA) { // Si c'est un paquet DATA
-            block_num = (buffer[2] << 8) | buffer[3];
-            if (n > 4) {
-                size_t written = fwrite(buffer + 4, 1, n - 4, fp);
-                if (written != (size_t)(n - 4)) {
-                    perror("[ERROR] Ecriture du fichier");
-                    break;
-                }
-                printf("[INFO] DATA reçu - Bloc %d (%d octets)\n", block_num, n - 4);
-            } else {
-                printf("[INFO] Bloc %d reçu (fin de transmission, 0 octets)\n", block_num);
-            }
-            send_ack(sockfd, addr, block_num); // Envoi de l'ACK pour confirmer la réception
-            printf("[DEBUG] ACK %d envoyé\n", block_num);
-            if ((n - 4) < DATA_SIZE) break; // Fin de la transmission si le bloc est plus petit que la taille de données
-        }
-        sleep(1);
-    }
-    fclose(fp);
-    // Renommer le fichier temporaire en fichier final
-    if (rename(temp_filepath, filepath) != 0) {
-        perror("[ERROR] Renommage du fichier temporaire");
-    } else {
-        printf("[INFO] Fichier %s reçu correctement.\n", filename);
-    }
-    printf("[INFO] Fin de réception du fichier : %s\n", filename);
-    printf("[INFO] Fin de transmission.\n");
-}
-
-// Fonction pour gérer chaque requête client dans un thread
-void* handle_client_request(void* arg) {
-    client_request_t* request = (client_request_t*) arg;
-    char lock_path[1024];
-    snprintf(lock_path, sizeof(lock_path), "%s%s.lock", TFTP_DIR, request->filename);
-
-    // Information sur le client
-    char client_info[64];
-    snprintf(client_info, sizeof(client_info), "%s:%d",
-             inet_ntoa(request->client_addr.sin_addr),
-             ntohs(request->client_addr.sin_port));
-
-    // Vérification si un transfert de fichier est déjà en cours (lock)
-    if (access(lock_path, F_OK) == 0) {
-        FILE *lock_fp = fopen(lock_path, "r");
-        if (lock_fp) {
-            char stored_info[64];
-            if (fgets(stored_info, sizeof(stored_info), lock_fp) != NULL) {
-                stored_info[strcspn(stored_info, "\n")] = '\0';
-                if (strcmp(stored_info, client_info) != 0) {
-                    fclose(lock_fp);
-                    // Envoi d'un message d'erreur au client
-                    char error_packet[PACKET_SIZE];
-                    const char *error_msg = "Erreur: un transfert de fichier est déjà en cours";
-                    error_packet[0] = 0;
-                    error_packet[1] = ERROR;
-                    error_packet[2] = 0;
-                    error_packet[3] = 0;
-                    strcpy(error_packet + 4, error_msg);
-                    sendto(request->sockfd, error_packet, strlen(error_msg) + 5, 0,
-                           (struct sockaddr*)&request->client_addr, sizeof(request->client_addr));
-                    printf("[ERROR] Transfert du fichier %s refusé : déjà en cours (autre client).\n", request->filename);
-                    free(request);
-                    pthread_exit(NULL);
-                }
-            }
-            fclose(lock_fp);
-        }
-    } else {
-        FILE *lock_fp = fopen(lock_path, "w");
-        if (lock_fp == NULL) {
-            perror("[ERROR] Création du lock file");
-            free(request);
-            pthread_exit(NULL);
-        }
-        fputs(client_info, lock_fp);
-        fclose(lock_fp);
-    }
-
-    // Création d'une socket pour le transfert des données
-    int data_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (data_sockfd < 0) {
-        perror("[ERROR] Création de la socket de transfert");
-        unlink(lock_path);
-        free(request);
-        pthread_exit(NULL);
-    }
-
-    struct sockaddr_in data_addr;
-    memset(&data_addr, 0, sizeof(data_addr));
-    data_addr.sin_family = AF_INET;
-    data_addr.sin_addr.s_addr = INADDR_ANY;
-    data_addr.sin_port = 0;
-    if (bind(data_sockfd, (struct sockaddr*)&data_addr, sizeof(data_addr)) < 0) {
-        perror("[ERROR] Bind sur la socket de transfert");
-        close(data_sockfd);
-        unlink(lock_path);
-        free(request);
-        pthread_exit(NULL);
-    }
-
-    socklen_t addr_len = sizeof(data_addr);
-    if (getsockname(data_sockfd, (struct sockaddr*)&data_addr, &addr_len) == 0) {
-        printf("[INFO] Socket de transfert bindée sur le port %d\n", ntohs(data_addr.sin_port));
-    } else {
-        perror("[ERROR] getsockname");
-    }
-
-    // Traitement de la demande selon l'opcode (lecture ou écriture)
-    if (request->opcode == RRQ) {
-        printf("[THREAD] Lecture du fichier demandée : %s\n", request->filename);
-        send_file(data_sockfd, request->client_addr, request->filename);
-    } else if (request->opcode == WRQ) {
-        printf("[THREAD] Écriture du fichier demandée : %s\n", request->filename);
-        receive_file(data_sockfd, request->client_addr, request->filename);
-    }
-
-    // Fermeture de la socket et nettoyage
-    close(data_sockfd);
-    unlink(lock_path);
-    free(request);
-    pthread_exit(NULL);
-}
-
-// Fonction principale : création du socket serveur et gestion des requêtes clients
-int main() {
-    const int port = 6969;
-    int sockfd;
-    struct sockaddr_in server_addr, client_addr;
-    socklen_t addr_size = sizeof(client_addr);
-    char buffer[PACKET_SIZE];
-
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);  // Créer une socket UDP
-    if (sockfd < 0) {
-        perror("[ERROR] Échec de la création du socket.");
-        exit(1);
-    }
-
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-    if (bind(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("[ERROR] Échec du bind.");
-        exit(1);
-    }
-
-    printf("[STARTING] Serveur TFTP en attente...\n");
-    while (1) {
-        memset(buffer, 0, PACKET_SIZE);  // Nettoyage du buffer
-        recvfrom(sockfd, buffer, PACKET_SIZE, 0, (struct sockaddr*)&client_addr, &addr_size); // Attente d'une requête
-        int opcode = (buffer[0] << 8) | buffer[1];
-        char *filename = buffer + 2;
-        client_request_t* request = malloc(sizeof(client_request_t));
-        if (!request) continue;
-        request->sockfd = sockfd;
-        request->client_addr = client_addr;
-        request->opcode = opcode;
-        strncpy(request->filename, filename, sizeof(request->filename) - 1);
-        pthread_t thread_id;
-        pthread_create(&thread_id, NULL, handle_client_request, request);  // Créer un thread pour gérer la requête
-        pthread_detach(thread_id);  // Détacher le thread pour qu'il se termine proprement
-    }
-    close(sockfd);  // Fermer le socket lorsque le serveur termine
-    return 0;
-}
-
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <sys/time.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "TftpOptions.h"
+#include "TftpPacket.h"
+#include "Rtt.h"
+#include "BatchIo.h"
+#include "FileMap.h"
+#include "FileCache.h"
+#include "WritePipe.h"
+#include "LockTable.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Multicast.h"
+#include "Supervisor.h"
+
+#define DATA_SIZE 512               // Taille des données à envoyer dans chaque paquet (512 octets pour les données TFTP)
+#define PACKET_SIZE (DATA_SIZE + 4) // Taille totale d'un paquet, incluant les 4 octets d'en-tête TFTP (pour opcode et bloc)
+
+#define TFTP_DIR "/var/lib/tftpboot/"  // Répertoire où les fichiers seront sauvegardés ou reçus
+
+#define WORKERS_PER_CPU 4        // Un transfert attend surtout le réseau : plusieurs workers par cœur
+#define DEFAULT_QUEUE_SIZE 1024  // Requêtes en attente d'un worker au-delà desquelles on refuse
+#define STATS_INTERVAL_SEC 10    // Période du rapport sur la file d'attente
+#define LOCK_WAIT_MS 1000        // Attente maximale d'un fichier verrouillé par un autre transfert
+
+static int use_gso;  // Option -g : fenêtres envoyées par segmentation UDP (GSO)
+
+// Structure pour stocker les informations d'une requête client
+typedef struct {
+    int sockfd;                  // Socket du client
+    struct sockaddr_in client_addr; // Adresse du client
+    char filename[256];           // Nom du fichier demandé
+    int opcode;                   // Type de la requête (RRQ ou WRQ)
+    tftp_options opts;            // Options demandées par le client
+    long long queued_us;          // Mise en file, pour mesurer l'attente d'un worker
+    int hash_next;                // Requête suivante du même seau (-1 en fin de chaîne)
+    int free_next;                // Slot libre suivant (-1 en fin de liste)
+} client_request_t;
+
+// Pool de workers alimenté par une file bornée. Les requêtes vivent dans un
+// tableau de slots (file + workers) : une requête en file ou en cours de
+// traitement y reste, indexée par l'adresse du client, ce qui permet d'ignorer
+// les RRQ/WRQ retransmis par un client déjà servi.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    client_request_t *slots;
+    int nslots;
+    int free_slot;                // Tête de la liste des slots libres
+    int *buckets;                 // Seaux indexés par l'adresse du client (nslots seaux)
+    int *ring;                    // File circulaire d'indices de slots
+    int capacity, head, count;
+    // Statistiques
+    unsigned long accepted, rejected, duplicates;
+    int max_depth;
+    long long total_wait_us, max_wait_us;
+    unsigned long dequeued;
+} request_queue_t;
+
+static request_queue_t queue;
+
+// Fonction pour envoyer un ACK (accusé de réception) au client
+void send_ack(int sockfd, struct sockaddr_in addr, long long block_num, int rollover) {
+    unsigned int wire = block_to_wire(block_num, rollover);
+    char ack[TFTP_HEADER_SIZE];
+    int len = encode_ack(ack, wire);
+    sendto(sockfd, ack, len, 0, (struct sockaddr*)&addr, sizeof(addr));
+    log_packet("[INFO] Serveur: ACK %lld envoyé au client.\n", block_num);
+}
+
+// Fonction pour envoyer un OACK (acquittement des options acceptées) au client
+void send_oack(int sockfd, struct sockaddr_in addr, const tftp_options *opts) {
+    char oack[PACKET_SIZE];
+    int len = build_oack(oack, sizeof(oack), opts);
+    sendto(sockfd, oack, len, 0, (struct sockaddr*)&addr, sizeof(addr));
+    log_debug("[INFO] Serveur: OACK envoyé au client (blksize %d, windowsize %d).\n",
+              opts->blksize, opts->windowsize);
+}
+
+// Fonction pour envoyer un message d'erreur au client
+void send_error(int sockfd, struct sockaddr_in addr, int error_code, const char *msg) {
+    char error_packet[PACKET_SIZE];
+    int len = encode_error(error_packet, sizeof(error_packet), error_code, msg);
+    sendto(sockfd, error_packet, len, 0, (struct sockaddr*)&addr, sizeof(addr));
+    metrics_error_sent(error_code);
+    log_info("[INFO] Serveur: ERROR envoyé au client : %s\n", msg);
+}
+
+// Retient les options acceptées : opts contient ensuite les valeurs effectives
+// de la session. Renvoie 1 si un OACK doit précéder le transfert.
+int negotiate_options(struct sockaddr_in addr, tftp_options *opts) {
+    int has_oack = 0;
+    if (opts->present & OPT_BLKSIZE) {
+        opts->blksize = negotiate_blksize(opts->blksize, &addr);
+        has_oack = 1;
+    } else {
+        opts->blksize = DATA_SIZE;
+    }
+    if (opts->present & OPT_WINDOWSIZE)
+        has_oack = 1;
+    else
+        opts->windowsize = DEFAULT_WINDOWSIZE;
+    if (opts->present & OPT_TIMEOUT)
+        has_oack = 1;
+    else
+        opts->timeout = 0;
+    // tsize : taille du fichier servie (RRQ) ou annoncée par le client et renvoyée (WRQ)
+    if (opts->present & OPT_TSIZE)
+        has_oack = 1;
+    // rollover : renvoyé tel quel ; sans l'option, la numérotation repasse à 0
+    if (opts->present & OPT_ROLLOVER)
+        has_oack = 1;
+    else
+        opts->rollover = 0;
+    // offset et length : plage retenue (RRQ)
+    if (opts->present & OPT_OFFSET)
+        has_oack = 1;
+    return has_oack;
+}
+
+// Envoie les DATA en attente dans le lot : un sendmsg segmenté par groupe de
+// blocs pleins avec -g, sinon sendmmsg
+void flush_blocks(int sockfd, packet_batch *batch, int blksize) {
+    if (use_gso)
+        batch_send_gso(batch, sockfd, blksize + 4);
+    else
+        batch_send(batch, sockfd);
+}
+
+// Fonction pour envoyer les blocs DATA first à last, par lots de paquets (un appel
+// à sendmmsg par lot). Les données partent de la projection map si elle existe,
+// sinon elles sont relues depuis le fichier. Le bloc 1 commence à l'octet start
+// du fichier et la plage servie fait size octets.
+void send_blocks(int sockfd, struct sockaddr_in addr, FILE *fp, const file_map *map,
+                 long long start, long long size, packet_batch *batch, int blksize,
+                 long long first, long long last, int rollover) {
+    for (long long block_num = first; block_num <= last; block_num++) {
+        unsigned int wire = block_to_wire(block_num, rollover);
+        char *buffer = batch_next(batch);
+        if (!buffer) {
+            flush_blocks(sockfd, batch, blksize);
+            buffer = batch_next(batch);
+        }
+        encode_data_header(buffer, wire);
+
+        int n;
+        if (map) {
+            // Seul l'en-tête est copié : la charge utile pointe dans la projection
+            size_t len;
+            const char *data = file_map_block(map, block_num, blksize, &len);
+            batch_commit_payload(batch, 4, data, len, &addr);
+            n = len;
+        } else {
+            long long offset = (block_num - 1) * blksize;
+            long long left = size - offset;
+            if (ftell(fp) != start + offset)
+                fseek(fp, start + offset, SEEK_SET); // Retransmission : on repart du bloc demandé
+            // Lire le fichier et stocker les données dans le buffer, sans dépasser la plage
+            n = left <= 0 ? 0 : fread(buffer + 4, 1, left < blksize ? left : blksize, fp);
+            batch_commit(batch, n + 4, &addr);
+        }
+        metrics_add(MET_BYTES_SENT, n);
+        log_packet("[INFO] DATA envoyé - Bloc %lld (%d octets)\n", block_num, n);
+    }
+    flush_blocks(sockfd, batch, blksize);
+    metrics_add(MET_BLOCKS_SENT, last - first + 1);
+}
+
+// Libère la source d'un envoi : entrée du cache, ou projection et fichier ouvert
+void close_source(FILE *fp, cache_entry *cached, file_map *map, int mapped) {
+    if (cached)
+        file_cache_release(cached);
+    else if (mapped)
+        file_map_close(map);
+    if (fp)
+        fclose(fp);
+}
+
+// Fonction pour envoyer un fichier au client
+// start_us : réception de la requête, pour les métriques de latence
+void send_file(int sockfd, struct sockaddr_in addr, char* filename, tftp_options *opts, long long start_us) {
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+    char filepath[1024];
+
+    // Noms cachés : réservés aux fichiers temporaires des réceptions en cours
+    if (write_pipe_hidden(filename)) {
+        log_error("[ERROR] Accès refusé au fichier caché %s.\n", filename);
+        send_error(sockfd, addr, 2, "Accès refusé");
+        return;
+    }
+    snprintf(filepath, sizeof(filepath), "%s%s", TFTP_DIR, filename); // Crée le chemin du fichier
+
+    // Fichier déjà en mémoire : ni ouverture ni lecture disque
+    FILE* fp = NULL;
+    file_map map;
+    int mapped;
+    cache_entry *cached = file_cache_acquire(filename);
+    if (cached) {
+        map = *file_cache_map(cached);
+        mapped = 1;
+    } else {
+        // Ouvrir le fichier en mode lecture
+        fp = fopen(filepath, "rb");
+        if (fp == NULL) {
+            perror("[ERROR] Fichier introuvable.");
+            send_error(sockfd, addr, 1, "Fichier introuvable");
+            return;
+        }
+        // Projection du fichier pour tout le transfert ; à défaut, lecture par stdio
+        mapped = file_map_open(&map, fileno(fp)) == 0;
+    }
+
+    // Calculer la taille du fichier
+    long file_size;
+    if (mapped) {
+        file_size = map.size;
+    } else {
+        fseek(fp, 0, SEEK_END);
+        file_size = ftell(fp);
+        rewind(fp);
+    }
+
+    // Avec l'option offset, seule une plage du fichier est servie ; tsize reste
+    // la taille du fichier entier, pour que le client découpe les suivantes
+    long long range_start, range_len;
+    if (request_range(opts, file_size, &range_start, &range_len) < 0) {
+        log_error("[ERROR] Plage demandée hors du fichier %s (offset %lld).\n", filename, opts->offset);
+        send_error(sockfd, addr, 8, "Plage hors du fichier");
+        close_source(fp, cached, &map, mapped);
+        return;
+    }
+    file_map view = { NULL, 0 };
+    if (mapped)
+        view = file_map_slice(&map, range_start, range_len);
+
+    // Négociation des options : le bloc 0 est alors l'OACK, acquitté par ACK(0)
+    opts->tsize = file_size;
+    int has_oack = negotiate_options(addr, opts);
+    int blksize = opts->blksize;
+    long long last_block = range_len / blksize + 1; // Seul bloc de moins de blksize octets
+    long long acked = has_oack ? -1 : 0;
+    // Une fenêtre part en lots d'au plus BATCH_MAX paquets
+    packet_batch batch;
+    int batch_size = opts->windowsize < BATCH_MAX ? opts->windowsize : BATCH_MAX;
+    char *ack_buffer = malloc(PACKET_SIZE);
+    if (!ack_buffer || batch_alloc(&batch, batch_size, blksize + 4) < 0) {
+        perror("[ERROR] Allocation des tampons de transfert");
+        free(ack_buffer);
+        close_source(fp, cached, &map, mapped);
+        return;
+    }
+
+    log_info("[INFO] Début d'envoi du fichier : %s (%ld octets, blocs de %d octets, fenêtre de %d)\n",
+             filename, file_size, blksize, opts->windowsize);
+
+    // Délai de retransmission adaptatif, plafonné par l'option timeout
+    rtt_estimator rtt;
+    rtt_init(&rtt, opts->timeout);
+    long long highest_sent = acked;
+
+    int aborted = 0;
+    while (acked < last_block) {
+        // Envoi de l'OACK, ou de la fenêtre qui suit le dernier bloc acquitté
+        long long sent;
+        if (acked < 0) {
+            send_oack(sockfd, addr, opts);
+            sent = 0;
+        } else {
+            sent = acked + opts->windowsize;
+            if (sent > last_block)
+                sent = last_block;
+            if (highest_sent < 1)
+                metrics_observe(HIST_FIRST_DATA, rtt_now_us() - start_us);
+            send_blocks(sockfd, addr, fp, mapped ? &view : NULL, range_start, range_len, &batch, blksize,
+                        acked + 1, sent, opts->rollover);
+        }
+        // Règle de Karn : pas de mesure de RTT sur une fenêtre qui renvoie un bloc
+        int retransmitted = acked + 1 <= highest_sent;
+        if (sent > highest_sent)
+            highest_sent = sent;
+        long long sent_us = rtt_now_us();
+        long long deadline = sent_us + rtt.rto_us;
+
+        // Attente d'un ACK pour un bloc de la fenêtre (les autres paquets sont ignorés)
+        long long ack_block = -1;
+        while (ack_block < 0 && rtt_wait_readable(sockfd, deadline)) {
+            int ack_received = recvfrom(sockfd, ack_buffer, PACKET_SIZE, MSG_DONTWAIT,
+                                        (struct sockaddr*)&client_addr, &client_addr_len);
+            if (ack_received < 4)
+                continue;
+            int ack_opcode = packet_opcode(ack_buffer, ack_received);
+            unsigned int wire = packet_block(ack_buffer);
+            long long block = block_from_wire(wire, acked < 0 ? 0 : acked, opts->rollover);
+            if (ack_opcode == ACK && block > acked && block <= sent) {
+                log_packet("[INFO] Serveur: ACK %lld reçu de %s:%d\n", block,
+                    inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+                addr = client_addr; // Mettre à jour l'adresse du client
+                ack_block = block;
+            } else if (ack_opcode == ERROR) {
+                log_error("[ERROR] Transfert interrompu par le client (code %u).\n", wire);
+                metrics_inc(MET_ERRORS_RECEIVED);
+                aborted = 1;
+                break;
+            } else {
+                log_packet("[ERROR] ACK invalide reçu (opcode: %d, block: %lld) pour la fenêtre %lld-%lld\n",
+                    ack_opcode, block, acked + 1, sent);
+            }
+        }
+        if (aborted)
+            break;
+        if (ack_block < 0) {
+            // Pas d'ACK : la fenêtre est renvoyée depuis le dernier bloc acquitté
+            rtt_timeout(&rtt);
+            if (rtt_gave_up(&rtt, rtt_now_us())) {
+                log_error("[ERROR] Abandon de l'envoi du bloc %lld : plus de réponse du client.\n", acked + 1);
+                metrics_inc(MET_TIMEOUTS);
+                break;
+            }
+            metrics_inc(MET_RETRANSMITS);
+            log_debug("[WARNING] Aucun ACK reçu pour le bloc %lld, renvoi (délai %ld ms).\n",
+                      acked + 1, rtt.rto_us / 1000);
+            continue;
+        }
+        metrics_observe(HIST_RTT, rtt_progress(&rtt, sent_us, retransmitted));
+        acked = ack_block;
+    }
+    if (acked == last_block)
+        metrics_observe(HIST_TRANSFER, rtt_now_us() - start_us);
+    batch_free(&batch);
+    free(ack_buffer);
+    close_source(fp, cached, &map, mapped);
+    log_info("[INFO] Fin d'envoi du fichier : %s\n", filename);
+    log_info("[INFO] Fin de transmission.\n");
+}
+
+// Fonction pour recevoir un fichier du client
+void receive_file(int sockfd, struct sockaddr_in addr, char* filename, tftp_options *opts, long long start_us) {
+    int n;
+    long long block_num = 0;
+    char filepath[1024];
+
+    if (write_pipe_hidden(filename)) {
+        log_error("[ERROR] Accès refusé au fichier caché %s.\n", filename);
+        send_error(sockfd, addr, 2, "Accès refusé");
+        return;
+    }
+    snprintf(filepath, sizeof(filepath), "%s%s", TFTP_DIR, filename);
+
+    // Réception dans un fichier temporaire, écrite en différé par les threads d'écriture.
+    // Avec tsize, l'espace est réservé d'avance : un fichier trop gros est refusé
+    // avant le premier bloc.
+    write_pipe *pipe = write_pipe_open(filepath, (opts->present & OPT_TSIZE) ? opts->tsize : 0);
+    if (pipe == NULL) {
+        if (errno == ENOSPC) {
+            log_error("[ERROR] Espace disque insuffisant pour %s (%lld octets).\n", filename, opts->tsize);
+            send_error(sockfd, addr, 3, "Disque plein ou dépassement de capacité");
+            return;
+        }
+        perror("[ERROR] Impossible de créer le fichier temporaire.");
+        return;
+    }
+
+    opts->present &= ~(OPT_OFFSET | OPT_LENGTH);  // Plage d'octets : RRQ seulement
+    int has_oack = negotiate_options(addr, opts);
+    int blksize = opts->blksize;
+    // Les blocs d'une fenêtre sont lus par lots avec recvmmsg
+    packet_batch batch;
+    int batch_size = opts->windowsize < BATCH_MAX ? opts->windowsize : BATCH_MAX;
+    if (batch_alloc(&batch, batch_size, blksize + 4) < 0) {
+        perror("[ERROR] Allocation du tampon de réception");
+        write_pipe_close(pipe, 0);
+        return;
+    }
+
+    // L'OACK tient lieu d'ACK initial lorsque des options sont acceptées
+    if (has_oack)
+        send_oack(sockfd, addr, opts);
+    else
+        send_ack(sockfd, addr, block_num, opts->rollover); // Envoi de l'ACK initial
+    log_debug("[DEBUG] ACK initial envoyé, attente des blocs DATA...\n");
+
+    // Sans DATA dans le délai, le dernier ACK (ou l'OACK) est renvoyé au client
+    rtt_estimator rtt;
+    rtt_init(&rtt, opts->timeout);
+    long long sent_us = rtt_now_us();    // Envoi du dernier ACK
+    long long timer_us = sent_us;        // Dernier ACK envoyé ou bloc reçu dans l'ordre
+    int retransmitted = 0;
+
+    int window_count = 0;   // Blocs reçus depuis le dernier ACK
+    long long ooo_block = -1;  // Dernier bloc hors séquence reçu
+    int complete = 0;
+    int stop = 0;           // Fin de la réception (complète ou interrompue)
+    while (!stop) {
+        if (!rtt_wait_readable(sockfd, timer_us + rtt.rto_us)) {
+            rtt_timeout(&rtt);
+            if (rtt_gave_up(&rtt, rtt_now_us())) {
+                log_error("[ERROR] Plus de DATA du client après le bloc %lld.\n", block_num);
+                metrics_inc(MET_TIMEOUTS);
+                break;
+            }
+            if (block_num == 0 && has_oack)
+                send_oack(sockfd, addr, opts);
+            else
+                send_ack(sockfd, addr, block_num, opts->rollover);
+            metrics_inc(MET_RETRANSMITS);
+            window_count = 0;
+            sent_us = timer_us = rtt_now_us();
+            retransmitted = 1;
+            continue;
+        }
+        int nrecv = batch_recv(&batch, sockfd, MSG_DONTWAIT);
+        for (int k = 0; k < nrecv && !stop; k++) {
+            char *buffer = batch_slot(&batch, k);
+            n = batch_len(&batch, k);
+            addr = batch.addrs[k];
+            log_packet("[DEBUG] Paquet reçu - Taille: %d octets\n", n);
+            if (n < 4) continue; // Paquet trop court, ignoré
+
+            int opcode = packet_opcode(buffer, n);
+            if (opcode == ERROR) {
+                log_error("[ERROR] Transfert interrompu par le client.\n");
+                metrics_inc(MET_ERRORS_RECEIVED);
+                stop = 1;
+                break;
+            }
+            if (opcode != DATA)
+                continue;
+            unsigned int wire = packet_block(buffer);
+            long long received = block_from_wire(wire, block_num, opts->rollover);
+            if (received == block_num + 1) {
+                if (n > 4) {
+                    // Copie dans les tampons d'écriture ; le disque n'est attendu que
+                    // si tous les tampons du fichier sont déjà en cours d'écriture
+                    if (write_pipe_append(pipe, buffer + 4, n - 4, 1) < 0) {
+                        perror("[ERROR] Ecriture du fichier");
+                        send_error(sockfd, addr, 3, "Disque plein ou erreur d'écriture");
+                        stop = 1;
+                        break;
+                    }
+                    log_packet("[INFO] DATA reçu - Bloc %lld (%d octets)\n", received, n - 4);
+                } else {
+                    log_packet("[INFO] Bloc %lld reçu (fin de transmission, 0 octets)\n", received);
+                }
+                metrics_inc(MET_BLOCKS_RECEIVED);
+                metrics_add(MET_BYTES_RECEIVED, n - 4);
+                if (received == 1)
+                    metrics_observe(HIST_FIRST_DATA, rtt_now_us() - start_us);
+                // Seul le premier bloc qui suit un ACK mesure le RTT
+                metrics_observe(HIST_RTT, rtt_progress(&rtt, sent_us, retransmitted || window_count > 0));
+                timer_us = rtt_now_us();
+                block_num = received;
+                ooo_block = -1;
+                complete = (n - 4) < blksize; // Fin de la transmission si le bloc est plus petit que la taille de bloc
+                // Le dernier ACK ne part qu'une fois le fichier écrit et renommé
+                if (complete) {
+                    int ret = write_pipe_close(pipe, 1);
+                    pipe = NULL;
+                    if (ret < 0) {
+                        perror("[ERROR] Écriture du fichier reçu");
+                        send_error(sockfd, addr, 3, "Disque plein ou erreur d'écriture");
+                        complete = 0;
+                        stop = 1;
+                        break;
+                    }
+                    log_info("[INFO] Fichier %s reçu correctement.\n", filename);
+                    metrics_observe(HIST_TRANSFER, rtt_now_us() - start_us);
+                }
+                // Un seul ACK par fenêtre, ou pour le dernier bloc
+                if (complete || ++window_count >= opts->windowsize) {
+                    send_ack(sockfd, addr, block_num, opts->rollover);
+                    window_count = 0;
+                    sent_us = timer_us;
+                    retransmitted = 0;
+                }
+                if (complete) stop = 1;
+            } else {
+                // Doublon ou perte : on acquitte le dernier bloc reçu dans l'ordre,
+                // une fois par passage de la fenêtre retransmise
+                if (ooo_block < 0 || received <= ooo_block) {
+                    send_ack(sockfd, addr, block_num, opts->rollover);
+                    window_count = 0;
+                    sent_us = timer_us = rtt_now_us();
+                    retransmitted = 1;
+                }
+                ooo_block = received;
+            }
+        }
+    }
+    // Dernier ACK envoyé : on reste à l'écoute pour le renvoyer si le client,
+    // ne l'ayant pas reçu, retransmet sa dernière fenêtre
+    long long dally_end = rtt_now_us() + RTT_DALLY_FACTOR * rtt.rto_us;
+    while (complete && rtt_wait_readable(sockfd, dally_end)) {
+        int nrecv = batch_recv(&batch, sockfd, MSG_DONTWAIT);
+        for (int k = 0; k < nrecv; k++) {
+            if (packet_opcode(batch_slot(&batch, k), batch_len(&batch, k)) == DATA) {
+                send_ack(sockfd, addr, block_num, opts->rollover);
+                break;
+            }
+        }
+    }
+    batch_free(&batch);
+    if (!complete) {
+        // Transfert interrompu : on ne garde pas de fichier partiel
+        if (pipe)
+            write_pipe_close(pipe, 0);
+        log_error("[ERROR] Réception du fichier %s interrompue.\n", filename);
+        return;
+    }
+    log_info("[INFO] Fin de réception du fichier : %s\n", filename);
+    log_info("[INFO] Fin de transmission.\n");
+}
+
+// ----------------------- File de requêtes -----------------------
+
+static unsigned int request_hash(const struct sockaddr_in *addr) {
+    unsigned int h = addr->sin_addr.s_addr * 2654435761u ^ addr->sin_port;
+    h ^= h >> 16;
+    return h % queue.nslots;
+}
+
+int queue_init(int capacity, int workers) {
+    queue.capacity = capacity;
+    queue.nslots = capacity + workers;
+    queue.slots = calloc(queue.nslots, sizeof(*queue.slots));
+    queue.buckets = malloc(queue.nslots * sizeof(*queue.buckets));
+    queue.ring = malloc(capacity * sizeof(*queue.ring));
+    if (!queue.slots || !queue.buckets || !queue.ring)
+        return -1;
+    for (int i = 0; i < queue.nslots; i++) {
+        queue.buckets[i] = -1;
+        queue.slots[i].free_next = i + 1 < queue.nslots ? i + 1 : -1;
+    }
+    queue.free_slot = 0;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.not_empty, NULL);
+    return 0;
+}
+
+// Met une requête en file. Renvoie 0, 1 si le client a déjà une requête en
+// file ou en cours (retransmission), -1 si la file est pleine.
+int queue_push(int sockfd, struct sockaddr_in *addr, int opcode,
+               const char *filename, const tftp_options *opts) {
+    pthread_mutex_lock(&queue.lock);
+    unsigned int h = request_hash(addr);
+    for (int i = queue.buckets[h]; i >= 0; i = queue.slots[i].hash_next) {
+        if (queue.slots[i].client_addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+            queue.slots[i].client_addr.sin_port == addr->sin_port) {
+            queue.duplicates++;
+            pthread_mutex_unlock(&queue.lock);
+            return 1;
+        }
+    }
+    if (queue.count == queue.capacity || queue.free_slot < 0) {
+        queue.rejected++;
+        pthread_mutex_unlock(&queue.lock);
+        return -1;
+    }
+    int idx = queue.free_slot;
+    client_request_t *request = &queue.slots[idx];
+    queue.free_slot = request->free_next;
+    request->sockfd = sockfd;
+    request->client_addr = *addr;
+    request->opcode = opcode;
+    request->opts = *opts;
+    snprintf(request->filename, sizeof(request->filename), "%s", filename);
+    request->queued_us = rtt_now_us();
+    request->hash_next = queue.buckets[h];
+    queue.buckets[h] = idx;
+    queue.ring[(queue.head + queue.count) % queue.capacity] = idx;
+    queue.count++;
+    queue.accepted++;
+    metrics_inc(MET_REQUESTS_WAITING);
+    if (queue.count > queue.max_depth)
+        queue.max_depth = queue.count;
+    pthread_cond_signal(&queue.not_empty);
+    pthread_mutex_unlock(&queue.lock);
+    return 0;
+}
+
+// Attend la prochaine requête ; le slot reste réservé jusqu'à queue_release
+int queue_pop(void) {
+    pthread_mutex_lock(&queue.lock);
+    while (queue.count == 0)
+        pthread_cond_wait(&queue.not_empty, &queue.lock);
+    int idx = queue.ring[queue.head];
+    queue.head = (queue.head + 1) % queue.capacity;
+    queue.count--;
+    metrics_add(MET_REQUESTS_WAITING, -1);
+    long long wait_us = rtt_now_us() - queue.slots[idx].queued_us;
+    queue.total_wait_us += wait_us;
+    if (wait_us > queue.max_wait_us)
+        queue.max_wait_us = wait_us;
+    queue.dequeued++;
+    pthread_mutex_unlock(&queue.lock);
+    return idx;
+}
+
+// Transfert terminé : le client peut de nouveau être servi
+void queue_release(int idx) {
+    pthread_mutex_lock(&queue.lock);
+    int *link = &queue.buckets[request_hash(&queue.slots[idx].client_addr)];
+    while (*link != idx)
+        link = &queue.slots[*link].hash_next;
+    *link = queue.slots[idx].hash_next;
+    queue.slots[idx].free_next = queue.free_slot;
+    queue.free_slot = idx;
+    pthread_mutex_unlock(&queue.lock);
+}
+
+// Invalidation du cache de fichiers au fil des événements inotify
+void* watch_cache(void* arg) {
+    (void)arg;
+    while (1)
+        file_cache_process_events(1);
+    return NULL;
+}
+
+// Groupes multicast : paquets des clients et retransmissions
+void* run_multicast(void* arg) {
+    (void)arg;
+    struct pollfd pfd = { .fd = mcast_fd(), .events = POLLIN };
+    while (1) {
+        long long next = mcast_process();
+        int timeout_ms = -1;
+        if (next >= 0) {
+            long long wait_us = next - rtt_now_us();
+            timeout_ms = wait_us > 0 ? (int)((wait_us + 999) / 1000) : 0;
+        }
+        poll(&pfd, 1, timeout_ms);
+    }
+    return NULL;
+}
+
+// Rapport périodique sur la file (profondeur, attente et refus) et sur le cache
+void* report_stats(void* arg) {
+    (void)arg;
+    unsigned long last_accepted = 0, last_rejected = 0;
+    while (1) {
+        sleep(STATS_INTERVAL_SEC);
+        pthread_mutex_lock(&queue.lock);
+        file_cache_stats cache_stats;
+        file_cache_get_stats(&cache_stats);
+        lock_table_stats lock_stats;
+        lock_table_get_stats(&lock_stats);
+        if (queue.accepted != last_accepted || queue.rejected != last_rejected) {
+            log_info("[STATS] File : %d en attente (max %d), attente moyenne %lld ms (max %lld ms), "
+                     "%lu acceptées, %lu refusées, %lu doublons ignorés\n",
+                     queue.count, queue.max_depth,
+                     queue.dequeued ? queue.total_wait_us / (long long)queue.dequeued / 1000 : 0,
+                     queue.max_wait_us / 1000,
+                     queue.accepted, queue.rejected, queue.duplicates);
+            log_info("[STATS] Cache : %lu succès, %lu échecs, %d fichiers (%zu Ko), "
+                     "%lu évictions, %lu invalidations\n",
+                     cache_stats.hits, cache_stats.misses, cache_stats.entries,
+                     cache_stats.bytes / 1024, cache_stats.evictions, cache_stats.invalidations);
+            log_info("[STATS] Verrous : %d tenus, %lu pris, %lu en conflit, %lu refusés, "
+                     "attente moyenne %lld ms (max %lld ms)\n",
+                     lock_stats.held, lock_stats.acquired, lock_stats.contended, lock_stats.refused,
+                     lock_stats.contended ? lock_stats.total_wait_us / (long long)lock_stats.contended / 1000 : 0,
+                     lock_stats.max_wait_us / 1000);
+            last_accepted = queue.accepted;
+            last_rejected = queue.rejected;
+        }
+        pthread_mutex_unlock(&queue.lock);
+    }
+    return NULL;
+}
+
+// Fonction pour traiter une requête client sur un worker
+void handle_client_request(client_request_t* request) {
+    // Un seul flux pour tous les clients du même fichier : le worker est aussitôt
+    // libre, le groupe étant mené par le thread du multicast. À défaut de groupe,
+    // le client est servi en unicast et l'option ignorée.
+    if (request->opcode == RRQ && (request->opts.present & OPT_MULTICAST) &&
+        mcast_join(&request->client_addr, request->filename, &request->opts) == 0) {
+        metrics_inc(MET_RRQ);
+        return;
+    }
+    request->opts.present &= ~OPT_MULTICAST;
+    // Lectures simultanées d'un même fichier ; une écriture l'a pour elle seule.
+    // Un transfert en conflit attend brièvement que le fichier se libère.
+    lock_entry *lock = lock_table_acquire(request->filename,
+                                          request->opcode == WRQ ? LOCK_EXCLUSIVE : LOCK_SHARED,
+                                          LOCK_WAIT_MS);
+    if (!lock) {
+        send_error(request->sockfd, request->client_addr, 0, "Erreur: un transfert de fichier est déjà en cours");
+        log_error("[ERROR] Transfert du fichier %s refusé : déjà en cours (autre client).\n", request->filename);
+        return;
+    }
+
+    // Création d'une socket pour le transfert des données
+    int data_sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (data_sockfd < 0) {
+        perror("[ERROR] Création de la socket de transfert");
+        lock_table_release(lock);
+        return;
+    }
+
+    struct sockaddr_in data_addr;
+    memset(&data_addr, 0, sizeof(data_addr));
+    data_addr.sin_family = AF_INET;
+    data_addr.sin_addr.s_addr = INADDR_ANY;
+    data_addr.sin_port = 0;
+    if (bind(data_sockfd, (struct sockaddr*)&data_addr, sizeof(data_addr)) < 0) {
+        perror("[ERROR] Bind sur la socket de transfert");
+        close(data_sockfd);
+        lock_table_release(lock);
+        return;
+    }
+
+    socklen_t addr_len = sizeof(data_addr);
+    if (getsockname(data_sockfd, (struct sockaddr*)&data_addr, &addr_len) == 0) {
+        log_debug("[INFO] Socket de transfert bindée sur le port %d\n", ntohs(data_addr.sin_port));
+    } else {
+        perror("[ERROR] getsockname");
+    }
+
+    // Traitement de la demande selon l'opcode (lecture ou écriture)
+    metrics_inc(MET_SESSIONS_ACTIVE);
+    if (request->opcode == RRQ) {
+        log_info("[THREAD] Lecture du fichier demandée : %s\n", request->filename);
+        metrics_inc(MET_RRQ);
+        send_file(data_sockfd, request->client_addr, request->filename, &request->opts, request->queued_us);
+    } else if (request->opcode == WRQ) {
+        log_info("[THREAD] Écriture du fichier demandée : %s\n", request->filename);
+        metrics_inc(MET_WRQ);
+        receive_file(data_sockfd, request->client_addr, request->filename, &request->opts, request->queued_us);
+    }
+    metrics_add(MET_SESSIONS_ACTIVE, -1);
+
+    // Fermeture de la socket et nettoyage
+    close(data_sockfd);
+    lock_table_release(lock);
+}
+
+// Boucle d'un worker : traite les requêtes de la file une à une
+void* worker_main(void* arg) {
+    (void)arg;
+    while (1) {
+        int idx = queue_pop();
+        handle_client_request(&queue.slots[idx]);
+        queue_release(idx);
+    }
+    return NULL;
+}
+
+// Met en file une requête reçue sur le port du serveur
+void dispatch_request(int sockfd, char *buffer, int n, struct sockaddr_in *client_addr) {
+    int opcode;
+    const char *filename;
+    tftp_mode mode;
+    tftp_options opts;
+    if (parse_request(buffer, n, &opcode, &filename, &mode, &opts) < 0) {
+        // Mode inconnu ou champs tronqués : le client est prévenu ; un autre
+        // paquet égaré sur le port du serveur est ignoré
+        if (opcode == RRQ || opcode == WRQ)
+            send_error(sockfd, *client_addr, 4, "Requête mal formée");
+        log_warn("[ERROR] Requête mal formée ignorée.\n");
+        return;
+    }
+    // Un client déjà en file ou en cours de transfert retransmet sa requête : ignorée
+    int ret = queue_push(sockfd, client_addr, opcode, filename, &opts);
+    if (ret > 0) {
+        log_warn("[WARN] Requête en double de %s:%d ignorée.\n",
+                 inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port));
+    } else if (ret < 0) {
+        metrics_inc(MET_REQUESTS_REJECTED);
+        send_error(sockfd, *client_addr, 0, "Serveur surchargé, réessayez plus tard");
+        log_warn("[ERROR] File pleine, requête de %s:%d refusée.\n",
+                 inet_ntoa(client_addr->sin_addr), ntohs(client_addr->sin_port));
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-w workers] [-q taille_file] [-c cache_Mo] [-g] "
+            "[-l error|warn|info|debug|packet] [-m socket_stats] [-M premier_groupe_multicast] "
+            "[-P processus [-b]]\n"
+            "  -P : un processus par CPU (0) ou n processus, sous un superviseur\n"
+            "  -b : requêtes réparties selon le CPU qui les reçoit (BPF)\n", prog);
+    exit(1);
+}
+
+// Fonction principale : création du socket serveur et gestion des requêtes clients
+int main(int argc, char *argv[]) {
+    const int port = 6969;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = -1;
+    int queue_size = DEFAULT_QUEUE_SIZE;
+    long cache_mb = DEFAULT_CACHE_MB;
+    int level = LOG_INFO;
+    const char *metrics_path = METRICS_DEFAULT_PATH;
+    const char *mcast_group = MCAST_DEFAULT_GROUP;
+    int processes = -1, steer_cpu = 0, worker = -1;
+    int opt;
+    while ((opt = getopt(argc, argv, "w:q:c:gl:m:M:P:b")) != -1) {
+        switch (opt) {
+            case 'g': use_gso = 1; break;
+            case 'w': workers = atoi(optarg); break;
+            case 'q': queue_size = atoi(optarg); break;
+            case 'c': cache_mb = atol(optarg); break;
+            case 'l': level = log_level_parse(optarg); break;
+            case 'm': metrics_path = optarg; break;
+            case 'M': mcast_group = optarg; break;
+            case 'P': processes = atoi(optarg); break;
+            case 'b': steer_cpu = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (workers == 0 || workers < -1 || queue_size < 1 || cache_mb < 0 || level < 0 ||
+        (steer_cpu && processes < 0))
+        usage(argv[0]);
+    // Fichiers temporaires des réceptions interrompues par un arrêt du serveur :
+    // supprimés avant le lancement des workers, jamais à leur relance
+    log_level = level;
+    int cleaned = write_pipe_cleanup(TFTP_DIR);
+    if (cleaned > 0)
+        log_warn("[WARN] %d fichier(s) temporaire(s) de réceptions interrompues supprimé(s).\n", cleaned);
+    int sockfd = -1;
+    struct sockaddr_in server_addr;
+    if (processes >= 0) {
+        // Le superviseur ne revient que dans les processus workers ; il écrit ses
+        // messages directement, sans le thread du journal que fork ne recopierait pas
+        log_level = level;
+        sockfd = supervisor_run(processes, port, 0, steer_cpu, metrics_path, &worker);
+        if (sockfd < 0) {
+            perror("[ERROR] Lancement des processus workers");
+            exit(1);
+        }
+        // Processus épinglé sur un CPU : un pool à sa mesure, un cache à sa part
+        if (workers < 0)
+            workers = WORKERS_PER_CPU;
+        cache_mb /= supervisor_workers();
+    } else if (workers < 0) {
+        workers = (cpus > 0 ? cpus : 1) * WORKERS_PER_CPU;
+    }
+    // Les workers journalisent dans leurs anneaux, vidés par un thread dédié
+    if (log_init(level) < 0)
+        perror("[WARN] Journal asynchrone indisponible");
+    if (worker < 0 && metrics_init(metrics_path) < 0)
+        perror("[WARN] Socket de statistiques indisponible");
+
+    if (worker < 0) {
+        sockfd = socket(AF_INET, SOCK_DGRAM, 0);  // Créer une socket UDP
+        if (sockfd < 0) {
+            perror("[ERROR] Échec de la création du socket.");
+            exit(1);
+        }
+
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(port);
+        server_addr.sin_addr.s_addr = INADDR_ANY;
+        if (bind(sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+            perror("[ERROR] Échec du bind.");
+            exit(1);
+        }
+    }
+
+    // Démarrage du pool de workers et du rapport sur la file
+    if (queue_init(queue_size, workers) < 0) {
+        perror("[ERROR] Allocation de la file de requêtes");
+        exit(1);
+    }
+    for (int i = 0; i < workers; i++) {
+        pthread_t thread_id;
+        if (pthread_create(&thread_id, NULL, worker_main, NULL) != 0) {
+            perror("[ERROR] Création d'un worker");
+            exit(1);
+        }
+        pthread_detach(thread_id);
+    }
+    // Cache des fichiers servis, partagé par tous les workers
+    if (cache_mb > 0) {
+        if (file_cache_init(TFTP_DIR, (size_t)cache_mb << 20) < 0) {
+            perror("[WARN] Cache de fichiers désactivé (inotify)");
+        } else {
+            pthread_t watcher_id;
+            pthread_create(&watcher_id, NULL, watch_cache, NULL);
+            pthread_detach(watcher_id);
+        }
+    }
+    // Groupes multicast (RFC 2090) pour les clients qui demandent l'option
+    if (mcast_init(TFTP_DIR, mcast_group, MCAST_DEFAULT_PORT + (worker < 0 ? 0 : worker)) < 0) {
+        perror("[WARN] Multicast désactivé");
+    } else {
+        pthread_t mcast_id;
+        pthread_create(&mcast_id, NULL, run_multicast, NULL);
+        pthread_detach(mcast_id);
+    }
+    pthread_t stats_id;
+    pthread_create(&stats_id, NULL, report_stats, NULL);
+    pthread_detach(stats_id);
+
+    log_info("[STARTING] Serveur TFTP en attente (%d workers, file de %d requêtes)...\n",
+             workers, queue_size);
+    // Les requêtes arrivées ensemble sont lues en un seul appel à recvmmsg
+    packet_batch batch;
+    if (batch_alloc(&batch, BATCH_MAX, PACKET_SIZE) < 0) {
+        perror("[ERROR] Allocation du lot de réception");
+        exit(1);
+    }
+    while (1) {
+        int nrecv = batch_recv(&batch, sockfd, MSG_WAITFORONE); // Attente d'au moins une requête
+        for (int k = 0; k < nrecv; k++)
+            dispatch_request(sockfd, batch_slot(&batch, k), batch_len(&batch, k), &batch.addrs[k]);
+    }
+    batch_free(&batch);
+    close(sockfd);  // Fermer le socket lorsque le serveur termine
+    log_flush();
+    return 0;
+}
+
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "SessionPool.h"
+#include "Rtt.h"
+
+void pool_init(slab_pool *pool, size_t object_size, int limit, size_t budget) {
+    memset(pool, 0, sizeof(*pool));
+    pool->object_size = object_size;
+    pool->limit = limit;
+    pool->budget = budget;
+}
+
+int pool_grow(slab_pool *pool) {
+    size_t slab_bytes = POOL_SLAB_OBJECTS * pool->object_size;
+    if (pool->capacity >= pool->limit || slab_bytes > pool_available(pool))
+        return -1;
+    // Le tableau des slabs double quand il est plein (nslabs puissance de 2)
+    if ((pool->nslabs & (pool->nslabs - 1)) == 0) {
+        char **slabs = realloc(pool->slabs, (pool->nslabs ? pool->nslabs * 2 : 1) * sizeof(*slabs));
+        if (!slabs)
+            return -1;
+        pool->slabs = slabs;
+    }
+    char *slab = malloc(slab_bytes);
+    if (!slab)
+        return -1;
+    pool->slabs[pool->nslabs++] = slab;
+    pool->used += slab_bytes;
+    int first = pool->capacity;
+    pool->capacity += POOL_SLAB_OBJECTS;
+    return first;
+}
+
+int pool_reserve(slab_pool *pool, size_t bytes) {
+    if (bytes > pool_available(pool))
+        return -1;
+    pool->used += bytes;
+    return 0;
+}
+
+void pool_unreserve(slab_pool *pool, size_t bytes) {
+    pool->used -= bytes;
+}
+
+size_t pool_available(const slab_pool *pool) {
+    return pool->used < pool->budget ? pool->budget - pool->used : 0;
+}
+
+static unsigned int admission_hash(const admission_queue *queue, const struct sockaddr_in *addr) {
+    unsigned int h = addr->sin_addr.s_addr * 2654435761u ^ addr->sin_port;
+    h ^= h >> 16;
+    return h % queue->capacity;
+}
+
+int admission_init(admission_queue *queue, int capacity, int wait_ms) {
+    queue->entries = malloc(capacity * sizeof(*queue->entries));
+    queue->buckets = malloc(capacity * sizeof(*queue->buckets));
+    if (!queue->entries || !queue->buckets)
+        return -1;
+    for (int i = 0; i < capacity; i++)
+        queue->buckets[i] = -1;
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->max_wait_us = wait_ms * 1000LL;
+    return 0;
+}
+
+int admission_push(admission_queue *queue, const struct sockaddr_in *addr,
+                   const char *buf, int len) {
+    unsigned int h = admission_hash(queue, addr);
+    for (int i = queue->buckets[h]; i >= 0; i = queue->entries[i].hash_next) {
+        if (queue->entries[i].addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+            queue->entries[i].addr.sin_port == addr->sin_port)
+            return 1;
+    }
+    if (queue->count == queue->capacity || len > ADMISSION_REQUEST_MAX)
+        return -1;
+    int idx = (queue->head + queue->count) % queue->capacity;
+    pending_request *p = &queue->entries[idx];
+    p->addr = *addr;
+    p->queued_us = rtt_now_us();
+    p->len = len;
+    memcpy(p->buf, buf, len);
+    p->hash_next = queue->buckets[h];
+    queue->buckets[h] = idx;
+    queue->count++;
+    return 0;
+}
+
+pending_request *admission_peek(admission_queue *queue) {
+    return queue->count > 0 ? &queue->entries[queue->head] : NULL;
+}
+
+void admission_pop(admission_queue *queue) {
+    int *link = &queue->buckets[admission_hash(queue, &queue->entries[queue->head].addr)];
+    while (*link != queue->head)
+        link = &queue->entries[*link].hash_next;
+    *link = queue->entries[queue->head].hash_next;
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+}
@@ -0,0 +1,101 @@
+#ifndef SESSION_POOL_H
+#define SESSION_POOL_H
+
+#include <stddef.h>
+#include <netinet/in.h>
+
+// Réserve des sessions du serveur à boucle d'événements. Les sessions sont
+// allouées par slabs de POOL_SLAB_OBJECTS, jamais déplacés : la réserve grandit
+// sans recopier les sessions en cours, et une session garde son adresse
+// pendant tout son transfert. Elle est bornée par un budget mémoire, qui compte
+// les slabs et les tampons réservés par chaque transfert, et par un nombre de
+// sessions tiré des descripteurs disponibles.
+//
+// Au-delà du budget, les nouvelles requêtes attendent dans une file d'admission
+// qu'une session se libère. Une requête est refusée (ERROR « réessayez plus
+// tard ») si la file est pleine ou si elle y attend plus que le délai fixé :
+// le client a alors retransmis sa requête, ou abandonné.
+
+#define POOL_SLAB_SHIFT 8
+#define POOL_SLAB_OBJECTS (1 << POOL_SLAB_SHIFT)  // Sessions par slab
+#define POOL_DEFAULT_MB 256          // Budget mémoire par défaut des sessions
+#define POOL_FDS_PER_SESSION 2       // Socket de session et fichier transféré
+#define POOL_RESERVED_FDS 64         // Descripteurs laissés au reste du serveur
+
+#define ADMISSION_QUEUE_SIZE 1024    // Requêtes en attente d'une session
+#define ADMISSION_WAIT_MS 2000       // Attente maximale d'une requête en file
+#define ADMISSION_REQUEST_MAX 512    // Taille maximale d'une requête (RFC 2347)
+
+typedef struct {
+    size_t object_size;
+    char **slabs;
+    int nslabs;
+    int capacity;          // Objets dans les slabs alloués
+    int limit;             // Plafond d'objets (descripteurs)
+    size_t budget;         // Plafond mémoire : slabs et réservations
+    size_t used;           // Mémoire des slabs et des réservations en cours
+} slab_pool;
+
+// Prépare une réserve vide d'objets de object_size octets, d'au plus limit
+// objets et budget octets
+void pool_init(slab_pool *pool, size_t object_size, int limit, size_t budget);
+
+// Ajoute un slab. Renvoie l'indice de son premier objet, -1 si le plafond
+// d'objets ou le budget est atteint, ou si la mémoire manque.
+int pool_grow(slab_pool *pool);
+
+// Objet d'indice i (0 à capacity - 1)
+static inline void *pool_at(const slab_pool *pool, int i) {
+    return pool->slabs[i >> POOL_SLAB_SHIFT] +
+           (size_t)(i & (POOL_SLAB_OBJECTS - 1)) * pool->object_size;
+}
+
+// Réserve bytes octets du budget pour les tampons d'un objet.
+// Renvoie -1, sans rien réserver, si le budget ne les contient pas.
+int pool_reserve(slab_pool *pool, size_t bytes);
+
+void pool_unreserve(slab_pool *pool, size_t bytes);
+
+// Octets encore disponibles dans le budget
+size_t pool_available(const slab_pool *pool);
+
+// Requête en attente d'admission, recopiée depuis le tampon de réception
+typedef struct {
+    struct sockaddr_in addr;
+    long long queued_us;
+    int hash_next;             // Requête suivante du même seau (-1 en fin de chaîne)
+    int len;
+    char buf[ADMISSION_REQUEST_MAX];
+} pending_request;
+
+// Les requêtes restent à leur place dans la file circulaire, qui ne sert qu'à
+// l'ordre d'admission ; elles sont aussi indexées par l'adresse du client, ce
+// qui permet d'ignorer un RRQ/WRQ retransmis sans parcourir la file.
+typedef struct {
+    pending_request *entries;  // File circulaire
+    int *buckets;              // Seaux indexés par l'adresse du client (capacity seaux)
+    int capacity;
+    int head;
+    int count;
+    long long max_wait_us;
+} admission_queue;
+
+int admission_init(admission_queue *queue, int capacity, int wait_ms);
+
+// Met une requête en file. Renvoie 0, 1 si le client a déjà une requête en
+// file (retransmission), -1 si la file est pleine ou la requête trop longue.
+int admission_push(admission_queue *queue, const struct sockaddr_in *addr,
+                   const char *buf, int len);
+
+// Requête la plus ancienne (NULL si la file est vide), retirée par admission_pop
+pending_request *admission_peek(admission_queue *queue);
+
+void admission_pop(admission_queue *queue);
+
+// La requête a attendu plus que le délai de la file
+static inline int admission_expired(const admission_queue *queue,
+                                    const pending_request *request, long long now_us) {
+    return now_us - request->queued_us >= queue->max_wait_us;
+}
+
+#endif
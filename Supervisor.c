@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <linux/filter.h>
+
+#include "Supervisor.h"
+#include "Rtt.h"
+#include "Log.h"
+#include "Metrics.h"
+
+typedef struct {
+    int fd;                     // Socket d'écoute, gardée ouverte par le superviseur
+    int cpu;                    // CPU sur lequel le worker est épinglé
+    pid_t pid;                  // 0 tant que le worker attend d'être relancé
+    long long started_us;
+    long long restart_us;       // Relance prévue (worker arrêté)
+    int delay_ms;               // Délai de la prochaine relance
+} worker_slot;
+
+static worker_slot *slots;
+static int nslots = 1;
+
+int supervisor_workers(void) {
+    return nslots;
+}
+
+// Socket du groupe SO_REUSEPORT : le noyau lui attribue le rang de son bind
+static int open_listen_socket(int port, int rcvbuf) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+    int one = 1;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0 ||
+        bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    if (rcvbuf > 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return fd;
+}
+
+// Programme BPF du groupe : la requête va à la socket de rang CPU % n. Avec un
+// worker par CPU, c'est celle du worker épinglé sur le CPU qui reçoit le paquet.
+static int attach_cpu_steering(int fd, int n) {
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, n),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog = { .len = sizeof(code) / sizeof(code[0]), .filter = code };
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+}
+
+// Crée le processus du worker i. Renvoie 0 dans le worker, 1 dans le superviseur.
+static int spawn(int i, pid_t supervisor, const sigset_t *signals) {
+    fflush(stdout);  // Sinon le tampon de stdout serait écrit deux fois
+    pid_t pid = fork();
+    if (pid < 0) {
+        log_error("[ERROR] Lancement du worker %d : %s\n", i, strerror(errno));
+        slots[i].restart_us = rtt_now_us() + (long long)slots[i].delay_ms * 1000;
+        return 1;
+    }
+    if (pid == 0) {
+        // Le worker ne survit pas au superviseur
+        prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (getppid() != supervisor)
+            _exit(EXIT_FAILURE);
+        sigprocmask(SIG_UNBLOCK, signals, NULL);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(slots[i].cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0)
+            log_warn("[WARN] Worker %d : épinglage sur le CPU %d impossible\n", i, slots[i].cpu);
+        for (int k = 0; k < nslots; k++) {
+            if (k != i)
+                close(slots[k].fd);
+        }
+        metrics_select(i + 1);
+        return 0;
+    }
+    slots[i].pid = pid;
+    slots[i].started_us = rtt_now_us();
+    log_info("[INFO] Worker %d lancé (pid %d, CPU %d)\n", i, (int)pid, slots[i].cpu);
+    return 1;
+}
+
+// Worker arrêté : relance après un délai, doublé s'il s'arrête peu après son lancement
+static void worker_exited(int i, int status) {
+    long long now = rtt_now_us();
+    if (WIFSIGNALED(status))
+        log_warn("[WARN] Worker %d (pid %d) arrêté par le signal %d\n", i, (int)slots[i].pid, WTERMSIG(status));
+    else
+        log_warn("[WARN] Worker %d (pid %d) terminé (code %d)\n", i, (int)slots[i].pid, WEXITSTATUS(status));
+    if (now - slots[i].started_us >= SUPERVISOR_STABLE_SEC * 1000000LL)
+        slots[i].delay_ms = SUPERVISOR_RESTART_MS;
+    slots[i].pid = 0;
+    slots[i].restart_us = now + (long long)slots[i].delay_ms * 1000;
+    slots[i].delay_ms *= 2;
+    if (slots[i].delay_ms > SUPERVISOR_MAX_RESTART_MS)
+        slots[i].delay_ms = SUPERVISOR_MAX_RESTART_MS;
+    metrics_reset_gauges(i + 1);
+    metrics_add(MET_WORKERS, -1);
+    metrics_inc(MET_WORKER_RESTARTS);
+}
+
+static void shutdown_workers(void) {
+    for (int i = 0; i < nslots; i++) {
+        if (slots[i].pid > 0)
+            kill(slots[i].pid, SIGTERM);
+    }
+    for (int i = 0; i < nslots; i++) {
+        if (slots[i].pid > 0)
+            waitpid(slots[i].pid, NULL, 0);
+    }
+}
+
+int supervisor_run(int processes, int port, int rcvbuf, int steer_cpu,
+                   const char *metrics_path, int *worker) {
+    // Un worker par CPU autorisé, épinglé dans l'ordre des CPU
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0)
+        return -1;
+    int ncpus = CPU_COUNT(&allowed);
+    int n = processes > 0 ? processes : ncpus;
+    int cpus[CPU_SETSIZE];
+    for (int c = 0, k = 0; c < CPU_SETSIZE && k < ncpus; c++) {
+        if (CPU_ISSET(c, &allowed))
+            cpus[k++] = c;
+    }
+    slots = calloc(n, sizeof(*slots));
+    if (!slots || metrics_share(n + 1) < 0)
+        return -1;
+    nslots = n;
+    for (int i = 0; i < n; i++) {
+        slots[i].fd = open_listen_socket(port, rcvbuf);
+        if (slots[i].fd < 0)
+            return -1;
+        slots[i].cpu = cpus[i % ncpus];
+        slots[i].delay_ms = SUPERVISOR_RESTART_MS;
+    }
+    if (steer_cpu && attach_cpu_steering(slots[0].fd, n) < 0)
+        log_warn("[WARN] Répartition par CPU indisponible (%s), répartition par client\n", strerror(errno));
+
+    // Les signaux sont attendus par sigtimedwait ; bloqués avant les fork et
+    // avant le thread des statistiques, qui en hérite
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    pid_t self = getpid();
+    log_info("[STARTING] Superviseur : %d workers sur le port %d%s\n", n, port,
+             steer_cpu ? ", requêtes réparties par CPU" : "");
+    for (int i = 0; i < n; i++) {
+        if (spawn(i, self, &signals) == 0) {
+            *worker = i;
+            return slots[i].fd;
+        }
+        if (slots[i].pid > 0)
+            metrics_inc(MET_WORKERS);
+    }
+    if (metrics_init(metrics_path) < 0)
+        perror("[WARN] Socket de statistiques indisponible");
+
+    while (1) {
+        // Attente d'un signal, ou de la prochaine relance prévue
+        long long now = rtt_now_us(), next = -1;
+        for (int i = 0; i < n; i++) {
+            if (slots[i].pid == 0 && (next < 0 || slots[i].restart_us < next))
+                next = slots[i].restart_us;
+        }
+        struct timespec timeout = { 0, 0 };
+        if (next > now) {
+            timeout.tv_sec = (next - now) / 1000000;
+            timeout.tv_nsec = (next - now) % 1000000 * 1000;
+        }
+        int sig = sigtimedwait(&signals, NULL, next < 0 ? NULL : &timeout);
+        if (sig == SIGINT || sig == SIGTERM) {
+            log_info("[INFO] Superviseur : arrêt des workers\n");
+            shutdown_workers();
+            log_flush();
+            exit(EXIT_SUCCESS);
+        }
+        if (sig == SIGCHLD) {
+            int status;
+            pid_t pid;
+            while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+                for (int i = 0; i < n; i++) {
+                    if (slots[i].pid == pid)
+                        worker_exited(i, status);
+                }
+            }
+        }
+        now = rtt_now_us();
+        for (int i = 0; i < n; i++) {
+            if (slots[i].pid == 0 && slots[i].restart_us <= now) {
+                if (spawn(i, self, &signals) == 0) {
+                    *worker = i;
+                    return slots[i].fd;
+                }
+                if (slots[i].pid > 0)
+                    metrics_inc(MET_WORKERS);
+            }
+        }
+    }
+}
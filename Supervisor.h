@@ -0,0 +1,38 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+// Mode multi-processus des serveurs (option -P). Le superviseur ouvre une socket
+// par worker sur le port du serveur, avec SO_REUSEPORT, puis lance un processus
+// par socket, épinglé sur un CPU. Le noyau répartit les requêtes entre les
+// sockets selon l'adresse et le port du client : les requêtes retransmises par
+// un client arrivent au même worker, qui sert toutes les sessions qu'il accepte.
+// Avec steer_cpu, un programme BPF donne plutôt chaque requête à la socket du
+// CPU qui la reçoit : le traitement reste sur le cœur où arrive le paquet.
+//
+// Le superviseur garde les sockets ouvertes : un worker arrêté anormalement est
+// relancé sur la même socket, sans perdre les requêtes en attente. Les
+// statistiques (Metrics) sont en mémoire partagée, et le superviseur expose
+// leur somme sur le socket de statistiques.
+//
+// Chaque worker a son cache de fichiers et sa table de verrous : deux transferts
+// du même fichier reçus par deux workers ne s'excluent pas. Deux écritures
+// simultanées du même fichier restent distinctes : chacune a son fichier
+// temporaire, renommé à la fin, et la dernière terminée remplace l'autre.
+
+#define SUPERVISOR_RESTART_MS 100       // Délai avant de relancer un worker arrêté
+#define SUPERVISOR_MAX_RESTART_MS 5000  // Délai doublé à chaque arrêt rapproché, jusqu'à ce plafond
+#define SUPERVISOR_STABLE_SEC 10        // Un worker en service depuis ce temps remet le délai à zéro
+
+// Lance processes workers (0 : un par CPU utilisable), chacun avec une socket
+// liée à port, de tampon de réception rcvbuf (0 : valeur du système).
+// Ne revient que dans les workers : renvoie la socket d'écoute et *worker reçoit
+// le numéro du worker (0 à processes - 1). Le superviseur sert les statistiques
+// sur metrics_path, relance les workers et se termine avec eux sur SIGINT ou
+// SIGTERM. Renvoie -1 si les sockets ne peuvent pas être créées.
+int supervisor_run(int processes, int port, int rcvbuf, int steer_cpu,
+                   const char *metrics_path, int *worker);
+
+// Nombre de workers lancés par supervisor_run (1 sans superviseur)
+int supervisor_workers(void);
+
+#endif
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "TftpOptions.h"
+
+#define IP_UDP_TFTP_OVERHEAD 32  // En-têtes IPv4 (20) + UDP (8) + TFTP (4)
+
+// Convertit la valeur décimale de len octets d'une option, -1 si elle est
+// vide, contient autre chose que des chiffres ou dépasse un long long
+static long long decimal_value(const char *value, size_t len) {
+    if (len == 0)
+        return -1;
+    long long v = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned int digit = (unsigned char)value[i] - '0';
+        if (digit > 9 || v > (LLONG_MAX - digit) / 10)
+            return -1;
+        v = v * 10 + digit;
+    }
+    return v;
+}
+
+// Valeur de l'option multicast : vide dans un RRQ, « adresse,port,maître » dans
+// un OACK (adresse et port vides quand seul le rôle de maître change)
+static int parse_multicast(const char *value, size_t len, tftp_options *opts) {
+    opts->mcast_addr.s_addr = 0;
+    opts->mcast_port = 0;
+    opts->mcast_master = 0;
+    if (len == 0)
+        return 0;
+    const char *end = value + len;
+    const char *comma1 = memchr(value, ',', len);
+    const char *comma2 = comma1 ? memchr(comma1 + 1, ',', end - comma1 - 1) : NULL;
+    if (!comma2)
+        return -1;
+    size_t addr_len = comma1 - value;
+    if (addr_len > 0 || comma2 > comma1 + 1) {
+        // inet_pton attend une chaîne terminée : copie de l'adresse sur la pile
+        char addr[INET_ADDRSTRLEN];
+        long long port = decimal_value(comma1 + 1, comma2 - comma1 - 1);
+        if (addr_len >= sizeof(addr) || port < 0 || port > 65535)
+            return -1;
+        memcpy(addr, value, addr_len);
+        addr[addr_len] = '\0';
+        if (inet_pton(AF_INET, addr, &opts->mcast_addr) != 1 || !IN_MULTICAST(ntohl(opts->mcast_addr.s_addr)))
+            return -1;
+        opts->mcast_port = (int)port;
+    }
+    long long master = decimal_value(comma2 + 1, end - comma2 - 1);
+    if (master != 0 && master != 1)
+        return -1;
+    opts->mcast_master = (int)master;
+    return 0;
+}
+
+// Options reconnues. Les noms ne sont pas sensibles à la casse.
+static const struct {
+    const char *name;
+    size_t len;
+    unsigned int flag;
+} known_options[] = {
+    { "blksize", 7, OPT_BLKSIZE },
+    { "windowsize", 10, OPT_WINDOWSIZE },
+    { "timeout", 7, OPT_TIMEOUT },
+    { "tsize", 5, OPT_TSIZE },
+    { "rollover", 8, OPT_ROLLOVER },
+    { "offset", 6, OPT_OFFSET },
+    { "length", 6, OPT_LENGTH },
+    { "multicast", 9, OPT_MULTICAST },
+};
+
+// Masque OPT_* de l'option nommée par les len octets de name, 0 si inconnue
+static unsigned int option_flag(const char *name, size_t len) {
+    for (size_t i = 0; i < sizeof(known_options) / sizeof(known_options[0]); i++) {
+        if (known_options[i].len == len && strncasecmp(name, known_options[i].name, len) == 0)
+            return known_options[i].flag;
+    }
+    return 0;
+}
+
+int parse_options(const char *list, int len, tftp_options *opts) {
+    memset(opts, 0, sizeof(*opts));
+    int pos = 0;
+    while (pos < len) {
+        const char *name = list + pos;
+        const char *name_end = memchr(name, '\0', len - pos);
+        if (!name_end)
+            return -1;
+        pos = name_end - list + 1;
+        if (pos >= len)
+            return -1;
+        const char *value = list + pos;
+        const char *value_end = memchr(value, '\0', len - pos);
+        if (!value_end)
+            return -1;
+        pos = value_end - list + 1;
+
+        // Les options inconnues ou hors bornes sont ignorées
+        unsigned int flag = option_flag(name, name_end - name);
+        size_t value_len = value_end - value;
+        long long v = flag == OPT_MULTICAST ? 0 : decimal_value(value, value_len);
+        switch (flag) {
+            case OPT_BLKSIZE:
+                if (v >= MIN_BLKSIZE) {
+                    opts->blksize = v > MAX_BLKSIZE ? MAX_BLKSIZE : (int)v;
+                    opts->present |= OPT_BLKSIZE;
+                }
+                break;
+            case OPT_WINDOWSIZE:
+                if (v >= 1 && v <= 65535) {
+                    opts->windowsize = v > MAX_WINDOWSIZE ? MAX_WINDOWSIZE : (int)v;
+                    opts->present |= OPT_WINDOWSIZE;
+                }
+                break;
+            case OPT_TIMEOUT:
+                if (v >= 1 && v <= MAX_TIMEOUT) {
+                    opts->timeout = (int)v;
+                    opts->present |= OPT_TIMEOUT;
+                }
+                break;
+            case OPT_ROLLOVER:
+                if (v == 0 || v == 1) {
+                    opts->rollover = (int)v;
+                    opts->present |= OPT_ROLLOVER;
+                }
+                break;
+            case OPT_TSIZE:
+                if (v >= 0) {
+                    opts->tsize = v;
+                    opts->present |= OPT_TSIZE;
+                }
+                break;
+            case OPT_OFFSET:
+                if (v >= 0) {
+                    opts->offset = v;
+                    opts->present |= OPT_OFFSET;
+                }
+                break;
+            case OPT_LENGTH:
+                if (v >= 0) {
+                    opts->length = v;
+                    opts->present |= OPT_LENGTH;
+                }
+                break;
+            case OPT_MULTICAST:
+                if (parse_multicast(value, value_len, opts) == 0)
+                    opts->present |= OPT_MULTICAST;
+                break;
+        }
+    }
+    return 0;
+}
+
+// Ajoute la paire "nom\0valeur\0" à la fin du paquet
+static int append_option_text(char *buf, size_t size, int pos, const char *name, const char *value) {
+    if (pos < 0)
+        return -1;
+    size_t name_len = strlen(name), value_len = strlen(value);
+    if ((size_t)pos + name_len + value_len + 2 > size)
+        return -1;
+    memcpy(buf + pos, name, name_len + 1);
+    memcpy(buf + pos + name_len + 1, value, value_len + 1);
+    return pos + name_len + value_len + 2;
+}
+
+static int append_option(char *buf, size_t size, int pos, const char *name, long long value) {
+    // Chiffres écrits de droite à gauche dans digits, terminé par '\0'
+    char digits[24];
+    char *p = digits + sizeof(digits) - 1;
+    unsigned long long v = value < 0 ? 0 : (unsigned long long)value;
+    *p = '\0';
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    return append_option_text(buf, size, pos, name, p);
+}
+
+int append_options(char *buf, size_t size, int pos, const tftp_options *opts) {
+    if (opts->present & OPT_BLKSIZE)
+        pos = append_option(buf, size, pos, "blksize", opts->blksize);
+    if (opts->present & OPT_WINDOWSIZE)
+        pos = append_option(buf, size, pos, "windowsize", opts->windowsize);
+    if (opts->present & OPT_TIMEOUT)
+        pos = append_option(buf, size, pos, "timeout", opts->timeout);
+    if (opts->present & OPT_TSIZE)
+        pos = append_option(buf, size, pos, "tsize", opts->tsize);
+    if (opts->present & OPT_ROLLOVER)
+        pos = append_option(buf, size, pos, "rollover", opts->rollover);
+    if (opts->present & OPT_OFFSET)
+        pos = append_option(buf, size, pos, "offset", opts->offset);
+    if (opts->present & OPT_LENGTH)
+        pos = append_option(buf, size, pos, "length", opts->length);
+    if (opts->present & OPT_MULTICAST) {
+        char value[INET_ADDRSTRLEN + 16] = "";
+        if (opts->mcast_port > 0) {
+            char addr[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &opts->mcast_addr, addr, sizeof(addr));
+            snprintf(value, sizeof(value), "%s,%d,%d", addr, opts->mcast_port, opts->mcast_master);
+        }
+        pos = append_option_text(buf, size, pos, "multicast", value);
+    }
+    return pos;
+}
+
+int request_range(tftp_options *opts, long long file_size, long long *start, long long *length) {
+    if (!(opts->present & OPT_OFFSET)) {
+        opts->present &= ~OPT_LENGTH;
+        *start = 0;
+        *length = file_size;
+        return 0;
+    }
+    if (opts->offset > file_size)
+        return -1;
+    *start = opts->offset;
+    *length = file_size - opts->offset;
+    if ((opts->present & OPT_LENGTH) && opts->length > 0 && opts->length < *length)
+        *length = opts->length;
+    opts->length = *length;
+    opts->present |= OPT_LENGTH;
+    return 0;
+}
+
+unsigned int block_to_wire(long long block, int rollover) {
+    if (block <= MAX_WIRE_BLOCK)
+        return (unsigned int)block;
+    // Cycle de 65536 numéros (0 à 65535) ou de 65535 (1 à 65535)
+    return rollover ? (unsigned int)((block - 1) % MAX_WIRE_BLOCK + 1) : (unsigned int)(block & 0xFFFF);
+}
+
+long long block_from_wire(unsigned int wire, long long ref, int rollover) {
+    if (rollover && wire == 0)
+        return 0;  // Le numéro 0 ne désigne que l'ACK de l'OACK ou de la requête
+    long long cycle = rollover ? MAX_WIRE_BLOCK : MAX_WIRE_BLOCK + 1;
+    // Écart entre wire et le numéro de ref, ramené dans [-cycle/2, cycle/2[
+    long long diff = ((long long)wire - block_to_wire(ref, rollover)) % cycle;
+    if (diff < 0)
+        diff += cycle;
+    if (diff >= cycle / 2)
+        diff -= cycle;
+    return ref + diff;
+}
+
+int path_mtu_blksize(const struct sockaddr_in *peer) {
+    int blksize = MAX_BLKSIZE;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return DEFAULT_BLKSIZE;
+    // Le MTU du chemin n'est connu du noyau que pour une socket connectée
+    if (connect(fd, (const struct sockaddr*)peer, sizeof(*peer)) == 0) {
+        int mtu;
+        socklen_t len = sizeof(mtu);
+        if (getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &len) == 0 &&
+            mtu - IP_UDP_TFTP_OVERHEAD < blksize)
+            blksize = mtu - IP_UDP_TFTP_OVERHEAD;
+    }
+    close(fd);
+    return blksize < DEFAULT_BLKSIZE ? DEFAULT_BLKSIZE : blksize;
+}
+
+int negotiate_blksize(int requested, const struct sockaddr_in *peer) {
+    int limit = path_mtu_blksize(peer);
+    return requested < limit ? requested : limit;
+}
@@ -0,0 +1,82 @@
+#ifndef TFTP_OPTIONS_H
+#define TFTP_OPTIONS_H
+
+#include <stddef.h>
+#include <netinet/in.h>
+
+// Extension d'options TFTP (RFC 2347), taille de bloc (RFC 2348), délai de
+// retransmission et taille du fichier (RFC 2349), fenêtre glissante (RFC 7440),
+// multicast (RFC 2090).
+// Les options offset et length, propres à ce projet, limitent un RRQ à une
+// plage d'octets du fichier : un client peut alors le lire en plusieurs sessions.
+
+#define DEFAULT_BLKSIZE 512                 // Taille de bloc sans négociation (RFC 1350)
+#define MIN_BLKSIZE 8                       // Bornes imposées par la RFC 2348
+#define MAX_BLKSIZE 65464
+#define MAX_PACKET_SIZE (MAX_BLKSIZE + 4)   // Plus grand paquet DATA possible
+
+#define DEFAULT_WINDOWSIZE 1                // Un seul bloc en vol (RFC 1350)
+#define MAX_WINDOWSIZE 32767                // Moitié de l'espace des numéros de bloc,
+                                            // pour qu'un ACK désigne un bloc sans ambiguïté
+
+#define MAX_TIMEOUT 255                     // Option timeout, en secondes (RFC 2349)
+
+#define MAX_WIRE_BLOCK 65535                // Plus grand numéro de bloc transmis (16 bits)
+
+// Masque des options présentes dans une requête ou un OACK
+#define OPT_BLKSIZE    0x01
+#define OPT_WINDOWSIZE 0x02
+#define OPT_TIMEOUT    0x04
+#define OPT_TSIZE      0x08
+#define OPT_ROLLOVER   0x10
+#define OPT_OFFSET     0x20
+#define OPT_LENGTH     0x40
+#define OPT_MULTICAST  0x80
+
+typedef struct {
+    unsigned int present;   // Options présentes (masque OPT_*)
+    int blksize;            // Taille de bloc demandée ou acceptée
+    int windowsize;         // Nombre de blocs DATA envoyés avant d'attendre un ACK
+    int timeout;            // Délai maximal de retransmission, en secondes
+    long long tsize;        // Taille du fichier, en octets (0 dans un RRQ : à fournir par le serveur)
+    int rollover;           // Numéro du bloc qui suit le bloc 65535 (0 ou 1)
+    long long offset;       // RRQ : premier octet servi
+    long long length;       // RRQ : nombre d'octets servis (0 ou absent : jusqu'à la fin)
+    struct in_addr mcast_addr;  // multicast : groupe des DATA (valeur vide dans un RRQ)
+    int mcast_port;
+    int mcast_master;       // multicast : 1 si le client est maître (il acquitte les DATA)
+} tftp_options;
+
+// Lit une liste de paires "nom\0valeur\0" de len octets : la fin d'une requête
+// après le mode, ou un OACK après l'opcode. Les options inconnues ou hors bornes
+// sont ignorées. Renvoie -1 si une paire est tronquée.
+int parse_options(const char *list, int len, tftp_options *opts);
+
+// Ajoute les options présentes à partir de buf + pos. Renvoie la longueur
+// obtenue, ou -1 si elles ne tiennent pas dans size octets (ou si pos vaut -1).
+int append_options(char *buf, size_t size, int pos, const tftp_options *opts);
+
+// Plage servie pour un RRQ sur un fichier de file_size octets : [*start, *start + *length).
+// Sans option offset, le fichier entier (l'option length seule est ignorée). Avec
+// offset, opts->length reçoit la longueur retenue, renvoyée dans l'OACK.
+// Renvoie -1 si offset dépasse la fin du fichier.
+int request_range(tftp_options *opts, long long file_size, long long *start, long long *length);
+
+// Les blocs sont comptés sur 64 bits ; seuls leurs 16 bits de poids faible
+// circulent. Après le bloc 65535, la numérotation reprend à rollover (0 ou 1).
+
+// Numéro transmis pour le bloc block
+unsigned int block_to_wire(long long block, int rollover);
+
+// Bloc désigné par le numéro reçu wire : le plus proche de ref (dernier bloc
+// acquitté ou reçu dans l'ordre). Sans ambiguïté tant que la fenêtre ne dépasse
+// pas MAX_WINDOWSIZE. Le résultat peut être négatif (ancien paquet du début).
+long long block_from_wire(unsigned int wire, long long ref, int rollover);
+
+// Plus grande taille de bloc transportable sans fragmentation vers peer
+int path_mtu_blksize(const struct sockaddr_in *peer);
+
+// Taille de bloc retenue par le serveur pour une demande du client
+int negotiate_blksize(int requested, const struct sockaddr_in *peer);
+
+#endif
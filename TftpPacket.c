@@ -0,0 +1,80 @@
+#include <string.h>
+#include <strings.h>
+
+#include "TftpPacket.h"
+
+int encode_error(char *buf, size_t size, int code, const char *msg) {
+    if (size < TFTP_HEADER_SIZE + 1)
+        return -1;
+    put_header(buf, ERROR, code);
+    size_t len = strlen(msg);
+    if (len > size - TFTP_HEADER_SIZE - 1)
+        len = size - TFTP_HEADER_SIZE - 1;
+    memcpy(buf + TFTP_HEADER_SIZE, msg, len);
+    buf[TFTP_HEADER_SIZE + len] = '\0';
+    return TFTP_HEADER_SIZE + len + 1;
+}
+
+int parse_error(const char *buf, int len, int *code, const char **msg, int *msg_len) {
+    if (len < TFTP_HEADER_SIZE || packet_opcode(buf, len) != ERROR)
+        return -1;
+    *code = packet_block(buf);
+    *msg = buf + TFTP_HEADER_SIZE;
+    const char *end = memchr(*msg, '\0', len - TFTP_HEADER_SIZE);
+    *msg_len = end ? end - *msg : len - TFTP_HEADER_SIZE;
+    return 0;
+}
+
+int parse_request(const char *buf, int len, int *opcode, const char **filename,
+                  tftp_mode *mode, tftp_options *opts) {
+    memset(opts, 0, sizeof(*opts));
+    *opcode = packet_opcode(buf, len);
+    if (*opcode != RRQ && *opcode != WRQ)
+        return -1;
+    const char *name_start = buf + 2;
+    const char *name_end = memchr(name_start, '\0', len - 2);
+    if (!name_end || name_end == name_start)
+        return -1;
+    const char *mode_start = name_end + 1;
+    const char *mode_end = memchr(mode_start, '\0', len - (mode_start - buf));
+    if (!mode_end)
+        return -1;
+    // Le mode n'est pas sensible à la casse (RFC 1350)
+    if (strcasecmp(mode_start, "octet") == 0)
+        *mode = MODE_OCTET;
+    else if (strcasecmp(mode_start, "netascii") == 0)
+        *mode = MODE_NETASCII;
+    else
+        return -1;
+    *filename = name_start;
+    int pos = mode_end - buf + 1;
+    return parse_options(buf + pos, len - pos, opts);
+}
+
+int parse_oack(const char *buf, int len, tftp_options *opts) {
+    memset(opts, 0, sizeof(*opts));
+    if (packet_opcode(buf, len) != OACK)
+        return -1;
+    return parse_options(buf + 2, len - 2, opts);
+}
+
+int build_request(char *buf, size_t size, int opcode, const char *filename, const tftp_options *opts) {
+    static const char mode[] = "octet";
+    size_t name_len = strlen(filename);
+    size_t len = 2 + name_len + 1 + sizeof(mode);
+    if (len > size)
+        return -1;
+    buf[0] = (opcode >> 8) & 0xFF;
+    buf[1] = opcode & 0xFF;
+    memcpy(buf + 2, filename, name_len + 1);
+    memcpy(buf + 2 + name_len + 1, mode, sizeof(mode));
+    return append_options(buf, size, len, opts);
+}
+
+int build_oack(char *buf, size_t size, const tftp_options *opts) {
+    if (size < 2)
+        return -1;
+    buf[0] = 0;
+    buf[1] = OACK;
+    return append_options(buf, size, 2, opts);
+}
@@ -0,0 +1,86 @@
+#ifndef TFTP_PACKET_H
+#define TFTP_PACKET_H
+
+#include <stddef.h>
+
+#include "TftpOptions.h"
+
+// Codage et décodage des paquets TFTP (RFC 1350, RFC 2347), communs au client,
+// aux serveurs et aux outils. Le décodage se fait sur place : les champs rendus
+// pointent dans le paquet reçu, sans copie ni allocation. Le codage écrit dans
+// un tampon fourni par l'appelant.
+
+// Codes d'opération
+#define RRQ 1    // Read Request (demande de lecture)
+#define WRQ 2    // Write Request (demande d'écriture)
+#define DATA 3   // Paquet DATA
+#define ACK 4    // Accusé de réception
+#define ERROR 5  // Message d'erreur
+#define OACK 6   // Acquittement d'options
+
+#define TFTP_HEADER_SIZE 4  // Opcode, puis numéro de bloc (DATA, ACK) ou code d'erreur (ERROR)
+
+// Mode de transfert d'une requête. Les fichiers circulent toujours octet par
+// octet : netascii est accepté des clients qui le demandent par défaut, sans
+// conversion des fins de ligne. Le mode mail (obsolète) est refusé.
+typedef enum { MODE_NETASCII, MODE_OCTET } tftp_mode;
+
+// Opcode du paquet, -1 s'il fait moins de 2 octets. Les octets sont lus non signés.
+static inline int packet_opcode(const char *buf, int len) {
+    if (len < 2)
+        return -1;
+    return ((unsigned char)buf[0] << 8) | (unsigned char)buf[1];
+}
+
+// Numéro de bloc (DATA, ACK) ou code d'erreur (ERROR) : octets 2 et 3 d'un
+// paquet d'au moins TFTP_HEADER_SIZE octets
+static inline unsigned int packet_block(const char *buf) {
+    return ((unsigned char)buf[2] << 8) | (unsigned char)buf[3];
+}
+
+// Écrit l'en-tête de 4 octets : opcode puis numéro de bloc ou code d'erreur
+static inline void put_header(char *buf, int opcode, unsigned int value) {
+    buf[0] = (opcode >> 8) & 0xFF;
+    buf[1] = opcode & 0xFF;
+    buf[2] = (value >> 8) & 0xFF;
+    buf[3] = value & 0xFF;
+}
+
+// En-tête d'un DATA ; la charge utile suit à buf + TFTP_HEADER_SIZE
+static inline void encode_data_header(char *buf, unsigned int wire) {
+    put_header(buf, DATA, wire);
+}
+
+// ACK complet. Renvoie sa longueur.
+static inline int encode_ack(char *buf, unsigned int wire) {
+    put_header(buf, ACK, wire);
+    return TFTP_HEADER_SIZE;
+}
+
+// ERROR avec son message, tronqué pour tenir dans size octets.
+// Renvoie la longueur du paquet, -1 si size ne contient pas l'en-tête et le '\0'.
+int encode_error(char *buf, size_t size, int code, const char *msg);
+
+// Découpe un ERROR reçu : code, puis message de *msg_len octets à *msg, dans le
+// paquet (le '\0' final, parfois absent, n'est pas compté). Renvoie -1 si le
+// paquet n'est pas un ERROR.
+int parse_error(const char *buf, int len, int *code, const char **msg, int *msg_len);
+
+// Découpe une requête RRQ/WRQ reçue : opcode, nom de fichier (non vide, terminé
+// par '\0' dans buf), mode et options. Renvoie -1 si la requête est mal formée
+// ou si son mode est inconnu.
+int parse_request(const char *buf, int len, int *opcode, const char **filename,
+                  tftp_mode *mode, tftp_options *opts);
+
+// Lit les options acceptées dans un OACK reçu. Renvoie -1 si le paquet est mal formé.
+int parse_oack(const char *buf, int len, tftp_options *opts);
+
+// Construit une requête RRQ/WRQ en mode octet avec les options présentes.
+// Renvoie la longueur du paquet, ou -1 s'il ne tient pas dans buf.
+int build_request(char *buf, size_t size, int opcode, const char *filename, const tftp_options *opts);
+
+// Construit un OACK avec les options présentes. Renvoie la longueur du paquet,
+// ou -1 s'il ne tient pas dans buf.
+int build_oack(char *buf, size_t size, const tftp_options *opts);
+
+#endif
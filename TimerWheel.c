@@ -0,0 +1,160 @@
+#include <string.h>
+
+#include "TimerWheel.h"
+
+#define TIMER_MASK (TIMER_SLOTS - 1)
+#define TIMER_SPAN (1LL << (TIMER_BITS * TIMER_LEVELS))  // Pas couverts par la roue
+
+void timer_wheel_init(timer_wheel *wheel, long long now_us) {
+    memset(wheel, 0, sizeof(*wheel));
+    wheel->now = now_us / TIMER_TICK_US;
+}
+
+static void list_insert(timer_node **head, timer_node *node) {
+    node->next = *head;
+    if (node->next)
+        node->next->pprev = &node->next;
+    node->pprev = head;
+    *head = node;
+}
+
+static void list_remove(timer_node *node) {
+    *node->pprev = node->next;
+    if (node->next)
+        node->next->pprev = node->pprev;
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+// Range le nœud au niveau qui couvre son écart avec le pas courant. Au niveau
+// l, le créneau vient des bits de l'échéance : il n'est atteint qu'une fois le
+// pas courant entré dans la même tranche de TIMER_SLOTS^l pas.
+static void place(timer_wheel *wheel, timer_node *node) {
+    long long delta = node->expires - wheel->now;
+    int level = 0;
+    if (delta < 0)
+        node->expires = wheel->now;  // Déjà passée : traitée au pas courant
+    else if (delta >= TIMER_SPAN)
+        node->expires = wheel->now + TIMER_SPAN - 1;
+    while (level < TIMER_LEVELS - 1 && node->expires - wheel->now >= 1LL << (TIMER_BITS * (level + 1)))
+        level++;
+    int slot = (node->expires >> (TIMER_BITS * level)) & TIMER_MASK;
+    node->level = level;
+    node->slot = slot;
+    list_insert(&wheel->slots[level][slot], node);
+    wheel->occupied[level] |= 1ULL << slot;
+}
+
+void timer_schedule(timer_wheel *wheel, timer_node *node, long long deadline_us) {
+    if (timer_pending(node))
+        timer_cancel(wheel, node);
+    // Arrondi supérieur : le pas d'expiration ne précède jamais l'échéance
+    node->expires = (deadline_us + TIMER_TICK_US - 1) / TIMER_TICK_US;
+    place(wheel, node);
+    wheel->count++;
+}
+
+void timer_cancel(timer_wheel *wheel, timer_node *node) {
+    if (!timer_pending(node))
+        return;
+    list_remove(node);
+    wheel->count--;
+    if (node->level >= 0 && !wheel->slots[node->level][node->slot])
+        wheel->occupied[node->level] &= ~(1ULL << node->slot);
+}
+
+// Retire tout le contenu d'un créneau
+static timer_node *detach(timer_wheel *wheel, int level, int slot) {
+    timer_node *list = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ULL << slot);
+    return list;
+}
+
+// Redistribue le créneau du niveau level que le pas courant vient d'atteindre
+static void cascade(timer_wheel *wheel, int level) {
+    timer_node *list = detach(wheel, level, (wheel->now >> (TIMER_BITS * level)) & TIMER_MASK);
+    while (list) {
+        timer_node *node = list;
+        list = node->next;
+        place(wheel, node);
+    }
+}
+
+// Traite le pas courant : descente des niveaux supérieurs en début de
+// tranche, puis passage des échéances du créneau du niveau 0 dans la liste
+// des échéances passées
+static void process_tick(timer_wheel *wheel) {
+    int top = 0;
+    while (top < TIMER_LEVELS - 1 && ((wheel->now >> (TIMER_BITS * top)) & TIMER_MASK) == 0)
+        top++;
+    for (int level = top; level > 0; level--)
+        cascade(wheel, level);
+    int slot = wheel->now & TIMER_MASK;
+    timer_node *list = detach(wheel, 0, slot);
+    while (list) {
+        timer_node *node = list;
+        list = node->next;
+        node->level = -1;
+        list_insert(&wheel->expired, node);
+    }
+}
+
+// Avance jusqu'au pas target inclus. Les pas sans créneau occupé au niveau 0
+// ni début de tranche sont sautés.
+static void advance(timer_wheel *wheel, long long target) {
+    while (wheel->now <= target) {
+        if (wheel->count == 0) {
+            wheel->now = target + 1;
+            return;
+        }
+        process_tick(wheel);
+        wheel->now++;
+        // Prochain créneau occupé du niveau 0 avant la fin de la tranche
+        int offset = wheel->now & TIMER_MASK;
+        if (offset == 0)
+            continue;
+        unsigned long long ahead = wheel->occupied[0] >> offset;
+        long long next = ahead ? wheel->now + __builtin_ctzll(ahead)
+                               : wheel->now + TIMER_SLOTS - offset;
+        wheel->now = next <= target ? next : target + 1;
+    }
+}
+
+timer_node *timer_expired(timer_wheel *wheel, long long now_us) {
+    if (!wheel->expired)
+        advance(wheel, now_us / TIMER_TICK_US);
+    timer_node *node = wheel->expired;
+    if (!node)
+        return NULL;
+    list_remove(node);
+    wheel->count--;
+    return node;
+}
+
+long long timer_next(const timer_wheel *wheel) {
+    if (wheel->count == 0)
+        return -1;
+    if (wheel->expired)
+        return wheel->now * TIMER_TICK_US;
+    long long best = -1;
+    for (int level = 0; level < TIMER_LEVELS; level++) {
+        unsigned long long bits = wheel->occupied[level];
+        if (!bits)
+            continue;
+        // Premier créneau occupé à partir de la position courante du niveau,
+        // en faisant le tour. Au-dessus du niveau 0, le créneau courant n'est
+        // à venir que si le pas courant ouvre sa tranche : sinon il a déjà été
+        // redistribué et ne revient qu'après un tour complet.
+        int shift = TIMER_BITS * level;
+        int current = (wheel->now >> shift) & TIMER_MASK;
+        int skip = (wheel->now & ((1LL << shift) - 1)) != 0;
+        int start = (current + skip) & TIMER_MASK;
+        unsigned long long rotated = (bits >> start) | (start ? bits << (TIMER_SLOTS - start) : 0);
+        int distance = __builtin_ctzll(rotated) + skip;
+        long long tick = ((wheel->now >> shift) + distance) << shift;
+        if (best < 0 || tick < best)
+            best = tick;
+    }
+    return best * TIMER_TICK_US;
+}
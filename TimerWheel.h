@@ -0,0 +1,64 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+// Roue temporelle hiérarchique pour les échéances des sessions : programmer,
+// reprogrammer ou annuler une échéance coûte O(1), quel que soit le nombre de
+// sessions. Le temps avance par pas de TIMER_TICK_US ; le niveau 0 couvre les
+// TIMER_SLOTS prochains pas, chaque niveau suivant des pas TIMER_SLOTS fois
+// plus longs. Une échéance lointaine descend d'un niveau à chaque fois que la
+// roue atteint son créneau, jusqu'au niveau 0 où elle expire. Une échéance
+// n'expire jamais avant sa date ; elle peut expirer jusqu'à un pas après.
+//
+// Les nœuds sont intrusifs : chacun est inclus dans l'objet qu'il concerne,
+// qui ne doit pas changer d'adresse tant que son échéance est programmée.
+
+#define TIMER_TICK_US 1000          // Résolution de la roue
+#define TIMER_BITS 6
+#define TIMER_SLOTS (1 << TIMER_BITS)  // Créneaux par niveau
+#define TIMER_LEVELS 4              // Portée : 64^4 pas, soit 4,6 heures
+
+typedef struct timer_node {
+    struct timer_node *next;
+    struct timer_node **pprev;      // Lien qui pointe sur ce nœud (NULL hors de la roue)
+    long long expires;              // Pas d'expiration
+    int owner;                      // Objet concerné (indice de session)
+    int level;                      // Niveau et créneau du nœud (level -1 : échéance passée)
+    int slot;
+} timer_node;
+
+typedef struct {
+    long long now;                  // Prochain pas à traiter
+    timer_node *slots[TIMER_LEVELS][TIMER_SLOTS];
+    unsigned long long occupied[TIMER_LEVELS];  // Créneaux non vides de chaque niveau
+    timer_node *expired;            // Échéances passées, pas encore rendues
+    int count;                      // Échéances programmées ou expirées non rendues
+} timer_wheel;
+
+void timer_wheel_init(timer_wheel *wheel, long long now_us);
+
+static inline void timer_node_init(timer_node *node, int owner) {
+    node->next = NULL;
+    node->pprev = NULL;
+    node->owner = owner;
+}
+
+static inline int timer_pending(const timer_node *node) {
+    return node->pprev != NULL;
+}
+
+// Programme (ou reprogramme) l'échéance du nœud à deadline_us
+void timer_schedule(timer_wheel *wheel, timer_node *node, long long deadline_us);
+
+// Retire le nœud de la roue (sans effet s'il n'y est pas)
+void timer_cancel(timer_wheel *wheel, timer_node *node);
+
+// Fait avancer la roue jusqu'à now_us et rend une échéance passée, retirée de
+// la roue, ou NULL s'il n'y en a plus. Le traitement d'une échéance peut
+// programmer ou annuler n'importe quel nœud, y compris celui rendu.
+timer_node *timer_expired(timer_wheel *wheel, long long now_us);
+
+// Date du prochain pas où une échéance peut expirer ou descendre d'un niveau
+// (-1 si la roue est vide) : l'attente de la boucle d'événements s'y arrête.
+long long timer_next(const timer_wheel *wheel);
+
+#endif
@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "Uring.h"
+
+static int sys_setup(unsigned entries, struct io_uring_params *p) {
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                     void *arg, size_t argsz) {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+int uring_init(uring *ring, unsigned entries) {
+    struct io_uring_params p;
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    ring->fd = sys_setup(entries, &p);
+    if (ring->fd < 0)
+        return -1;
+    // Attente bornée par un délai, nécessaire aux retransmissions
+    if (!(p.features & IORING_FEAT_EXT_ARG)) {
+        close(ring->fd);
+        errno = ENOSYS;
+        return -1;
+    }
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+        goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED)
+            goto fail;
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+        goto fail;
+
+    char *sq = ring->sq_ring, *cq = ring->cq_ring;
+    ring->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ring->sq_entries = p.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+
+fail:
+    {
+        int err = errno;
+        uring_exit(ring);
+        errno = err;
+    }
+    return -1;
+}
+
+void uring_exit(uring *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED)
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+// Publie les requêtes préparées et les soumet au noyau
+static int submit(uring *ring, unsigned min_complete, unsigned flags, void *arg, size_t argsz) {
+    unsigned to_submit = ring->sq_local_tail - *ring->sq_tail;
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    if (to_submit == 0 && min_complete == 0)
+        return 0;
+    int ret;
+    do {
+        ret = sys_enter(ring->fd, to_submit, min_complete, flags, arg, argsz);
+    } while (ret < 0 && errno == EINTR && min_complete == 0);
+    return ret;
+}
+
+struct io_uring_sqe *uring_get_sqe(uring *ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        submit(ring, 0, 0, NULL, 0);
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (ring->sq_local_tail - head >= ring->sq_entries)
+            return NULL;
+    }
+    unsigned idx = ring->sq_local_tail & *ring->sq_mask;
+    ring->sq_array[idx] = idx;
+    ring->sq_local_tail++;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+void uring_reserve(uring *ring, unsigned n) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_entries - (ring->sq_local_tail - head) < n)
+        submit(ring, 0, 0, NULL, 0);
+}
+
+static struct io_uring_sqe *prep(uring *ring, int op, int fd, const void *addr, unsigned len,
+                                 unsigned long long offset, unsigned long long user_data) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    if (!sqe)
+        return NULL;
+    sqe->opcode = op;
+    sqe->fd = fd;
+    sqe->addr = (unsigned long long)(unsigned long)addr;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    return sqe;
+}
+
+struct io_uring_sqe *uring_prep_recv(uring *ring, int fd, void *buf, size_t len, unsigned long long user_data) {
+    return prep(ring, IORING_OP_RECV, fd, buf, len, 0, user_data);
+}
+
+struct io_uring_sqe *uring_prep_recvmsg(uring *ring, int fd, struct msghdr *msg, unsigned long long user_data) {
+    return prep(ring, IORING_OP_RECVMSG, fd, msg, 1, 0, user_data);
+}
+
+struct io_uring_sqe *uring_prep_send(uring *ring, int fd, const void *buf, size_t len, unsigned long long user_data) {
+    return prep(ring, IORING_OP_SEND, fd, buf, len, 0, user_data);
+}
+
+struct io_uring_sqe *uring_prep_sendmsg(uring *ring, int fd, const struct msghdr *msg, unsigned long long user_data) {
+    return prep(ring, IORING_OP_SENDMSG, fd, msg, 1, 0, user_data);
+}
+
+struct io_uring_sqe *uring_prep_read(uring *ring, int fd, void *buf, size_t len, off_t offset, unsigned long long user_data) {
+    return prep(ring, IORING_OP_READ, fd, buf, len, offset, user_data);
+}
+
+struct io_uring_sqe *uring_prep_write(uring *ring, int fd, const void *buf, size_t len, off_t offset, unsigned long long user_data) {
+    return prep(ring, IORING_OP_WRITE, fd, buf, len, offset, user_data);
+}
+
+struct io_uring_sqe *uring_prep_poll(uring *ring, int fd, unsigned events, unsigned long long user_data) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    if (!sqe)
+        return NULL;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+    return sqe;
+}
+
+struct io_uring_sqe *uring_prep_cancel(uring *ring, unsigned long long target, unsigned long long user_data) {
+    // La requête visée est désignée par son user_data
+    return prep(ring, IORING_OP_ASYNC_CANCEL, -1, (const void *)(unsigned long)target, 0, 0, user_data);
+}
+
+int uring_submit_and_wait(uring *ring, long long timeout_us) {
+    if (uring_peek_cqe(ring))
+        return submit(ring, 0, 0, NULL, 0);  // Des complétions attendent déjà
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (timeout_us >= 0) {
+        ts.tv_sec = timeout_us / 1000000;
+        ts.tv_nsec = (timeout_us % 1000000) * 1000;
+        arg.ts = (unsigned long long)(unsigned long)&ts;
+    }
+    int ret = submit(ring, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    // Délai écoulé ou signal : ce n'est pas une erreur pour la boucle
+    if (ret < 0 && (errno == ETIME || errno == EINTR))
+        return 0;
+    return ret;
+}
+
+struct io_uring_cqe *uring_peek_cqe(uring *ring) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+void uring_cqe_seen(uring *ring) {
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,61 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+// Accès minimal à io_uring par les appels système, sans bibliothèque :
+// préparation des requêtes dans l'anneau de soumission, soumission groupée
+// et lecture des complétions.
+
+typedef struct {
+    int fd;
+    // Anneau de soumission
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_entries;
+    unsigned sq_local_tail;     // Requêtes préparées, pas encore publiées au noyau
+    // Anneau de complétion
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    // Projections à libérer
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size, sqes_size;
+} uring;
+
+// Crée un anneau de entries requêtes. Renvoie -1 (errno positionné) si io_uring
+// est indisponible ou si le noyau n'offre pas l'attente bornée (IORING_FEAT_EXT_ARG).
+int uring_init(uring *ring, unsigned entries);
+void uring_exit(uring *ring);
+
+// Prochaine requête à préparer ; si l'anneau est plein, les requêtes en attente
+// sont d'abord soumises. La requête est remise à zéro.
+struct io_uring_sqe *uring_get_sqe(uring *ring);
+
+// S'assure que n requêtes tiennent dans l'anneau, en soumettant celles en attente
+// si besoin : une chaîne liée (IOSQE_IO_LINK) ne doit pas être coupée.
+void uring_reserve(uring *ring, unsigned n);
+
+// Préparation des requêtes. La requête renvoyée peut recevoir des drapeaux
+// (IOSQE_IO_LINK) ; NULL si l'anneau est saturé.
+struct io_uring_sqe *uring_prep_recv(uring *ring, int fd, void *buf, size_t len, unsigned long long user_data);
+struct io_uring_sqe *uring_prep_recvmsg(uring *ring, int fd, struct msghdr *msg, unsigned long long user_data);
+struct io_uring_sqe *uring_prep_send(uring *ring, int fd, const void *buf, size_t len, unsigned long long user_data);
+struct io_uring_sqe *uring_prep_sendmsg(uring *ring, int fd, const struct msghdr *msg, unsigned long long user_data);
+struct io_uring_sqe *uring_prep_read(uring *ring, int fd, void *buf, size_t len, off_t offset, unsigned long long user_data);
+struct io_uring_sqe *uring_prep_write(uring *ring, int fd, const void *buf, size_t len, off_t offset, unsigned long long user_data);
+struct io_uring_sqe *uring_prep_poll(uring *ring, int fd, unsigned events, unsigned long long user_data);
+struct io_uring_sqe *uring_prep_cancel(uring *ring, unsigned long long target, unsigned long long user_data);
+
+// Soumet les requêtes préparées puis attend au moins une complétion,
+// au plus timeout_us microsecondes (-1 : sans limite). Renvoie -1 sur erreur.
+int uring_submit_and_wait(uring *ring, long long timeout_us);
+
+// Complétion suivante, NULL s'il n'y en a plus. Chaque complétion lue est
+// rendue au noyau par uring_cqe_seen.
+struct io_uring_cqe *uring_peek_cqe(uring *ring);
+void uring_cqe_seen(uring *ring);
+
+#endif
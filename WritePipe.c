@@ -0,0 +1,421 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ctype.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/statvfs.h>
+
+#include "WritePipe.h"
+
+#define PAGE_ALIGN 4096
+
+struct write_pipe {
+    pthread_mutex_t lock;
+    pthread_cond_t drained;        // Signalé quand des tampons pleins ont été écrits
+    int fd;
+    char *path;                    // Chemin final
+    char *tmp;                     // Fichier temporaire propre au transfert (.nom.XXXXXX)
+    char *bufs[WRITE_PIPE_BUFFERS];
+    size_t lens[WRITE_PIPE_BUFFERS];
+    int head;                      // Premier tampon plein (le suivant des pleins est en remplissage)
+    int full;                      // Tampons pleins en attente ou en cours d'écriture
+    int writing;                   // Un thread écrit les tampons pleins
+    int queued;                    // Présent dans la file des threads d'écriture
+    off_t offset;                  // Position du tampon head dans le fichier
+    int error;                     // errno de la première écriture échouée (0 sinon)
+    int committing;                // Validation confiée aux threads d'écriture (write_pipe_commit)
+    int aborting;                  // Abandon confié aux threads d'écriture (write_pipe_abort)
+    unsigned long long owner;      // Rendu par write_pipe_completed avec le résultat
+    write_pipe *next;              // Suivant dans la file, ou parmi les validations terminées
+};
+
+// File des fichiers dont des tampons pleins attendent un thread d'écriture
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    write_pipe *head, *tail;
+} writers = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL };
+
+static pthread_once_t writers_once = PTHREAD_ONCE_INIT;
+
+// Validations terminées, en attente de write_pipe_completed. L'eventfd est
+// incrémenté à chaque ajout.
+static struct {
+    pthread_mutex_t lock;
+    write_pipe *head;
+    int fd;
+} completed = { PTHREAD_MUTEX_INITIALIZER, NULL, -1 };
+
+// Confie pipe aux threads d'écriture (verrou de pipe tenu)
+static void schedule(write_pipe *pipe) {
+    if (pipe->queued || pipe->writing)
+        return;
+    pipe->queued = 1;
+    pipe->next = NULL;
+    pthread_mutex_lock(&writers.lock);
+    if (writers.tail)
+        writers.tail->next = pipe;
+    else
+        writers.head = pipe;
+    writers.tail = pipe;
+    pthread_cond_signal(&writers.work);
+    pthread_mutex_unlock(&writers.lock);
+}
+
+// Écrit tous les octets décrits par iov à partir de offset
+static int write_all(int fd, struct iovec *iov, int iovcnt, off_t offset) {
+    while (iovcnt > 0) {
+        ssize_t n = pwritev(fd, iov, iovcnt, offset);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        offset += n;
+        // Écriture partielle : on reprend après les octets déjà écrits
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+// Ferme le fichier temporaire, puis le renomme en path avec commit ou le
+// supprime sinon. Renvoie 0 ou l'errno de la première erreur (err compris).
+static int finish(write_pipe *pipe, int commit, int err) {
+    if (close(pipe->fd) < 0 && !err)
+        err = errno;
+    if (commit && !err && rename(pipe->tmp, pipe->path) < 0)
+        err = errno;
+    if (!commit || err)
+        unlink(pipe->tmp);
+    return err;
+}
+
+static void free_pipe(write_pipe *pipe) {
+    for (int k = 0; k < WRITE_PIPE_BUFFERS; k++)
+        free(pipe->bufs[k]);
+    pthread_mutex_destroy(&pipe->lock);
+    pthread_cond_destroy(&pipe->drained);
+    free(pipe->tmp);
+    free(pipe->path);
+    free(pipe);
+}
+
+// Fin d'une validation confiée aux threads d'écriture : le fichier est mis en
+// place, et le résultat attend write_pipe_completed
+static void finish_commit(write_pipe *pipe) {
+    pipe->error = finish(pipe, 1, pipe->error);
+    pthread_mutex_lock(&completed.lock);
+    pipe->next = completed.head;
+    completed.head = pipe;
+    pthread_mutex_unlock(&completed.lock);
+    uint64_t one = 1;
+    if (write(completed.fd, &one, sizeof(one)) < 0)
+        perror("[ERROR] Signal de fin d'écriture");
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&writers.lock);
+        while (!writers.head)
+            pthread_cond_wait(&writers.work, &writers.lock);
+        write_pipe *pipe = writers.head;
+        writers.head = pipe->next;
+        if (!writers.head)
+            writers.tail = NULL;
+        pthread_mutex_unlock(&writers.lock);
+
+        // Les tampons pleins partent en un seul pwritev ; le remplissage continue pendant ce temps
+        pthread_mutex_lock(&pipe->lock);
+        pipe->queued = 0;
+        pipe->writing = 1;
+        int count = pipe->error ? 0 : pipe->full;
+        off_t offset = pipe->offset;
+        struct iovec iov[WRITE_PIPE_BUFFERS];
+        size_t total = 0;
+        for (int k = 0; k < count; k++) {
+            int b = (pipe->head + k) % WRITE_PIPE_BUFFERS;
+            iov[k].iov_base = pipe->bufs[b];
+            iov[k].iov_len = pipe->lens[b];
+            total += pipe->lens[b];
+        }
+        pthread_mutex_unlock(&pipe->lock);
+
+        int err = count > 0 && write_all(pipe->fd, iov, count, offset) < 0 ? errno : 0;
+
+        pthread_mutex_lock(&pipe->lock);
+        for (int k = 0; k < count; k++)
+            pipe->lens[(pipe->head + k) % WRITE_PIPE_BUFFERS] = 0;
+        pipe->head = (pipe->head + count) % WRITE_PIPE_BUFFERS;
+        pipe->full -= count;
+        pipe->offset += total;
+        pipe->writing = 0;
+        if (err && !pipe->error)
+            pipe->error = err;
+        if (pipe->error) {
+            // Fichier perdu ou abandonné : les tampons suivants ne sont pas écrits
+            for (int k = 0; k < pipe->full; k++)
+                pipe->lens[(pipe->head + k) % WRITE_PIPE_BUFFERS] = 0;
+            pipe->head = (pipe->head + pipe->full) % WRITE_PIPE_BUFFERS;
+            pipe->full = 0;
+        }
+        // Plus rien à écrire d'un fichier en validation ou abandonné : aucun
+        // autre thread ne le référence, celui-ci le termine
+        int commit = 0, drop = 0;
+        if (pipe->full > 0)
+            schedule(pipe);
+        else {
+            commit = pipe->committing;
+            drop = pipe->aborting;
+        }
+        pthread_cond_broadcast(&pipe->drained);
+        pthread_mutex_unlock(&pipe->lock);
+        if (commit)
+            finish_commit(pipe);
+        else if (drop) {
+            finish(pipe, 0, 0);
+            free_pipe(pipe);
+        }
+    }
+    return NULL;
+}
+
+static void start_writers(void) {
+    completed.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (completed.fd < 0)
+        perror("[ERROR] eventfd des threads d'écriture");
+    for (int k = 0; k < WRITE_PIPE_THREADS; k++) {
+        pthread_t id;
+        if (pthread_create(&id, NULL, writer_main, NULL) == 0)
+            pthread_detach(id);
+    }
+}
+
+int write_pipe_hidden(const char *filename) {
+    const char *slash = strrchr(filename, '/');
+    return (slash ? slash[1] : filename[0]) == '.';
+}
+
+// Nom de la forme .<nom>.XXXXXX, celle que donne write_pipe_open
+static int temp_name(const char *name) {
+    size_t len = strlen(name);
+    if (name[0] != '.' || len < sizeof("..XXXXXX") || name[len - 7] != '.')
+        return 0;
+    for (size_t k = len - 6; k < len; k++) {
+        if (!isalnum((unsigned char)name[k]))
+            return 0;
+    }
+    return 1;
+}
+
+static int cleaned;
+
+static int cleanup_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    if (type == FTW_F && temp_name(path + ftw->base) && unlink(path) == 0)
+        cleaned++;
+    return 0;
+}
+
+int write_pipe_cleanup(const char *dir) {
+    cleaned = 0;
+    if (nftw(dir, cleanup_entry, 16, FTW_PHYS) < 0)
+        return -1;
+    return cleaned;
+}
+
+write_pipe *write_pipe_open(const char *path, long long size) {
+    pthread_once(&writers_once, start_writers);
+    write_pipe *pipe = calloc(1, sizeof(*pipe));
+    if (!pipe)
+        return NULL;
+    pipe->path = strdup(path);
+    pipe->tmp = malloc(strlen(path) + sizeof("..XXXXXX"));
+    if (!pipe->path || !pipe->tmp) {
+        errno = ENOMEM;
+        goto fail;
+    }
+    // Nom unique, créé en exclusivité : deux réceptions du même fichier, même
+    // dans deux processus, n'écrivent jamais dans le même fichier temporaire.
+    // Caché, à côté du fichier final : le renommage reste dans le répertoire.
+    const char *slash = strrchr(path, '/');
+    int dir_len = slash ? (int)(slash - path + 1) : 0;
+    sprintf(pipe->tmp, "%.*s.%s.XXXXXX", dir_len, path, path + dir_len);
+    pipe->fd = mkostemp(pipe->tmp, O_CLOEXEC);
+    if (pipe->fd < 0)
+        goto fail;
+    fchmod(pipe->fd, 0644);  // mkostemp crée en 0600 ; le fichier reçu est lisible par tous
+    // Réservation de l'espace : fichier contigu, et disque plein détecté avant le transfert.
+    // Le contrôle de l'espace libre vaut aussi sans fallocate (système de fichiers qui l'ignore).
+    struct statvfs fs;
+    if (size > 0 && ((fstatvfs(pipe->fd, &fs) == 0 && (long long)(fs.f_bavail * fs.f_frsize) < size) ||
+                     (fallocate(pipe->fd, FALLOC_FL_KEEP_SIZE, 0, size) < 0 && errno == ENOSPC))) {
+        close(pipe->fd);
+        unlink(pipe->tmp);
+        errno = ENOSPC;
+        goto fail;
+    }
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->drained, NULL);
+    return pipe;
+
+fail:
+    {
+        int err = errno;
+        free(pipe->tmp);
+        free(pipe->path);
+        free(pipe);
+        errno = err;
+    }
+    return NULL;
+}
+
+int write_pipe_append(write_pipe *pipe, const void *data, size_t len, int wait) {
+    const char *src = data;
+    pthread_mutex_lock(&pipe->lock);
+    if (!wait) {
+        // Sans attente, le bloc est pris en entier ou pas du tout
+        int fill = (pipe->head + pipe->full) % WRITE_PIPE_BUFFERS;
+        size_t room = pipe->full == WRITE_PIPE_BUFFERS ? 0 :
+            (size_t)(WRITE_PIPE_BUFFERS - pipe->full) * WRITE_PIPE_BUFFER - pipe->lens[fill];
+        if (room < len && !pipe->error) {
+            pthread_mutex_unlock(&pipe->lock);
+            return 1;
+        }
+    }
+    while (len > 0) {
+        while (pipe->full == WRITE_PIPE_BUFFERS && !pipe->error)
+            pthread_cond_wait(&pipe->drained, &pipe->lock);
+        if (pipe->error) {
+            errno = pipe->error;
+            pthread_mutex_unlock(&pipe->lock);
+            return -1;
+        }
+        int fill = (pipe->head + pipe->full) % WRITE_PIPE_BUFFERS;
+        if (!pipe->bufs[fill]) {
+            void *buf;
+            if (posix_memalign(&buf, PAGE_ALIGN, WRITE_PIPE_BUFFER) != 0) {
+                pthread_mutex_unlock(&pipe->lock);
+                errno = ENOMEM;
+                return -1;
+            }
+            pipe->bufs[fill] = buf;
+        }
+        size_t n = WRITE_PIPE_BUFFER - pipe->lens[fill];
+        if (n > len)
+            n = len;
+        memcpy(pipe->bufs[fill] + pipe->lens[fill], src, n);
+        pipe->lens[fill] += n;
+        src += n;
+        len -= n;
+        if (pipe->lens[fill] == WRITE_PIPE_BUFFER) {
+            pipe->full++;
+            schedule(pipe);
+        }
+    }
+    pthread_mutex_unlock(&pipe->lock);
+    return 0;
+}
+
+int write_pipe_fd(const write_pipe *pipe) {
+    return pipe->fd;
+}
+
+int write_pipe_close(write_pipe *pipe, int commit) {
+    pthread_mutex_lock(&pipe->lock);
+    if (commit) {
+        // Le tampon entamé part avec les autres
+        int fill = (pipe->head + pipe->full) % WRITE_PIPE_BUFFERS;
+        if (pipe->full < WRITE_PIPE_BUFFERS && pipe->lens[fill] > 0) {
+            pipe->full++;
+            schedule(pipe);
+        }
+    } else if (!pipe->error) {
+        // Abandon : les tampons en attente ne sont pas écrits
+        pipe->error = ECANCELED;
+    }
+    // Un thread d'écriture ne doit plus rien référencer avant la libération
+    while ((commit && pipe->full > 0) || pipe->writing || pipe->queued)
+        pthread_cond_wait(&pipe->drained, &pipe->lock);
+    int err = commit ? pipe->error : 0;
+    pthread_mutex_unlock(&pipe->lock);
+    err = finish(pipe, commit, err);
+    free_pipe(pipe);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int write_pipe_commit(write_pipe *pipe, unsigned long long owner) {
+    // Pas de signal de fin possible : validation sur place
+    if (completed.fd < 0)
+        return write_pipe_close(pipe, 1);
+    pthread_mutex_lock(&pipe->lock);
+    pipe->owner = owner;
+    pipe->committing = 1;
+    // Le tampon entamé part avec les autres. Sans rien à écrire, un thread
+    // d'écriture est tout de même réveillé pour fermer et renommer ; s'il en
+    // occupe déjà un, celui-ci terminera le fichier.
+    int fill = (pipe->head + pipe->full) % WRITE_PIPE_BUFFERS;
+    if (!pipe->error && pipe->full < WRITE_PIPE_BUFFERS && pipe->lens[fill] > 0)
+        pipe->full++;
+    schedule(pipe);
+    pthread_mutex_unlock(&pipe->lock);
+    return 1;
+}
+
+void write_pipe_abort(write_pipe *pipe) {
+    pthread_mutex_lock(&pipe->lock);
+    // Les tampons en attente ne sont pas écrits ; un pwritev en cours se
+    // termine, puis le thread qui l'a fait supprime le fichier. Sinon un thread
+    // d'écriture est réveillé pour cela.
+    if (!pipe->error)
+        pipe->error = ECANCELED;
+    pipe->aborting = 1;
+    schedule(pipe);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+int write_pipe_event_fd(void) {
+    pthread_once(&writers_once, start_writers);
+    return completed.fd;
+}
+
+int write_pipe_completed(unsigned long long *owner, int *err) {
+    pthread_mutex_lock(&completed.lock);
+    write_pipe *pipe = completed.head;
+    if (pipe)
+        completed.head = pipe->next;
+    else {
+        // Liste vide : le compteur est remis à zéro, un ajout ultérieur le relèvera
+        uint64_t count;
+        if (read(completed.fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            perror("[ERROR] Lecture de l'eventfd des threads d'écriture");
+    }
+    pthread_mutex_unlock(&completed.lock);
+    if (!pipe)
+        return 0;
+    *owner = pipe->owner;
+    *err = pipe->error;
+    free_pipe(pipe);
+    return 1;
+}
@@ -0,0 +1,70 @@
+#ifndef WRITE_PIPE_H
+#define WRITE_PIPE_H
+
+#include <stddef.h>
+
+// Écriture différée des fichiers reçus (WRQ). Les blocs sont regroupés dans de
+// grands tampons alignés, écrits par pwritev depuis des threads dédiés : la
+// boucle réseau ne fait que des copies mémoire. Le fichier est reçu dans un
+// fichier temporaire caché de nom unique, .<nom>.XXXXXX dans le même répertoire,
+// et n'apparaît sous son nom qu'au renommage final, atomique : deux réceptions
+// simultanées du même fichier, même dans deux processus, ne se mélangent pas, la
+// dernière terminée l'emporte. Les serveurs refusent les noms cachés : un fichier
+// à moitié reçu n'est jamais servi.
+
+#define WRITE_PIPE_BUFFER (256 * 1024)  // Taille d'un tampon (multiple de la page)
+#define WRITE_PIPE_BUFFERS 4            // Tampons par fichier, alloués à la demande
+#define WRITE_PIPE_THREADS 2            // Threads d'écriture partagés par tous les fichiers
+
+typedef struct write_pipe write_pipe;
+
+// Vrai si le dernier composant de filename commence par un point : nom réservé
+// aux fichiers temporaires, refusé en lecture comme en écriture
+int write_pipe_hidden(const char *filename);
+
+// Supprime sous dir les fichiers temporaires laissés par un processus arrêté en
+// cours de réception. À n'appeler qu'au démarrage, avant toute réception (pas
+// à la relance d'un worker : les autres reçoivent peut-être encore). Renvoie
+// le nombre de fichiers supprimés, ou -1 si dir n'a pas pu être parcouru.
+int write_pipe_cleanup(const char *dir);
+
+// Crée le fichier temporaire de path. Si size est connue (> 0), l'espace est réservé d'avance par
+// fallocate. Renvoie NULL (errno positionné, ENOSPC si le fichier ne tient pas
+// sur le disque) en cas d'échec.
+write_pipe *write_pipe_open(const char *path, long long size);
+
+// Ajoute len octets à la suite du fichier. Renvoie 0 si les données sont prises,
+// 1 si tous les tampons du fichier attendent leur écriture (seulement sans wait :
+// rien n'est pris, le bloc sera redemandé), -1 si une écriture précédente a échoué.
+int write_pipe_append(write_pipe *pipe, const void *data, size_t len, int wait);
+
+// Descripteur du fichier temporaire, pour écrire sans passer par les tampons
+int write_pipe_fd(const write_pipe *pipe);
+
+// Termine le fichier et libère pipe : avec commit, les données en attente sont
+// écrites puis le fichier temporaire est renommé en path ; sinon il est supprimé.
+// Renvoie -1 si une écriture ou le renommage a échoué (le fichier temporaire est
+// alors supprimé).
+int write_pipe_close(write_pipe *pipe, int commit);
+
+// Comme write_pipe_close avec commit, sans attendre : l'écriture des données en
+// attente, la fermeture et le renommage sont faits par un thread d'écriture, et
+// pipe est libéré. Renvoie 1 si la validation est en cours ; sa fin est signalée
+// sur write_pipe_event_fd et rendue par write_pipe_completed avec owner. Renvoie
+// 0 ou -1, comme write_pipe_close, si elle a dû être faite sur place.
+int write_pipe_commit(write_pipe *pipe, unsigned long long owner);
+
+// Comme write_pipe_close sans commit, sans attendre : un thread d'écriture
+// attend la fin d'un pwritev en cours, ferme et supprime le fichier temporaire,
+// puis libère pipe. Rien n'est signalé.
+void write_pipe_abort(write_pipe *pipe);
+
+// Descripteur (eventfd) lisible quand des validations sont terminées (-1 si
+// indisponible : write_pipe_commit valide alors sur place)
+int write_pipe_event_fd(void);
+
+// Rend une validation terminée : *owner, et dans *err 0 ou l'errno de l'échec.
+// Renvoie 0 quand il n'y en a plus (le descripteur cesse alors d'être lisible).
+int write_pipe_completed(unsigned long long *owner, int *err);
+
+#endif
@@ -0,0 +1,58 @@
+#!/bin/sh
+# Suite de charge reproductible : mêmes fichiers, mêmes paramètres, sur
+# serverSelect (epoll puis io_uring) et serverThreads, en local (port 6969),
+# puis à travers le proxy de dégradation (port 7000) pour simuler un lien distant.
+# Lancé par « make bench » ; écrit dans /var/lib/tftpboot (fichiers bench-*).
+
+TFTP_DIR=/var/lib/tftpboot
+METRICS=/tmp/tftp-bench.sock
+
+set -e
+mkdir -p "$TFTP_DIR"
+# Contenu fixe : les mêmes octets d'une exécution à l'autre
+head -c 1048576 /dev/zero > "$TFTP_DIR/bench-1M.bin"
+head -c 16777216 /dev/zero > "$TFTP_DIR/bench-16M.bin"
+head -c 67108864 /dev/zero > "$TFTP_DIR/bench-64M.bin"
+set +e
+
+run_suite() {
+    name=$1
+    shift
+    "$@" -l warn -m "$METRICS" > /dev/null &
+    pid=$!
+    sleep 0.5
+    if ! kill -0 "$pid" 2> /dev/null; then
+        echo "== $name : le serveur n'a pas démarré"
+        return
+    fi
+    echo "== $name"
+    echo "-- GET 1 Mo, 32 clients, 512 transferts, blksize 1468, windowsize 16"
+    ./loadgen -P "$pid" -n 32 -t 512 -o get -f bench-1M.bin -b 1468 -w 16
+    echo "-- GET 16 Mo, 4 clients, 16 transferts, blksize 8192, windowsize 32"
+    ./loadgen -P "$pid" -n 4 -t 16 -o get -f bench-16M.bin -b 8192 -w 32
+    echo "-- GET 1 Mo, blksize 512 sans fenêtre, 20 requêtes/s"
+    ./loadgen -P "$pid" -n 64 -t 100 -r 20 -o get -f bench-1M.bin -b 512 -w 0
+    echo "-- PUT 1 Mo, 16 clients, 256 transferts, blksize 1468, windowsize 16"
+    ./loadgen -P "$pid" -n 16 -t 256 -o put -f bench-put-%d.bin -S 1048576 -b 1468 -w 16
+    echo "-- Multicast 64 Mo, 3 clients, maître arrêté après le bloc 40000 (au-delà d'un demi-cycle)"
+    ./loadgen -P "$pid" -n 3 -t 3 -o mcast -f bench-64M.bin -b 1468 -w 16 -k 40000
+    echo "-- GET 1 Mo à travers le proxy : 1 % de pertes, délai 10 ms, gigue 5 ms, graine 1"
+    ./proxy -p 7000 -L 1 -d 10 -j 5 -x 1 > /dev/null &
+    proxy=$!
+    sleep 0.2
+    ./loadgen -P "$pid" -p 7000 -n 8 -t 32 -o get -f bench-1M.bin -b 1468 -w 16
+    kill "$proxy" "$pid"
+    wait "$proxy" "$pid" 2> /dev/null
+    rm -f "$TFTP_DIR"/bench-put-*.bin
+    echo
+}
+
+echo "== Codec de paquets (sans réseau)"
+./codecbench -s 0.5
+echo
+
+run_suite "serverSelect (epoll)" ./serverSelect
+run_suite "serverSelect (io_uring)" ./serverSelect -u
+run_suite "serverThreads" ./serverThreads
+
+rm -f "$TFTP_DIR/bench-1M.bin" "$TFTP_DIR/bench-16M.bin" "$TFTP_DIR/bench-64M.bin" "$METRICS"